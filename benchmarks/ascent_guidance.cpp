@@ -0,0 +1,163 @@
+#include <iostream>
+#include "../lib/ascent_guidance.hpp"
+#include "../lib/loop_statistics.hpp"
+
+/**
+ * Flies AscentGuidance from the upper atmosphere to an 80 km orbit around Kerbin with a
+ * point-mass upper stage, and times every major cycle. From the same states, also flies the
+ * baseline the missions use without guidance: Launcher's gravity turn at full thrust. Both burn
+ * until the apoapsis reaches the target and circularise impulsively at apoapsis, so only the
+ * pitch program differs. Fails if guidance does not reach the orbit with less delta-v than the
+ * turn in every case. Does not need a kRPC connection.
+ *
+ * Build: g++ -O2 -std=c++17 ascent_guidance.cpp -o ascent_guidance
+ */
+
+/* Altitude where Launcher starts its turn, at TURN_SPEED. */
+const double TURN_ALTITUDE = 1000.0;
+
+/**
+ * Delta-v of Launcher's turn from the given state: pitch atan(1 / ((h - t) / (10000 - t))), burn
+ * until the apoapsis reaches the target, coast and circularise at apoapsis.
+ */
+double baseline(double mu, double body_radius, double target_altitude, double thrust, double exhaust_velocity, double altitude, double radial_speed, double horizontal_speed)
+{
+    auto dt = 0.02;
+    auto x = 0.0;
+    auto y = body_radius + altitude;
+    auto vx = horizontal_speed;
+    auto vy = radial_speed;
+    auto mass = 20000.0;
+    auto delta_v = 0.0;
+
+    for (auto time = 0.0; time < 600; time += dt)
+    {
+        auto r = sqrt(x * x + y * y);
+        auto sma = 1 / (2 / r - (vx * vx + vy * vy) / mu);
+        auto h = x * vy - y * vx;
+        auto e = sqrt(std::max(0.0, 1 - h * h / (mu * sma)));
+        auto apoapsis = sma * (1 + e);
+
+        if (sma > 0 && apoapsis - body_radius >= target_altitude)
+        {
+            /* Circularise at apoapsis, where the speed follows from the angular momentum. */
+            return delta_v + sqrt(mu / apoapsis) - abs(h) / apoapsis;
+        }
+
+        auto ux = x / r;
+        auto uy = y / r;
+        auto pitch = atan2(1.0, (r - body_radius - TURN_ALTITUDE) / (10000 - TURN_ALTITUDE));
+        auto a = thrust / mass;
+        auto ax = a * (cos(pitch) * uy + sin(pitch) * ux) - mu / (r * r) * ux;
+        auto ay = a * (-cos(pitch) * ux + sin(pitch) * uy) - mu / (r * r) * uy;
+
+        vx += ax * dt;
+        vy += ay * dt;
+        x += vx * dt;
+        y += vy * dt;
+        mass -= thrust / exhaust_velocity * dt;
+        delta_v += a * dt;
+    }
+
+    return INFINITY;
+}
+
+int main(int argc, char const *argv[])
+{
+    auto mu = 3.5316e12;
+    auto body_radius = 600000.0;
+    auto target_altitude = 80000.0;
+    auto thrust = 300000.0;
+    auto exhaust_velocity = 320 * KSP::STANDARD_GRAVITY;
+    auto cycle = 0.1;
+    auto dt = 0.02;
+
+    /* Engage altitude, radial speed and horizontal speed. */
+    double cases[][3] = {
+        {35000, 250, 900},
+        {45000, 300, 1400},
+        {40000, 500, 1000},
+        {30000, 600, 700},
+        {50000, 100, 1600}
+    };
+
+    KSP::LoopStatistics statistics;
+    auto failures = 0;
+
+    for (auto& c : cases)
+    {
+        KSP::AscentGuidance guidance(mu, body_radius + target_altitude);
+        auto x = 0.0;
+        auto y = body_radius + c[0];
+        auto vx = c[2];
+        auto vy = c[1];
+        auto mass = 20000.0;
+        auto time = 0.0;
+        auto last_cycle = -cycle;
+        auto delta_v = 0.0;
+
+        while (time < 600)
+        {
+            auto r = sqrt(x * x + y * y);
+            auto ux = x / r;
+            auto uy = y / r;
+            auto sma = 1 / (2 / r - (vx * vx + vy * vy) / mu);
+            auto h = x * vy - y * vx;
+            auto e = sqrt(std::max(0.0, 1 - h * h / (mu * sma)));
+
+            /* Cut off where the turn does. */
+            if (sma > 0 && sma * (1 + e) - body_radius >= target_altitude)
+            {
+                break;
+            }
+
+            if (!guidance.terminal(time) && time - last_cycle >= cycle)
+            {
+                KSP::LoopClock clock;
+
+                last_cycle = time;
+                guidance.update(time, r, vx * ux + vy * uy, vx * uy - vy * ux, thrust / mass, exhaust_velocity);
+                statistics.add(clock.elapsed(), cycle);
+            }
+
+            auto pitch = guidance.pitch(time);
+
+            /* Thrust in the local horizon frame, gravity towards the centre. */
+            auto a = thrust / mass;
+            auto ax = a * (cos(pitch) * uy + sin(pitch) * ux) - mu / (r * r) * ux;
+            auto ay = a * (-cos(pitch) * ux + sin(pitch) * uy) - mu / (r * r) * uy;
+
+            vx += ax * dt;
+            vy += ay * dt;
+            x += vx * dt;
+            y += vy * dt;
+            mass -= thrust / exhaust_velocity * dt;
+            delta_v += a * dt;
+            time += dt;
+        }
+
+        /* Circularise at apoapsis, where the speed follows from the angular momentum. */
+        auto r = sqrt(x * x + y * y);
+        auto sma = 1 / (2 / r - (vx * vx + vy * vy) / mu);
+        auto h = x * vy - y * vx;
+        auto e = sqrt(std::max(0.0, 1 - h * h / (mu * sma)));
+        auto apoapsis = sma * (1 + e);
+
+        delta_v += sqrt(mu / apoapsis) - abs(h) / apoapsis;
+
+        auto turn_delta_v = baseline(mu, body_radius, target_altitude, thrust, exhaust_velocity, c[0], c[1], c[2]);
+
+        std::cout << "FROM " << c[0] << " m: cutoff after " << time << " s, delta-v " << delta_v
+                  << " m/s, orbit " << apoapsis - body_radius << " m" << std::endl
+                  << "  GRAVITY TURN: delta-v " << turn_delta_v << " m/s, guidance saves " << turn_delta_v - delta_v << " m/s" << std::endl;
+
+        if (abs(apoapsis - body_radius - target_altitude) > 1000 || delta_v >= turn_delta_v)
+        {
+            failures++;
+        }
+    }
+
+    std::cout << "CYCLE: " << statistics << std::endl;
+
+    return failures > 0 || statistics.overruns > 0 ? 1 : 0;
+}
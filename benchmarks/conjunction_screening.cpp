@@ -0,0 +1,125 @@
+#include <random>
+#include <iostream>
+#include "../lib/conjunction_screening.hpp"
+#include "../lib/loop_statistics.hpp"
+
+/**
+ * Screens a synthetic debris field in low Kerbin orbit against a station, and all pairs of a
+ * smaller field, and times both. A debris object is placed on a crossing orbit 300 m from the
+ * station, and the all-pairs result is checked against a brute-force scan of every pair.
+ * Does not need a kRPC connection.
+ *
+ * Usage: conjunction_screening [objects]
+ *
+ * Build: g++ -O2 -std=c++17 conjunction_screening.cpp -o conjunction_screening -pthread
+ */
+std::vector<KSP::KeplerOrbit> debris_field(size_t count, double mu, std::mt19937& random)
+{
+    std::uniform_real_distribution<double> altitude(70000, 160000);
+    std::uniform_real_distribution<double> eccentricity(0.0, 0.02);
+    std::uniform_real_distribution<double> inclination(0.0, 0.2);
+    std::uniform_real_distribution<double> angle(0.0, 2 * M_PI);
+    std::vector<KSP::KeplerOrbit> orbits;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        orbits.push_back(KSP::KeplerOrbit(mu, 600000 + altitude(random), eccentricity(random), inclination(random), angle(random), angle(random), angle(random), 0.0));
+    }
+
+    return orbits;
+}
+
+int main(int argc, char const *argv[])
+{
+    auto mu = 3.5316e12;
+    auto count = argc > 1 ? std::stoul(argv[1]) : 5000ul;
+    auto failures = 0;
+    std::mt19937 random(42);
+
+    /* Station first, then the debris, then one object crossing the station's orbit at t = 3000 s. */
+    auto orbits = debris_field(count, mu, random);
+    orbits.insert(orbits.begin(), KSP::KeplerOrbit(mu, 700000, 0.0005, 0.05, 1.0, 0.0, 0.0, 0.0));
+
+    KSP::Vector3 position, velocity;
+    orbits[0].state_at(3000.0, position, velocity);
+    orbits.push_back(KSP::KeplerOrbit::from_state(position + KSP::Vector3(0, 300, 0), velocity.rotate(position.normalize(), 0.3), mu, 3000.0));
+
+    KSP::ConjunctionScreening screening(orbits);
+    KSP::LoopClock clock;
+    auto conjunctions = screening.screen(0.0, 21600.0, {0});
+    auto station_time = clock.elapsed();
+    auto injected = false;
+
+    for (auto& conjunction : conjunctions)
+    {
+        if (conjunction.second == orbits.size() - 1 && abs(conjunction.approach.time - 3000.0) < 1.0)
+        {
+            injected = true;
+        }
+    }
+
+    std::cout << "STATION: " << orbits.size() << " objects over 6 h in " << station_time << " s, "
+              << screening.screened_pairs << " pairs after apsis filter, " << screening.windows << " windows, "
+              << conjunctions.size() << " conjunctions" << std::endl;
+    std::cout << "CROSSING OBJECT FOUND: " << (injected ? "yes" : "no") << std::endl;
+
+    if (!injected)
+    {
+        failures++;
+    }
+
+    /* All pairs of a small field, with a larger threshold so there is something to find. */
+    auto small = debris_field(120, mu, random);
+    KSP::ConjunctionScreening all_pairs(small);
+    all_pairs.threshold = 20000.0;
+
+    clock = KSP::LoopClock();
+    auto found = all_pairs.screen(0.0, 3600.0);
+    auto all_pairs_time = clock.elapsed();
+
+    /* Brute force: every pair at a 1 s step, counting local minima under the threshold. */
+    size_t expected = 0;
+
+    for (size_t i = 0; i < small.size(); i++)
+    {
+        for (size_t j = i + 1; j < small.size(); j++)
+        {
+            auto distance = [&](double time) { return (small[i].position_at(time) - small[j].position_at(time)).length(); };
+            auto previous = distance(0.0);
+            auto current = distance(1.0);
+
+            if (previous < all_pairs.threshold && previous <= current)
+            {
+                expected++;
+            }
+
+            for (auto time = 2.0; time <= 3600.0; time += 1.0)
+            {
+                auto next = distance(time);
+
+                if (current < previous && current <= next && current < all_pairs.threshold)
+                {
+                    expected++;
+                }
+
+                previous = current;
+                current = next;
+            }
+
+            if (current < previous && current < all_pairs.threshold)
+            {
+                expected++;
+            }
+        }
+    }
+
+    std::cout << "ALL PAIRS: " << small.size() << " objects over 1 h in " << all_pairs_time << " s, "
+              << found.size() << " conjunctions, brute force " << expected << std::endl;
+
+    if (found.size() != expected)
+    {
+        failures++;
+    }
+
+    return failures > 0 ? 1 : 0;
+}
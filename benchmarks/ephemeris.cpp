@@ -0,0 +1,139 @@
+#include <random>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include "../lib/ephemeris.hpp"
+#include "../lib/loop_statistics.hpp"
+
+/**
+ * Generates the stock ephemeris over one Kerbin year, checks every body's position and velocity
+ * against its Kepler orbit at random times, and times queries against Kepler solves. Also checks
+ * that a query outside the span, an unreachable tolerance and a truncated file throw. Does not
+ * need a kRPC connection.
+ *
+ * Usage: ephemeris [path]
+ *
+ * Build: g++ -O2 -std=c++17 ephemeris.cpp -o ephemeris
+ */
+int main(int argc, char const *argv[])
+{
+    auto path = argc > 1 ? std::string(argv[1]) : std::string("/tmp/stock.ephemeris");
+    auto span = 9203545.0;
+    auto tolerance = 1.0;
+    auto failures = 0;
+    auto bodies = KSP::stock_bodies();
+
+    KSP::LoopClock clock;
+    KSP::Ephemeris::generate(bodies, 0.0, span, path, 12, tolerance);
+    auto generation_time = clock.elapsed();
+
+    KSP::Ephemeris ephemeris(path);
+    std::mt19937_64 random(49);
+    std::uniform_real_distribution<double> time(0.0, span);
+    auto file_size = std::ifstream(path, std::ios::binary | std::ios::ate).tellg();
+
+    std::cout << "GENERATED " << ephemeris.body_count() << " bodies in " << generation_time << " s" << std::endl;
+
+    for (size_t i = 0; i < ephemeris.body_count(); i++)
+    {
+        auto& record = ephemeris.body(i);
+        double position_error = 0, velocity_error = 0;
+
+        for (int k = 0; k < 10000 && record.segment_count > 0; k++)
+        {
+            auto ut = time(random);
+            KSP::Vector3 position, velocity, expected_position, expected_velocity;
+
+            ephemeris.state(i, ut, position, velocity);
+            bodies[i].orbit.state_at(ut, expected_position, expected_velocity);
+            position_error = std::max(position_error, (position - expected_position).length());
+            velocity_error = std::max(velocity_error, (velocity - expected_velocity).length());
+        }
+
+        std::cout << std::left << std::setw(7) << record.name << std::right
+                  << std::setw(6) << record.segment_count << " segments of " << std::fixed << std::setprecision(0) << std::setw(8) << record.segment_length << " s, "
+                  << std::setprecision(3) << "max error " << std::setw(6) << position_error << " m, " << std::setw(8) << velocity_error << " m/s" << std::endl;
+
+        /* The fit is only checked between its nodes, so allow some slack elsewhere. */
+        if (position_error > 10 * tolerance)
+        {
+            failures++;
+        }
+    }
+
+    std::cout << "FILE SIZE " << file_size / 1024 << " KiB" << std::endl;
+
+    /* Queries over every body at random times; Kepler solves for the same. */
+    std::vector<double> times(1000000);
+
+    for (auto& ut : times)
+    {
+        ut = time(random);
+    }
+
+    auto sum = KSP::Vector3(0, 0, 0);
+    clock = KSP::LoopClock();
+
+    for (size_t k = 0; k < times.size(); k++)
+    {
+        sum = sum + ephemeris.position(1 + k % (ephemeris.body_count() - 1), times[k]);
+    }
+
+    auto query_time = clock.elapsed();
+    clock = KSP::LoopClock();
+
+    for (size_t k = 0; k < times.size(); k++)
+    {
+        sum = sum + bodies[1 + k % (bodies.size() - 1)].orbit.position_at(times[k]);
+    }
+
+    auto kepler_time = clock.elapsed();
+
+    std::cout << std::setprecision(1) << "QUERY " << query_time / times.size() * 1e9 << " ns, KEPLER SOLVE " << kepler_time / times.size() * 1e9 << " ns"
+              << " (checksum " << std::setprecision(0) << sum.length() << ")" << std::endl;
+
+    try
+    {
+        ephemeris.position(ephemeris.body_index(KSP::bodies::MUN), span + 1);
+        std::cout << "OUT OF SPAN: no exception" << std::endl;
+        failures++;
+    }
+    catch (const std::out_of_range&)
+    {
+    }
+
+    /* Far below the rounding error of the fit, so the segments would double forever. */
+    try
+    {
+        KSP::Ephemeris::generate(bodies, 0.0, span, path + ".unreachable", 12, 1e-9);
+        std::cout << "UNREACHABLE TOLERANCE: no exception" << std::endl;
+        failures++;
+    }
+    catch (const std::runtime_error& error)
+    {
+        std::cout << "UNREACHABLE TOLERANCE: " << error.what() << std::endl;
+    }
+
+    /* Cut inside the body records, which must be rejected before they are read. */
+    {
+        std::ifstream original(path, std::ios::binary);
+        std::vector<char> bytes(sizeof(KSP::EphemerisHeader) + 3 * sizeof(KSP::EphemerisBody) / 2);
+
+        original.read(bytes.data(), bytes.size());
+        std::ofstream(path + ".truncated", std::ios::binary).write(bytes.data(), bytes.size());
+    }
+
+    try
+    {
+        KSP::Ephemeris truncated(path + ".truncated");
+        std::cout << "TRUNCATED: no exception" << std::endl;
+        failures++;
+    }
+    catch (const std::runtime_error&)
+    {
+    }
+
+    std::remove((path + ".truncated").c_str());
+
+    return failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,105 @@
+#include <iomanip>
+#include <iostream>
+#include "../lib/patched_conics.hpp"
+#include "../lib/loop_statistics.hpp"
+
+/**
+ * Predicts a Mun flyby from low Kerbin orbit with the Kerbin system's constants, checks the
+ * encounter time against a brute-force scan of the distance to the Mun, searches the prograde
+ * burn for a 30 km Mun periapsis, and times single predictions and the burn search.
+ * Does not need a kRPC connection.
+ *
+ * Usage: patched_conics
+ *
+ * Build: g++ -O2 -std=c++17 patched_conics.cpp -o patched_conics
+ */
+int main(int argc, char const *argv[])
+{
+    auto failures = 0;
+    auto kerbin_mu = 3.5316e12;
+
+    std::vector<KSP::ConicBody> bodies = {
+        {"Kerbin", kerbin_mu, 600000, INFINITY, -1, KSP::KeplerOrbit()},
+        {"Mun", 6.5138398e10, 200000, 2429559.1, 0, KSP::KeplerOrbit(kerbin_mu, 12000000, 0.0, 0.0, 0.0, 0.0, 1.7, 0.0)},
+        {"Minmus", 1.7658e9, 60000, 2247428.4, 0, KSP::KeplerOrbit(kerbin_mu, 47000000, 0.0, 6 * M_PI / 180, 78 * M_PI / 180, 38 * M_PI / 180, 0.9, 0.0)},
+    };
+    KSP::PatchedConicPredictor predictor(bodies);
+    auto mun = predictor.body_index("Mun");
+
+    /* Hohmann transfer departing when the Mun is 110 degrees ahead, a little past the usual angle. */
+    auto parking_radius = 680000.0;
+    auto mun_radius = 12000000.0;
+    auto transfer_time = M_PI * sqrt(pow((parking_radius + mun_radius) / 2, 3) / kerbin_mu);
+    auto phase = 1.7 - 110 * M_PI / 180;
+    KSP::KeplerOrbit parking(kerbin_mu, parking_radius, 0.0, 0.0, 0.0, 0.0, phase, 0.0);
+    auto departure_speed = sqrt(kerbin_mu / parking_radius) * (sqrt(2 * mun_radius / (parking_radius + mun_radius)) - 1);
+    auto transfer = predictor.burn(parking, 0.0, departure_speed);
+
+    auto patches = predictor.predict(0, transfer, 0.0, 2 * transfer_time);
+    const char* transitions[] = {"final", "encounter", "escape", "impact"};
+
+    auto print = [&](std::vector<KSP::ConicPatch>& trajectory) {
+        for (auto& patch : trajectory)
+        {
+            std::cout << std::fixed << std::setprecision(1) << "  " << predictor.body(patch.body).name << ": T+" << patch.start << " s to T+" << patch.end
+                      << " s, periapsis " << (patch.orbit.periapsis() - predictor.body(patch.body).radius) / 1000 << " km, then " << transitions[patch.transition] << std::endl;
+        }
+    };
+
+    std::cout << "TRANSFER:" << std::endl;
+    print(patches);
+
+    /* Brute force: first time the vessel is within the Mun's sphere of influence, at a 1 s step. */
+    auto brute_force = INFINITY;
+
+    for (auto time = 0.0; time < 2 * transfer_time; time += 1.0)
+    {
+        if ((transfer.position_at(time) - bodies[mun].orbit.position_at(time)).length() < bodies[mun].sphere_of_influence)
+        {
+            brute_force = time;
+            break;
+        }
+    }
+
+    std::cout << "ENCOUNTER: T+" << patches[0].end << " s, brute force T+" << brute_force << " s" << std::endl;
+
+    if (patches.size() < 2 || patches[0].transition != KSP::PATCH_ENCOUNTER || abs(patches[0].end - brute_force) > 1.0)
+    {
+        failures++;
+    }
+
+    /* Single predictions. */
+    auto count = 20000;
+    KSP::LoopClock clock;
+
+    for (int i = 0; i < count; i++)
+    {
+        predictor.predict(0, predictor.burn(parking, 0.0, departure_speed + i * 1e-4), 0.0, 2 * transfer_time);
+    }
+
+    auto prediction_time = clock.elapsed() / count;
+
+    /* Burn search for a 30 km Mun periapsis. */
+    auto target = bodies[mun].radius + 30000;
+    auto before = predictor.predictions;
+    clock = KSP::LoopClock();
+    auto correction = predictor.prograde_for_periapsis(0, transfer, 600.0, mun, target, -20.0, 20.0, 2 * transfer_time);
+    auto search_time = clock.elapsed();
+    auto search_predictions = predictor.predictions - before;
+
+    auto corrected = predictor.predict(0, predictor.burn(transfer, 600.0, correction), 600.0, 2 * transfer_time);
+    auto periapsis = predictor.periapsis_in(corrected, mun);
+
+    std::cout << std::setprecision(3) << "PREDICTION: " << prediction_time * 1e6 << " us, " << 1 / prediction_time << " per second" << std::endl;
+    std::cout << "BURN SEARCH: " << correction << " m/s prograde at T+600 s for a " << (periapsis - bodies[mun].radius) / 1000
+              << " km Mun periapsis, " << search_predictions << " predictions in " << search_time * 1e3 << " ms" << std::endl;
+
+    print(corrected);
+
+    if (!std::isfinite(correction) || abs(periapsis - target) > 10 || corrected.size() < 3 || corrected[1].transition != KSP::PATCH_ESCAPE)
+    {
+        failures++;
+    }
+
+    return failures > 0 ? 1 : 0;
+}
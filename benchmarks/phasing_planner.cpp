@@ -0,0 +1,92 @@
+#include <iomanip>
+#include <iostream>
+#include "../lib/phasing_planner.hpp"
+#include "../lib/loop_statistics.hpp"
+
+/**
+ * Plans a resupply flight from a parking orbit to a station in low Kerbin orbit, and a
+ * co-orbital one that starts in the station's orbit, and times both on one thread and on all
+ * of them. The parking orbit is only 5 km below the station, so the next Hohmann window is
+ * days away; the front should reach the station much sooner, and every plan on it should meet
+ * the station when its burns are flown. Does not need a kRPC connection.
+ *
+ * Usage: phasing_planner
+ *
+ * Build: g++ -O2 -std=c++17 phasing_planner.cpp -o phasing_planner -pthread
+ */
+int check(std::string name, KSP::KeplerOrbit chaser, KSP::KeplerOrbit station)
+{
+    auto failures = 0;
+    KSP::PhasingPlanner planner(chaser, station);
+    planner.min_radius = 670000;
+
+    planner.threads = 1;
+    KSP::LoopClock clock;
+    auto single = planner.pareto_front(0.0);
+    auto single_time = clock.elapsed();
+
+    planner.threads = 0;
+    clock = KSP::LoopClock();
+    auto front = planner.pareto_front(0.0);
+    auto parallel_time = clock.elapsed();
+
+    std::cout << name << ": " << planner.searched_plans << " plans, " << planner.propagated_plans << " propagated, in " << single_time << " s on one thread, "
+              << parallel_time << " s on all, " << front.size() << " on the front" << std::endl;
+
+    if (front.empty() || single.empty() || abs(front.back().delta_v - single.back().delta_v) > 1e-6)
+    {
+        return 1;
+    }
+
+    double direct = INFINITY;
+
+    for (auto& plan : front)
+    {
+        std::cout << std::fixed << std::setprecision(1)
+                  << "  T+" << std::setw(9) << plan.arrival_time << " s  "
+                  << std::setw(6) << plan.delta_v << " m/s  "
+                  << std::setw(2) << plan.revolutions << " rev "
+                  << (plan.phasing_orbit == KSP::PHASE_BEFORE_TRANSFER ? "before" : "after ") << "  "
+                  << std::setw(7) << (plan.phasing_radius - 600000) / 1000 << " km  miss "
+                  << std::setw(6) << plan.miss_distance << " m" << std::endl;
+
+        if (plan.miss_distance > planner.max_miss_distance)
+        {
+            failures++;
+        }
+
+        if (plan.revolutions == 0)
+        {
+            direct = plan.arrival_time;
+        }
+    }
+
+    /* The cheapest plan within six hours must not cost more than the fastest. */
+    auto chosen = KSP::PhasingPlanner::cheapest(front, 21600.0);
+
+    std::cout << "  CHOSEN FOR 6 H: T+" << chosen.arrival_time << " s, " << chosen.delta_v << " m/s"
+              << (std::isfinite(direct) ? ", direct transfer T+" + std::to_string(direct) + " s" : "") << std::endl;
+
+    if (chosen.delta_v > front.front().delta_v || (chosen.arrival_time > 21600.0 && chosen.arrival_time != front.front().arrival_time))
+    {
+        failures++;
+    }
+
+    return failures;
+}
+
+int main(int argc, char const *argv[])
+{
+    auto mu = 3.5316e12;
+    auto failures = 0;
+
+    /* Station at 100 km, chaser 5 km below and 150 degrees behind it. */
+    KSP::KeplerOrbit station(mu, 700000, 0.0005, 0.0, 0.0, 0.0, 0.0, 0.0);
+    KSP::KeplerOrbit parking(mu, 695000, 0.001, 0.0, 0.0, 0.0, -150 * M_PI / 180, 0.0);
+    KSP::KeplerOrbit trailing(mu, 700000, 0.0005, 0.0, 0.0, 0.0, -150 * M_PI / 180, 0.0);
+
+    failures += check("PARKING ORBIT", parking, station);
+    failures += check("CO-ORBITAL", trailing, station);
+
+    return failures > 0 ? 1 : 0;
+}
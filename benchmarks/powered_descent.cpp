@@ -0,0 +1,69 @@
+#include <iostream>
+#include <random>
+#include "../lib/powered_descent.hpp"
+
+/**
+ * Benchmarks PoweredDescentGuidance::solve and flies a simple point-mass descent with it.
+ * Does not need a kRPC connection.
+ *
+ * Build: g++ -O2 -std=c++17 powered_descent.cpp -o powered_descent
+ */
+int main(int argc, char const *argv[])
+{
+    /* Booster similar to New Shepard on Kerbin. */
+    auto gravity = KSP::Vector3(-9.81, 0, 0);
+    auto max_thrust = 500000.0;
+    auto isp = 300.0;
+    auto solve_limit = 0.001;
+
+    /* Random states across the envelope of the landing burn. */
+    std::mt19937 generator(42);
+    std::uniform_real_distribution<double> altitude(100, 4000);
+    std::uniform_real_distribution<double> vertical_speed(-300, -10);
+    std::uniform_real_distribution<double> horizontal(-200, 200);
+    std::uniform_real_distribution<double> horizontal_speed(-20, 20);
+    std::uniform_real_distribution<double> mass(15000, 30000);
+
+    KSP::LoopStatistics statistics;
+    unsigned long solves = 100000;
+
+    for (unsigned long i = 0; i < solves; i++)
+    {
+        KSP::PoweredDescentGuidance guidance;
+        auto position = KSP::Vector3(altitude(generator), horizontal(generator), horizontal(generator));
+        auto velocity = KSP::Vector3(vertical_speed(generator), horizontal_speed(generator), horizontal_speed(generator));
+
+        guidance.solve(position, velocity, KSP::Vector3(-1, 0, 0), gravity, mass(generator), max_thrust, isp);
+        statistics.add(guidance.statistics().last, solve_limit);
+    }
+
+    std::cout << "SOLVE:   " << statistics << std::endl;
+
+    /* Closed loop from 4 km at -250 m/s, re-solving every 20 ms tick. */
+    KSP::PoweredDescentGuidance guidance;
+    auto position = KSP::Vector3(4000, 150, -80);
+    auto velocity = KSP::Vector3(-250, 10, 5);
+    auto vessel_mass = 22000.0;
+    auto dt = 0.02;
+    auto time = 0.0;
+    auto delta_v = 0.0;
+
+    while (position.m_x > 0.0 && velocity.m_x < -1.05 && time < 300)
+    {
+        auto command = guidance.solve(position, velocity, KSP::Vector3(-1, 0, 0), gravity, vessel_mass, max_thrust, isp);
+        auto thrust_acceleration = command.direction * (command.throttle * max_thrust / vessel_mass);
+
+        velocity = velocity + (thrust_acceleration + gravity) * dt;
+        position = position + velocity * dt;
+        vessel_mass -= command.throttle * max_thrust / (KSP::STANDARD_GRAVITY * isp) * dt;
+        delta_v += thrust_acceleration.length() * dt;
+        time += dt;
+    }
+
+    std::cout << "LANDING: altitude " << position.m_x << " m, miss " << KSP::Vector3(0, position.m_y, position.m_z).length()
+              << " m, velocity " << velocity << ", delta-v " << delta_v << " m/s" << std::endl;
+    std::cout << "IN LOOP: " << guidance.statistics() << std::endl;
+
+    /* Allow for the odd scheduler hiccup, not for slow solves. */
+    return statistics.overruns > solves / 1000 ? 1 : 0;
+}
@@ -0,0 +1,119 @@
+#include <iomanip>
+#include <iostream>
+#include "../lib/reentry_predictor.hpp"
+#include "../lib/loop_statistics.hpp"
+
+/**
+ * Deorbits a capsule from an 80 km Kerbin orbit, equatorial and inclined, and checks the
+ * predicted impact against a fixed-step RK4 reference integrated in the inertial frame with the
+ * air turning with the planet, so the rotating-frame terms are checked independently. Times the
+ * predictions, which must be fast enough for 10 Hz. Does not need a kRPC connection.
+ *
+ * Usage: reentry_predictor
+ *
+ * Build: g++ -O2 -std=c++17 reentry_predictor.cpp -o reentry_predictor
+ */
+
+/* Impact in the body's reference frame, from the same model integrated in the inertial frame. */
+KSP::Vector3 reference(KSP::ReentryPredictor& predictor, KSP::Vector3 position, KSP::Vector3 velocity, double& impact_time)
+{
+    auto spin = KSP::Vector3(0, -predictor.rotational_speed, 0);
+    auto dt = 0.01;
+
+    auto acceleration = [&](KSP::Vector3 r, KSP::Vector3 v) {
+        auto radius = r.length();
+        auto altitude = radius - predictor.body_radius;
+        auto density = altitude < predictor.atmosphere_depth ? predictor.sea_level_density * (exp(-altitude / predictor.scale_height) - exp(-predictor.atmosphere_depth / predictor.scale_height)) : 0.0;
+        auto air = v - spin.cross(r);
+
+        return r * (-predictor.gravitational_parameter / (radius * radius * radius)) - air * (0.5 * density * air.length() * predictor.drag_area / predictor.mass);
+    };
+
+    velocity = velocity + spin.cross(position);
+
+    for (auto time = 0.0; time < predictor.max_time; time += dt)
+    {
+        auto k1v = acceleration(position, velocity);
+        auto k1r = velocity;
+        auto k2v = acceleration(position + k1r * (dt / 2), velocity + k1v * (dt / 2));
+        auto k2r = velocity + k1v * (dt / 2);
+        auto k3v = acceleration(position + k2r * (dt / 2), velocity + k2v * (dt / 2));
+        auto k3r = velocity + k2v * (dt / 2);
+        auto k4v = acceleration(position + k3r * dt, velocity + k3v * dt);
+        auto k4r = velocity + k3v * dt;
+        auto next = position + (k1r + k2r * 2 + k3r * 2 + k4r) * (dt / 6);
+
+        if (next.length() <= predictor.body_radius)
+        {
+            /* Linear within the last hundredth of a second, then back into the turning frame. */
+            auto fraction = (position.length() - predictor.body_radius) / (position.length() - next.length());
+            auto impact = position + (next - position) * fraction;
+            auto angle = predictor.rotational_speed * (time + fraction * dt);
+
+            impact_time = time + fraction * dt;
+            return KSP::Vector3(impact.m_x * cos(angle) + impact.m_z * sin(angle), impact.m_y, -impact.m_x * sin(angle) + impact.m_z * cos(angle));
+        }
+
+        velocity = velocity + (k1v + k2v * 2 + k3v * 2 + k4v) * (dt / 6);
+        position = next;
+    }
+
+    impact_time = INFINITY;
+    return position;
+}
+
+int check(std::string name, double inclination)
+{
+    KSP::ReentryPredictor predictor(1300, 1.2);
+    auto radius = predictor.body_radius + 80000;
+    auto speed = sqrt(predictor.gravitational_parameter / radius);
+    auto i = inclination * M_PI / 180;
+
+    /* Over 0 degrees longitude, heading east and north; the velocity is relative to the surface. */
+    auto position = KSP::Vector3(radius, 0, 0);
+    auto velocity = KSP::Vector3(0, speed * sin(i), speed * cos(i) - predictor.rotational_speed * radius);
+    velocity = predictor.deorbit_velocity(position, velocity, 30000);
+
+    auto impact = predictor.predict(position, velocity, 0.0);
+    double reference_time;
+    auto expected = reference(predictor, position, velocity, reference_time);
+    auto miss = (impact.position - expected).length();
+
+    KSP::LoopClock clock;
+
+    for (int k = 0; k < 1000; k++)
+    {
+        predictor.predict(position, velocity, 0.0);
+    }
+
+    auto prediction_time = clock.elapsed() / 1000;
+
+    std::cout << std::fixed << std::setprecision(3) << name << ": impact at " << impact.latitude << ", " << impact.longitude
+              << std::setprecision(1) << " after " << impact.time << " s (reference " << reference_time << " s), "
+              << impact.surface_speed << " m/s, peak " << impact.max_deceleration / 9.81 << " g, " << impact.steps << " steps" << std::endl
+              << std::setprecision(1) << "  miss " << miss << " m, " << prediction_time * 1e6 << " us per prediction, "
+              << KSP::ReentryPredictor::angle_ahead(position, velocity, impact.position) * 180 / M_PI << " degrees downrange" << std::endl;
+
+    return impact.impact && miss < 100 && abs(impact.time - reference_time) < 1 && prediction_time < 0.01 ? 0 : 1;
+}
+
+int main(int argc, char const *argv[])
+{
+    auto failures = 0;
+
+    failures += check("EQUATORIAL", 0);
+    failures += check("INCLINED 60", 60);
+
+    /* Stays up: no impact. */
+    KSP::ReentryPredictor predictor(1300, 1.2);
+    auto radius = predictor.body_radius + 80000;
+    auto orbit = predictor.predict(KSP::Vector3(radius, 0, 0), KSP::Vector3(0, 0, sqrt(predictor.gravitational_parameter / radius) - predictor.rotational_speed * radius), 0.0);
+
+    if (orbit.impact || orbit.steps != 0)
+    {
+        std::cout << "80 KM ORBIT: predicted an impact" << std::endl;
+        failures++;
+    }
+
+    return failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,141 @@
+#include <iomanip>
+#include <iostream>
+#include "../lib/clohessy_wiltshire.hpp"
+
+/**
+ * Flies the burns of KSP::Rendezvous::execute from 8 km behind and 200 m below a target in a
+ * 100 km Kerbin orbit, with impulsive burns and both vessels integrated under two-body gravity
+ * with RK4, so the linear CW model is checked against the motion it approximates. Every burn is
+ * planned from the integrated state, as the mission plans from the measured one. Also checks
+ * that singular transfer times are rejected. Does not need a kRPC connection.
+ *
+ * Usage: rendezvous
+ *
+ * Build: g++ -O2 -std=c++17 rendezvous.cpp -o rendezvous
+ */
+
+const double MU = 3.5316e12;
+
+struct Body
+{
+    KSP::Vector3 position;
+    KSP::Vector3 velocity;
+};
+
+void integrate(Body& body, double time, double dt = 0.1)
+{
+    auto gravity = [](KSP::Vector3 r) { return r * (-MU / pow(r.length(), 3)); };
+
+    for (auto elapsed = 0.0; elapsed < time - 1e-9; elapsed += dt)
+    {
+        auto h = std::min(dt, time - elapsed);
+        auto r = body.position;
+        auto v = body.velocity;
+        auto k1v = gravity(r);
+        auto k1r = v;
+        auto k2v = gravity(r + k1r * (h / 2));
+        auto k2r = v + k1v * (h / 2);
+        auto k3v = gravity(r + k2r * (h / 2));
+        auto k3r = v + k2v * (h / 2);
+        auto k4v = gravity(r + k3r * h);
+        auto k4r = v + k3v * h;
+
+        body.position = r + (k1r + k2r * 2 + k3r * 2 + k4r) * (h / 6);
+        body.velocity = v + (k1v + k2v * 2 + k3v * 2 + k4v) * (h / 6);
+    }
+}
+
+int main(int argc, char const *argv[])
+{
+    auto radius = 700000.0;
+    auto legs = 3;
+    auto approach_fraction = 0.5;
+    auto hold_position = KSP::Vector3(0, -100, 0);
+    auto start_position = KSP::Vector3(-200, -8000, 50);
+    auto failures = 0;
+
+    Body target = {KSP::Vector3(radius, 0, 0), KSP::Vector3(0, sqrt(MU / radius), 0)};
+    auto start_frame = KSP::HillFrame(target.position, target.velocity, MU);
+    auto n = start_frame.mean_motion();
+    auto offset = start_frame.to_inertial(start_position);
+
+    /* At rest in the rotating frame, so it drifts with the lower orbit. */
+    Body chaser = {target.position + offset, target.velocity + start_frame.to_inertial(KSP::Vector3(0, 0, n)).cross(offset)};
+
+    auto leg_time = approach_fraction * 2 * M_PI / n / legs;
+    auto total_delta_v = 0.0;
+
+    for (int leg = 0; leg <= legs; leg++)
+    {
+        auto frame = KSP::HillFrame(target.position, target.velocity, MU);
+        auto cw = KSP::ClohessyWiltshire(frame.mean_motion());
+        auto state = frame.relative(chaser.position, chaser.velocity);
+        auto delta_v = state.velocity * -1;
+
+        if (leg < legs)
+        {
+            auto waypoint = hold_position + (start_position - hold_position) * (1.0 - (leg + 1.0) / legs);
+
+            delta_v = delta_v + cw.departure_velocity(state.position, waypoint, leg_time);
+        }
+
+        std::cout << std::fixed << std::setprecision(2) << "BURN " << leg + 1 << ": " << delta_v.length() << " m/s at "
+                  << std::setprecision(1) << (state.position - hold_position).length() << " m from the hold point" << std::endl;
+
+        chaser.velocity = chaser.velocity + frame.to_inertial(delta_v);
+        total_delta_v += delta_v.length();
+
+        if (leg < legs)
+        {
+            integrate(target, leg_time);
+            integrate(chaser, leg_time);
+        }
+    }
+
+    /* Drift for a minute after the last burn: it should stay put. */
+    integrate(target, 60);
+    integrate(chaser, 60);
+
+    auto final_frame = KSP::HillFrame(target.position, target.velocity, MU);
+    auto final_state = final_frame.relative(chaser.position, chaser.velocity);
+    auto miss = (final_state.position - hold_position).length();
+
+    std::cout << std::setprecision(2) << "HOLD POINT MISS " << miss << " m, SPEED " << final_state.velocity.length() << " m/s, "
+              << legs + 1 << " burns of " << total_delta_v << " m/s" << std::endl;
+
+    /* The last leg spans about 2.6 km, where the curvature the CW model leaves out is a few metres. */
+    if (miss > 10 || final_state.velocity.length() > 0.05)
+    {
+        failures++;
+    }
+
+    /* A whole orbit in plane and half an orbit out of plane are singular. */
+    auto cw = KSP::ClohessyWiltshire(n);
+
+    for (auto [name, time, target_position] : {
+        std::make_tuple("WHOLE ORBIT", 2 * M_PI / n, KSP::Vector3(0, -100, 0)),
+        std::make_tuple("HALF ORBIT OUT OF PLANE", M_PI / n, KSP::Vector3(0, -100, 50)),
+    })
+    {
+        try
+        {
+            cw.departure_velocity(start_position, target_position, time);
+            std::cout << name << ": no exception" << std::endl;
+            failures++;
+        }
+        catch (const std::invalid_argument&)
+        {
+        }
+    }
+
+    /* Half an orbit is fine when the out of plane motion comes back by itself. */
+    auto mirror = cw.departure_velocity(start_position, KSP::Vector3(0, -100, -start_position.m_z), M_PI / n);
+
+    if (!std::isfinite(mirror.length()))
+    {
+        std::cout << "HALF ORBIT TO THE MIRROR POINT: not finite" << std::endl;
+        failures++;
+    }
+
+    return failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,369 @@
+#include <poll.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <chrono>
+#include <cstring>
+#include <thread>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <stdexcept>
+#include "../lib/io_thread.hpp"
+
+/**
+ * Compares RPC throughput of a blocking client, the IoThread, and KSP::PipelinedChannel, the
+ * engine behind KSP::PipelinedConnection, against a mock server on localhost. The mock server
+ * answers every value with the value plus one. Like the kRPC server, it can answer only once per
+ * update: once with no delay (loopback latency only) and once per 1 ms. A pipelined batch is
+ * framed as its tag, a call count and the values; the mock server answers the batches of one
+ * update in reverse order, so the responses are matched by tag. The queues hold every call, so
+ * the control thread time is what issuing costs without backpressure.
+ * Does not need a kRPC connection.
+ *
+ * Build: g++ -O2 -std=c++20 -pthread rpc_pipeline.cpp -o rpc_pipeline
+ */
+
+/* Reads or writes exactly size bytes. */
+void transfer(int socket, void* data, size_t size, bool write)
+{
+    auto bytes = static_cast<char*>(data);
+
+    while (size > 0)
+    {
+        auto done = write ? ::send(socket, bytes, size, 0) : ::recv(socket, bytes, size, 0);
+
+        if (done <= 0)
+        {
+            throw std::runtime_error("Mock server connection closed");
+        }
+
+        bytes += done;
+        size -= done;
+    }
+}
+
+/* One write per batch, so Nagle's algorithm on the server side does not hold back its tail. */
+std::vector<char> frame_batch(uint64_t tag, const std::vector<uint64_t>& values)
+{
+    uint32_t count = values.size();
+    std::vector<char> frame(sizeof(tag) + sizeof(count) + count * sizeof(uint64_t));
+
+    std::memcpy(frame.data(), &tag, sizeof(tag));
+    std::memcpy(frame.data() + sizeof(tag), &count, sizeof(count));
+    std::memcpy(frame.data() + sizeof(tag) + sizeof(count), values.data(), count * sizeof(uint64_t));
+
+    return frame;
+}
+
+/* Serves one blocking client connection, answering all pending requests once per update period. */
+void serve(int client, std::chrono::microseconds update)
+{
+    std::vector<uint64_t> buffer(4096);
+    size_t partial = 0;
+
+    while (true)
+    {
+        pollfd descriptor = {client, POLLIN, 0};
+
+        if (poll(&descriptor, 1, -1) <= 0)
+        {
+            break;
+        }
+
+        auto bytes = reinterpret_cast<char*>(buffer.data());
+        auto received = ::recv(client, bytes + partial, buffer.size() * sizeof(uint64_t) - partial, 0);
+
+        if (received <= 0)
+        {
+            break;
+        }
+
+        partial += received;
+        auto count = partial / sizeof(uint64_t);
+
+        if (update.count() > 0)
+        {
+            std::this_thread::sleep_for(update);
+        }
+
+        std::vector<uint64_t> responses(buffer.begin(), buffer.begin() + count);
+
+        for (auto& response : responses)
+        {
+            response++;
+        }
+
+        transfer(client, responses.data(), count * sizeof(uint64_t), true);
+
+        /* Keep a trailing partial request for the next read. */
+        partial -= count * sizeof(uint64_t);
+        std::copy(bytes + count * sizeof(uint64_t), bytes + count * sizeof(uint64_t) + partial, bytes);
+    }
+
+    close(client);
+}
+
+/* Serves one pipelined client connection: every batch that has arrived is answered once per update, newest first. */
+void serve_batches(int client, std::chrono::microseconds update)
+{
+    std::vector<char> buffer;
+    std::vector<char> chunk(65536);
+
+    while (true)
+    {
+        pollfd descriptor = {client, POLLIN, 0};
+
+        if (poll(&descriptor, 1, -1) <= 0)
+        {
+            break;
+        }
+
+        auto received = ::recv(client, chunk.data(), chunk.size(), 0);
+
+        if (received <= 0)
+        {
+            break;
+        }
+
+        buffer.insert(buffer.end(), chunk.begin(), chunk.begin() + received);
+
+        /* Whole batches: tag, count, values. */
+        std::vector<std::vector<uint64_t>> batches;
+        size_t offset = 0;
+
+        while (buffer.size() - offset >= sizeof(uint64_t) + sizeof(uint32_t))
+        {
+            uint32_t count;
+
+            std::memcpy(&count, buffer.data() + offset + sizeof(uint64_t), sizeof(count));
+
+            auto size = sizeof(uint64_t) + sizeof(uint32_t) + count * sizeof(uint64_t);
+
+            if (buffer.size() - offset < size)
+            {
+                break;
+            }
+
+            std::vector<uint64_t> batch(1 + count);
+
+            std::memcpy(&batch[0], buffer.data() + offset, sizeof(uint64_t));
+            std::memcpy(&batch[1], buffer.data() + offset + sizeof(uint64_t) + sizeof(uint32_t), count * sizeof(uint64_t));
+            batches.push_back(batch);
+            offset += size;
+        }
+
+        buffer.erase(buffer.begin(), buffer.begin() + offset);
+
+        if (batches.empty())
+        {
+            continue;
+        }
+
+        if (update.count() > 0)
+        {
+            std::this_thread::sleep_for(update);
+        }
+
+        for (auto batch = batches.rbegin(); batch != batches.rend(); batch++)
+        {
+            for (size_t i = 1; i < batch->size(); i++)
+            {
+                (*batch)[i]++;
+            }
+
+            auto frame = frame_batch((*batch)[0], std::vector<uint64_t>(batch->begin() + 1, batch->end()));
+
+            transfer(client, frame.data(), frame.size(), true);
+        }
+    }
+
+    close(client);
+}
+
+int listen_local(uint16_t& port)
+{
+    auto server = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address = {};
+    socklen_t length = sizeof(address);
+
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = 0;
+
+    bind(server, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+    listen(server, 8);
+    getsockname(server, reinterpret_cast<sockaddr*>(&address), &length);
+    port = ntohs(address.sin_port);
+
+    return server;
+}
+
+int connect_local(uint16_t port)
+{
+    auto client = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address = {};
+    int flag = 1;
+
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(port);
+
+    connect(client, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+    setsockopt(client, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+
+    return client;
+}
+
+uint64_t blocking_call(int socket, uint64_t request)
+{
+    uint64_t response;
+
+    transfer(socket, &request, sizeof(request), true);
+    transfer(socket, &response, sizeof(response), false);
+
+    return response;
+}
+
+double seconds_since(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void report(std::string name, unsigned long calls, double seconds, double issue_seconds)
+{
+    std::cout << name << calls / seconds << " calls/s"
+              << "  control thread " << issue_seconds / calls * 1e6 << " us/call to issue" << std::endl;
+}
+
+int main(int argc, char const *argv[])
+{
+    uint16_t port;
+    auto server = listen_local(port);
+    auto failures = 0;
+
+    for (auto update : {std::chrono::microseconds(0), std::chrono::microseconds(1000)})
+    {
+        /* Fewer calls when every round trip waits for an update. */
+        unsigned long calls = update.count() > 0 ? 2000 : 50000;
+
+        std::cout << "SERVER UPDATE " << update.count() << " us, " << calls << " calls" << std::endl;
+
+        /* Blocking: the control thread waits a round trip per call. */
+        {
+            std::thread server_thread([&]() { serve(accept(server, nullptr, nullptr), update); });
+            auto client = connect_local(port);
+            auto start = std::chrono::steady_clock::now();
+
+            for (unsigned long i = 0; i < calls; i++)
+            {
+                failures += blocking_call(client, i) != i + 1;
+            }
+
+            auto seconds = seconds_since(start);
+
+            report("  BLOCKING:         ", calls, seconds, seconds);
+            close(client);
+            server_thread.join();
+        }
+
+        /* IoThread: same round trips, but the control thread only queues them. */
+        {
+            std::thread server_thread([&]() { serve(accept(server, nullptr, nullptr), update); });
+            auto client = connect_local(port);
+            KSP::IoThread io(calls);
+            std::vector<std::future<uint64_t>> futures;
+
+            futures.reserve(calls);
+
+            auto start = std::chrono::steady_clock::now();
+
+            for (unsigned long i = 0; i < calls; i++)
+            {
+                futures.push_back(io.submit([client, i]() { return blocking_call(client, i); }));
+            }
+
+            auto issue_seconds = seconds_since(start);
+
+            for (unsigned long i = 0; i < calls; i++)
+            {
+                failures += futures[i].get() != i + 1;
+            }
+
+            report("  IO THREAD:        ", calls, seconds_since(start), issue_seconds);
+            io.stop();
+            close(client);
+            server_thread.join();
+        }
+
+        /* Pipelined: up to in_flight tagged batches of up to batch calls on the wire at once. */
+        for (auto [in_flight, batch] : std::vector<std::pair<size_t, size_t>>{{1, 1}, {8, 1}, {64, 1}, {1, 64}, {8, 64}})
+        {
+            std::thread server_thread([&]() { serve_batches(accept(server, nullptr, nullptr), update); });
+            auto client = connect_local(port);
+            std::vector<std::future<uint64_t>> futures;
+
+            futures.reserve(calls);
+
+            {
+                KSP::PipelinedChannel<uint64_t, uint64_t> channel(
+                    [client](uint64_t tag, const std::vector<uint64_t>& requests) {
+                        auto frame = frame_batch(tag, requests);
+
+                        transfer(client, frame.data(), frame.size(), true);
+                    },
+                    [client]() {
+                        uint64_t tag;
+                        uint32_t count;
+
+                        transfer(client, &tag, sizeof(tag), false);
+                        transfer(client, &count, sizeof(count), false);
+
+                        std::vector<uint64_t> responses(count);
+
+                        transfer(client, responses.data(), count * sizeof(uint64_t), false);
+
+                        return std::make_pair(tag, responses);
+                    },
+                    in_flight,
+                    batch,
+                    calls
+                );
+
+                auto start = std::chrono::steady_clock::now();
+
+                for (unsigned long i = 0; i < calls; i++)
+                {
+                    futures.push_back(channel.call(i));
+                }
+
+                auto issue_seconds = seconds_since(start);
+
+                for (unsigned long i = 0; i < calls; i++)
+                {
+                    failures += futures[i].get() != i + 1;
+                }
+
+                std::string name = "  PIPELINED " + std::to_string(in_flight) + "x" + std::to_string(batch) + ":";
+
+                report(name + std::string(20 - name.size(), ' '), calls, seconds_since(start), issue_seconds);
+            }
+
+            close(client);
+            server_thread.join();
+        }
+    }
+
+    close(server);
+
+    if (failures > 0)
+    {
+        std::cout << failures << " wrong responses" << std::endl;
+    }
+
+    return failures > 0 ? 1 : 0;
+}
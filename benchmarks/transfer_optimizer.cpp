@@ -0,0 +1,77 @@
+#include <iostream>
+#include "../lib/transfer_optimizer.hpp"
+#include "../lib/loop_statistics.hpp"
+
+/**
+ * Plans a Mun transfer from an inclined low Kerbin orbit and compares it with the current
+ * two-step path: a plane change burn at the node, then a Hohmann transfer burn. Times the
+ * search on one thread and on all of them, and flies the plan's burns to check that it reaches
+ * the Mun. Does not need a kRPC connection.
+ *
+ * Usage: transfer_optimizer [inclination (deg)]
+ *
+ * Build: g++ -O2 -std=c++17 transfer_optimizer.cpp -o transfer_optimizer -pthread
+ */
+int main(int argc, char const *argv[])
+{
+    auto mu = 3.5316e12;
+    auto inclination = (argc > 1 ? std::stod(argv[1]) : 6.0) * M_PI / 180;
+    auto failures = 0;
+
+    KSP::KeplerOrbit parking(mu, 680000, 0.0, inclination, 1.0, 0.0, 0.0, 0.0);
+    KSP::KeplerOrbit mun(mu, 12000000, 0.0, 0.0, 0.0, 0.0, 1.7, 0.0);
+
+    /* Two-step path, as Maneuver computes it: plane change at circular speed, then Hohmann. */
+    auto parking_radius = parking.semi_major_axis();
+    auto mun_radius = mun.semi_major_axis();
+    auto parking_speed = sqrt(mu / parking_radius);
+    auto relative_inclination = acos(std::clamp(parking.normal().dot(mun.normal()), -1.0, 1.0));
+    auto plane_change = 2 * parking_speed * sin(relative_inclination / 2);
+    auto hohmann = parking_speed * (sqrt(2 * mun_radius / (parking_radius + mun_radius)) - 1);
+    auto two_step = plane_change + hohmann;
+
+    KSP::TransferOptimizer optimizer(parking, mun);
+
+    optimizer.threads = 1;
+    KSP::LoopClock clock;
+    auto single_thread = optimizer.optimize(0.0);
+    auto single_time = clock.elapsed();
+
+    optimizer.threads = 0;
+    clock = KSP::LoopClock();
+    auto plan = optimizer.optimize(0.0);
+    auto parallel_time = clock.elapsed();
+
+    std::cout << "PLANNED: " << optimizer.evaluated_plans << " plans in " << single_time << " s on one thread, "
+              << parallel_time << " s on all" << std::endl;
+    std::cout << "TWO-STEP: " << plane_change << " + " << hohmann << " = " << two_step << " m/s" << std::endl;
+    std::cout << "OPTIMIZED: " << plan.delta_v << " m/s in " << plan.burns.size() << " burns, saving "
+              << two_step - plan.delta_v << " m/s" << std::endl;
+
+    for (auto& burn : plan.burns)
+    {
+        std::cout << "  T+" << burn.time << " s: prograde " << burn.prograde << ", normal " << burn.normal
+                  << ", radial " << burn.radial << " m/s" << std::endl;
+    }
+
+    /* Fly the burns and measure how far from the Mun's centre the vessel is on arrival. */
+    auto orbit = parking;
+    KSP::Vector3 position, velocity;
+
+    for (auto& burn : plan.burns)
+    {
+        orbit.state_at(burn.time, position, velocity);
+        orbit = KSP::KeplerOrbit::from_state(position, velocity + burn.delta_v, mu, burn.time);
+    }
+
+    auto miss = (orbit.position_at(plan.arrival_time) - mun.position_at(plan.arrival_time)).length();
+
+    std::cout << "MISS DISTANCE: " << miss << " m at T+" << plan.arrival_time << " s" << std::endl;
+
+    if (miss > 1000 || plan.delta_v >= two_step || abs(plan.delta_v - single_thread.delta_v) > 0.1)
+    {
+        failures++;
+    }
+
+    return failures > 0 ? 1 : 0;
+}
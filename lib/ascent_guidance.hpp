@@ -0,0 +1,258 @@
+#pragma once
+
+#include <math.h>
+#include <algorithm>
+#include "constants.hpp"
+
+namespace KSP
+{
+    /**
+     * Closed-loop ascent guidance to a circular orbit, for the vacuum part of the ascent.
+     *
+     * The ascent is flown the way the gravity turn flies it: burn until the apoapsis reaches the
+     * target, coast, and circularise at apoapsis. Instead of the fixed turn curve, each major
+     * cycle solves for the pitch profile that does this with the least delta-v, burn plus
+     * circularisation, from the current radius, radial and tangential velocity and the
+     * performance of the burning stage. The profile is the linear tangent steering law,
+     * tan(pitch) = A - B * t, optimal for burns in uniform gravity. A and B are found by a pattern
+     * search on a predicted trajectory, warm-started from the last cycle's solution; the time to
+     * cutoff is where the predicted apoapsis reaches the target. Staging is handled by
+     * re-converging on the next stage.
+     *
+     * Source: A. E. Bryson and Y. C. Ho, "Applied Optimal Control", section 2.7.
+     */
+    class AscentGuidance
+    {
+    private:
+        double m_mu;
+        double m_target_radius;
+        double m_A;
+        double m_B;
+        double m_T;
+        double m_delta_v;
+        double m_cycle_time;
+        bool m_converged;
+    public:
+        /* Seconds before cutoff at which the solution is frozen. */
+        double terminal_time = 2.0;
+        /* Trajectory predictions per major cycle; a fresh solution gets four times as many. */
+        int evaluations = 24;
+        /* Prediction integration step in seconds. */
+        double prediction_step = 0.5;
+    public:
+        AscentGuidance(double gravitational_parameter, double target_radius);
+        ~AscentGuidance();
+    public:
+        void update(double time, double radius, double radial_velocity, double tangential_velocity, double acceleration, double exhaust_velocity);
+        double pitch(double time);
+        double time_to_cutoff(double time);
+        double delta_v();
+        bool converged();
+        bool terminal(double time);
+        void reset();
+    private:
+        double predict(double A, double B, double radius, double radial_velocity, double tangential_velocity, double acceleration, double exhaust_velocity, double& T);
+        double apoapsis(double radius, double radial_velocity, double tangential_velocity);
+    };
+
+    AscentGuidance::AscentGuidance(double gravitational_parameter, double target_radius)
+        : m_mu(gravitational_parameter), m_target_radius(target_radius)
+    {
+        reset();
+    }
+
+    AscentGuidance::~AscentGuidance()
+    {
+    }
+
+    void AscentGuidance::reset()
+    {
+        m_A = 0.0;
+        m_B = 0.0;
+        m_T = 0.0;
+        m_delta_v = INFINITY;
+        m_cycle_time = 0.0;
+        m_converged = false;
+    }
+
+    /* Major cycle. Times are in seconds on any monotonic game clock, e.g. mission elapsed time. */
+    void AscentGuidance::update(double time, double radius, double radial_velocity, double tangential_velocity, double acceleration, double exhaust_velocity)
+    {
+        if (acceleration <= 0.0 || exhaust_velocity <= 0.0 || terminal(time))
+        {
+            return;
+        }
+
+        auto step_A = 0.01;
+        auto step_B = 0.0002;
+        auto count = evaluations;
+
+        if (m_converged)
+        {
+            /* Same steering law from the new time origin. */
+            m_A -= m_B * (time - m_cycle_time);
+        }
+        else
+        {
+            /* First guess: hold the current flight path angle, levelling off over a minute. */
+            m_A = radial_velocity / std::max(1.0, tangential_velocity);
+            m_B = std::max(0.0, m_A) / 60;
+            step_A = 0.1;
+            step_B = 0.002;
+            count *= 4;
+        }
+
+        m_cycle_time = time;
+
+        auto T = 0.0;
+        auto best = predict(m_A, m_B, radius, radial_velocity, tangential_velocity, acceleration, exhaust_velocity, T);
+
+        /* Pattern search: move to the best neighbour, or halve the steps if there is none. */
+        for (int i = 0; i < count && step_A > 1e-4; )
+        {
+            double neighbours[4][2] = {{m_A + step_A, m_B}, {m_A - step_A, m_B}, {m_A, m_B + step_B}, {m_A, m_B - step_B}};
+            auto improved = false;
+
+            for (auto& neighbour : neighbours)
+            {
+                auto candidate_T = 0.0;
+                auto candidate = predict(neighbour[0], neighbour[1], radius, radial_velocity, tangential_velocity, acceleration, exhaust_velocity, candidate_T);
+
+                i++;
+
+                if (candidate < best)
+                {
+                    best = candidate;
+                    T = candidate_T;
+                    m_A = neighbour[0];
+                    m_B = neighbour[1];
+                    improved = true;
+                }
+            }
+
+            if (!improved)
+            {
+                step_A /= 2;
+                step_B /= 2;
+            }
+        }
+
+        m_T = T;
+        m_delta_v = best;
+
+        /* Converged once a predicted trajectory reaches the target apoapsis. */
+        m_converged = std::isfinite(best);
+    }
+
+    /**
+     * Delta-v to burn along tan(pitch) = A - B * t until the apoapsis reaches the target, plus the
+     * circularisation at apoapsis, and the burn time T. Infinite if the stage burns out first.
+     */
+    double AscentGuidance::predict(double A, double B, double r, double rdot, double vtheta, double a, double ve, double& T)
+    {
+        auto tau = ve / a;
+        auto h = prediction_step;
+        auto t = 0.0;
+        auto previous_apoapsis = apoapsis(r, rdot, vtheta);
+
+        if (previous_apoapsis >= m_target_radius)
+        {
+            T = 0.0;
+            return sqrt(m_mu / previous_apoapsis) - r * vtheta / previous_apoapsis;
+        }
+
+        /* Radial and tangential acceleration for the steering law, polar coordinates. */
+        auto derivative = [&](double t, double r, double rdot, double vtheta, double& rddot, double& vthetadot) {
+            auto thrust = a / (1 - t / tau);
+            auto pitch = atan(A - B * t);
+
+            rddot = thrust * sin(pitch) - m_mu / (r * r) + vtheta * vtheta / r;
+            vthetadot = thrust * cos(pitch) - rdot * vtheta / r;
+        };
+
+        while (t + h < 0.99 * tau)
+        {
+            /* Midpoint step. */
+            double rddot, vthetadot;
+
+            derivative(t, r, rdot, vtheta, rddot, vthetadot);
+
+            auto r_half = r + rdot * h / 2;
+            auto rdot_half = rdot + rddot * h / 2;
+            auto vtheta_half = vtheta + vthetadot * h / 2;
+
+            derivative(t + h / 2, r_half, rdot_half, vtheta_half, rddot, vthetadot);
+
+            auto next_r = r + rdot_half * h;
+            auto next_rdot = rdot + rddot * h;
+            auto next_vtheta = vtheta + vthetadot * h;
+            auto next_apoapsis = apoapsis(next_r, next_rdot, next_vtheta);
+
+            if (next_apoapsis >= m_target_radius)
+            {
+                /* Cutoff within the step: interpolate to where the apoapsis crosses the target. */
+                auto fraction = (m_target_radius - previous_apoapsis) / (next_apoapsis - previous_apoapsis);
+                auto cutoff_r = r + (next_r - r) * fraction;
+                auto cutoff_vtheta = vtheta + (next_vtheta - vtheta) * fraction;
+
+                T = t + h * fraction;
+
+                return -ve * log(1 - T / tau) + sqrt(m_mu / m_target_radius) - cutoff_r * cutoff_vtheta / m_target_radius;
+            }
+
+            r = next_r;
+            rdot = next_rdot;
+            vtheta = next_vtheta;
+            previous_apoapsis = next_apoapsis;
+            t += h;
+        }
+
+        return INFINITY;
+    }
+
+    /* Apoapsis radius; infinite on an escape trajectory. */
+    double AscentGuidance::apoapsis(double r, double rdot, double vtheta)
+    {
+        auto energy = (rdot * rdot + vtheta * vtheta) / 2 - m_mu / r;
+
+        if (energy >= 0.0)
+        {
+            return INFINITY;
+        }
+
+        auto semi_major_axis = -m_mu / (2 * energy);
+        auto angular_momentum = r * vtheta;
+        auto eccentricity = sqrt(std::max(0.0, 1 - angular_momentum * angular_momentum / (m_mu * semi_major_axis)));
+
+        return semi_major_axis * (1 + eccentricity);
+    }
+
+    /* Pitch above the local horizon in radians, following the last major cycle's steering. */
+    double AscentGuidance::pitch(double time)
+    {
+        return atan(m_A - m_B * (time - m_cycle_time));
+    }
+
+    /* Seconds until the apoapsis reaches the target; the circularisation is still to come. */
+    double AscentGuidance::time_to_cutoff(double time)
+    {
+        return m_T - (time - m_cycle_time);
+    }
+
+    /* Predicted delta-v from the last major cycle to the circular orbit, circularisation included. */
+    double AscentGuidance::delta_v()
+    {
+        return m_delta_v;
+    }
+
+    bool AscentGuidance::converged()
+    {
+        return m_converged;
+    }
+
+    /* Near cutoff the prediction has too few steps to steer by, so steering is held. */
+    bool AscentGuidance::terminal(double time)
+    {
+        return m_converged && time_to_cutoff(time) < terminal_time;
+    }
+}
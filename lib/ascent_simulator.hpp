@@ -0,0 +1,217 @@
+#pragma once
+
+#include <math.h>
+#include <vector>
+#include <algorithm>
+#include "constants.hpp"
+#include "ascent_table.hpp"
+
+namespace KSP
+{
+    /* One stage in firing order. Masses in kg, thrust in N, dry mass includes everything dropped with the stage. */
+    struct StageDescription
+    {
+        double wet_mass;
+        double dry_mass;
+        double thrust;
+        double isp_vacuum;
+        double isp_sea_level;
+    };
+
+    /* Parameters of the pitch and throttle program being optimised. */
+    struct AscentProfile
+    {
+        double turn_start_speed;
+        double turn_end_altitude;
+        double turn_exponent;
+        double max_twr;
+    };
+
+    struct AscentResult
+    {
+        bool reached;
+        double delta_v;
+        double circularization_delta_v;
+        double apoapsis;
+        double max_dynamic_pressure;
+        double time;
+    };
+
+    /**
+     * Point-mass ascent simulator in the equatorial plane of a rotating body with an exponential
+     * atmosphere. Defaults are for Kerbin. Burns until the apoapsis reaches the target outside
+     * the atmosphere, and adds the circularisation burn at apoapsis to the delta-v.
+     */
+    class AscentSimulator
+    {
+    private:
+        std::vector<StageDescription> m_stages;
+        double m_target_altitude;
+        double m_drag_area;
+    public:
+        double gravitational_parameter = 3.5316e12;
+        double body_radius = 600000.0;
+        double rotational_speed = 2 * M_PI / 21549.425;
+        double atmosphere_depth = 70000.0;
+        double sea_level_density = 1.225;
+        double scale_height = 5600.0;
+        double time_step = 0.05;
+        double max_time = 1000.0;
+    public:
+        AscentSimulator(std::vector<StageDescription> stages, double target_altitude, double drag_area = 1.0);
+        ~AscentSimulator();
+    public:
+        AscentResult simulate(AscentProfile profile, AscentTable* table = nullptr);
+        double pitch(AscentProfile profile, double turn_start_altitude, double altitude);
+    private:
+        double density(double altitude);
+    };
+
+    AscentSimulator::AscentSimulator(std::vector<StageDescription> stages, double target_altitude, double drag_area)
+        : m_stages(stages), m_target_altitude(target_altitude), m_drag_area(drag_area)
+    {
+    }
+
+    AscentSimulator::~AscentSimulator()
+    {
+    }
+
+    /* Pitch in degrees: vertical until the turn starts, then a power curve down to the horizon. */
+    double AscentSimulator::pitch(AscentProfile profile, double turn_start_altitude, double altitude)
+    {
+        if (turn_start_altitude < 0 || altitude <= turn_start_altitude)
+        {
+            return 90.0;
+        }
+
+        auto fraction = (altitude - turn_start_altitude) / std::max(1.0, profile.turn_end_altitude - turn_start_altitude);
+
+        return 90.0 * (1 - pow(std::min(1.0, fraction), profile.turn_exponent));
+    }
+
+    double AscentSimulator::density(double altitude)
+    {
+        return altitude < atmosphere_depth ? sea_level_density * exp(-altitude / scale_height) : 0.0;
+    }
+
+    AscentResult AscentSimulator::simulate(AscentProfile profile, AscentTable* table)
+    {
+        AscentResult result = {false, 0.0, 0.0, 0.0, 0.0, 0.0};
+        auto mu = gravitational_parameter;
+        auto dt = time_step;
+
+        /* Position and velocity in an inertial frame; the pad starts on the +y axis moving east (+x). */
+        auto x = 0.0;
+        auto y = body_radius;
+        auto vx = rotational_speed * body_radius;
+        auto vy = 0.0;
+        auto stage = size_t(0);
+        auto propellant = m_stages.empty() ? 0.0 : m_stages[0].wet_mass - m_stages[0].dry_mass;
+        auto turn_start_altitude = -1.0;
+
+        for (auto time = 0.0; time < max_time; time += dt)
+        {
+            auto r = sqrt(x * x + y * y);
+            auto altitude = r - body_radius;
+            auto ux = x / r;
+            auto uy = y / r;
+
+            if (altitude < -1.0)
+            {
+                return result;
+            }
+
+            /* Orbit from the vis-viva equation and angular momentum. */
+            auto v2 = vx * vx + vy * vy;
+            auto sma = 1 / (2 / r - v2 / mu);
+            auto h = abs(x * vy - y * vx);
+            auto e = sqrt(std::max(0.0, 1 - h * h / (mu * sma)));
+            auto apoapsis = sma > 0 ? sma * (1 + e) - body_radius : INFINITY;
+
+            /* Done once coasting above the atmosphere with the target apoapsis. */
+            if (altitude > atmosphere_depth && apoapsis >= m_target_altitude)
+            {
+                auto apoapsis_radius = apoapsis + body_radius;
+
+                result.reached = true;
+                result.apoapsis = apoapsis;
+                result.circularization_delta_v = sqrt(mu / apoapsis_radius) - h / apoapsis_radius;
+                result.delta_v += result.circularization_delta_v;
+                result.time = time;
+                return result;
+            }
+
+            /* Drop empty stages. */
+            while (stage < m_stages.size() && propellant <= 0.0)
+            {
+                stage++;
+                propellant = stage < m_stages.size() ? m_stages[stage].wet_mass - m_stages[stage].dry_mass : 0.0;
+            }
+
+            if (stage >= m_stages.size())
+            {
+                result.apoapsis = apoapsis;
+                return result;
+            }
+
+            auto mass = propellant + m_stages[stage].dry_mass;
+
+            for (size_t i = stage + 1; i < m_stages.size(); i++)
+            {
+                mass += m_stages[i].wet_mass;
+            }
+
+            /* Air-relative velocity and drag. */
+            auto air_vx = vx - rotational_speed * y;
+            auto air_vy = vy + rotational_speed * x;
+            auto air_speed = sqrt(air_vx * air_vx + air_vy * air_vy);
+            auto dynamic_pressure = 0.5 * density(altitude) * air_speed * air_speed;
+            auto drag = dynamic_pressure * m_drag_area / mass;
+
+            result.max_dynamic_pressure = std::max(result.max_dynamic_pressure, dynamic_pressure);
+
+            if (turn_start_altitude < 0 && air_speed > profile.turn_start_speed)
+            {
+                turn_start_altitude = altitude;
+            }
+
+            /* Isp and thrust scale with pressure at constant mass flow. */
+            auto current = m_stages[stage];
+            auto pressure_fraction = density(altitude) / sea_level_density;
+            auto isp = current.isp_vacuum + (current.isp_sea_level - current.isp_vacuum) * pressure_fraction;
+            auto mass_flow = current.thrust / (current.isp_vacuum * STANDARD_GRAVITY);
+            auto g = mu / (r * r);
+            auto burning = apoapsis < m_target_altitude;
+            auto throttle = burning ? std::min(1.0, profile.max_twr * mass * g / (mass_flow * isp * STANDARD_GRAVITY)) : 0.0;
+            auto thrust = mass_flow * throttle * isp * STANDARD_GRAVITY;
+            auto target_pitch = pitch(profile, turn_start_altitude, altitude);
+            auto pitch_radians = target_pitch * M_PI / 180;
+
+            /* Rows are recorded as the rocket climbs through each grid altitude. */
+            while (table && altitude >= table->next_altitude())
+            {
+                table->add(target_pitch, throttle);
+            }
+
+            /* Thrust east along the local horizon, pitched up. */
+            auto thrust_acceleration = thrust / mass;
+            auto ax = thrust_acceleration * (cos(pitch_radians) * uy + sin(pitch_radians) * ux) - g * ux;
+            auto ay = thrust_acceleration * (-cos(pitch_radians) * ux + sin(pitch_radians) * uy) - g * uy;
+
+            if (air_speed > 0.0)
+            {
+                ax -= drag * air_vx / air_speed;
+                ay -= drag * air_vy / air_speed;
+            }
+
+            vx += ax * dt;
+            vy += ay * dt;
+            x += vx * dt;
+            y += vy * dt;
+            propellant -= mass_flow * throttle * dt;
+            result.delta_v += thrust_acceleration * dt;
+        }
+
+        return result;
+    }
+}
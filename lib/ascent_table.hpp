@@ -0,0 +1,180 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdint>
+#include <algorithm>
+
+namespace KSP
+{
+    /* Magic, row count, first altitude, step and target. */
+    const size_t TABLE_HEADER_SIZE = 4 + sizeof(uint32_t) + 3 * sizeof(float);
+
+    /**
+     * Pitch and throttle against altitude on a uniform altitude grid, so lookups are O(1).
+     *
+     * File layout (native endianness):
+     *   char[4]  magic "KAT1"
+     *   uint32   row count
+     *   float    first altitude (m)
+     *   float    altitude step (m)
+     *   float    target apoapsis altitude (m)
+     *   row count x { float pitch (deg), float throttle (0-1) }
+     */
+    class AscentTable
+    {
+    private:
+        std::vector<float> m_pitch;
+        std::vector<float> m_throttle;
+        float m_altitude_start;
+        float m_altitude_step;
+        float m_target_altitude;
+    public:
+        AscentTable();
+        AscentTable(double altitude_start, double altitude_step, double target_altitude);
+        ~AscentTable();
+    public:
+        bool load(std::string path);
+        bool save(std::string path);
+        void add(double pitch, double throttle);
+        bool empty();
+        double pitch(double altitude);
+        double throttle(double altitude);
+        double target_altitude();
+        double next_altitude();
+    private:
+        double interpolate(std::vector<float>& values, double altitude);
+    };
+
+    AscentTable::AscentTable() : m_altitude_start(0), m_altitude_step(1), m_target_altitude(0)
+    {
+    }
+
+    AscentTable::AscentTable(double altitude_start, double altitude_step, double target_altitude)
+        : m_altitude_start(altitude_start), m_altitude_step(altitude_step), m_target_altitude(target_altitude)
+    {
+    }
+
+    AscentTable::~AscentTable()
+    {
+    }
+
+    /* False if the file is missing, not a table, or its size does not match its row count. */
+    bool AscentTable::load(std::string path)
+    {
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        auto size = file ? static_cast<size_t>(file.tellg()) : 0;
+        char magic[4];
+        uint32_t count;
+
+        file.seekg(0);
+
+        if (!file.read(magic, 4) || std::string(magic, 4) != "KAT1" || !file.read(reinterpret_cast<char*>(&count), sizeof(count)))
+        {
+            return false;
+        }
+
+        /* Checked before resizing, so a corrupt count cannot make a huge allocation. */
+        if (size != TABLE_HEADER_SIZE + static_cast<size_t>(count) * 2 * sizeof(float))
+        {
+            return false;
+        }
+
+        file.read(reinterpret_cast<char*>(&m_altitude_start), sizeof(float));
+        file.read(reinterpret_cast<char*>(&m_altitude_step), sizeof(float));
+        file.read(reinterpret_cast<char*>(&m_target_altitude), sizeof(float));
+
+        m_pitch.resize(count);
+        m_throttle.resize(count);
+
+        for (uint32_t i = 0; i < count && file; i++)
+        {
+            file.read(reinterpret_cast<char*>(&m_pitch[i]), sizeof(float));
+            file.read(reinterpret_cast<char*>(&m_throttle[i]), sizeof(float));
+        }
+
+        if (!file || m_altitude_step <= 0)
+        {
+            m_pitch.clear();
+            m_throttle.clear();
+            return false;
+        }
+
+        return true;
+    }
+
+    bool AscentTable::save(std::string path)
+    {
+        std::ofstream file(path, std::ios::binary);
+        uint32_t count = m_pitch.size();
+
+        file.write("KAT1", 4);
+        file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+        file.write(reinterpret_cast<const char*>(&m_altitude_start), sizeof(float));
+        file.write(reinterpret_cast<const char*>(&m_altitude_step), sizeof(float));
+        file.write(reinterpret_cast<const char*>(&m_target_altitude), sizeof(float));
+
+        for (uint32_t i = 0; i < count; i++)
+        {
+            file.write(reinterpret_cast<const char*>(&m_pitch[i]), sizeof(float));
+            file.write(reinterpret_cast<const char*>(&m_throttle[i]), sizeof(float));
+        }
+
+        return bool(file);
+    }
+
+    /* Appends the next row on the grid. */
+    void AscentTable::add(double pitch, double throttle)
+    {
+        m_pitch.push_back(pitch);
+        m_throttle.push_back(throttle);
+    }
+
+    bool AscentTable::empty()
+    {
+        return m_pitch.empty();
+    }
+
+    double AscentTable::pitch(double altitude)
+    {
+        return interpolate(m_pitch, altitude);
+    }
+
+    double AscentTable::throttle(double altitude)
+    {
+        return interpolate(m_throttle, altitude);
+    }
+
+    double AscentTable::target_altitude()
+    {
+        return m_target_altitude;
+    }
+
+    /* Altitude of the row that add() appends next. */
+    double AscentTable::next_altitude()
+    {
+        return m_altitude_start + m_altitude_step * m_pitch.size();
+    }
+
+    /* Linear interpolation between grid rows, clamped to the ends of the table. */
+    double AscentTable::interpolate(std::vector<float>& values, double altitude)
+    {
+        if (values.empty())
+        {
+            return 0.0;
+        }
+
+        auto position = std::max(0.0, (altitude - m_altitude_start) / m_altitude_step);
+        auto index = std::min<size_t>(position, values.size() - 1);
+
+        if (index + 1 >= values.size())
+        {
+            return values.back();
+        }
+
+        auto fraction = position - index;
+
+        return values[index] + (values[index + 1] - values[index]) * fraction;
+    }
+}
@@ -0,0 +1,236 @@
+#pragma once
+
+#include <math.h>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include "enums/types.hpp"
+#include "vector3.hpp"
+#include "quaternion.hpp"
+#include "loop_statistics.hpp"
+
+namespace KSP
+{
+    /**
+     * Client-side attitude controller that writes pitch/yaw/roll directly.
+     *
+     * Runs on its own thread at a fixed rate. The attitude error is the shortest-arc
+     * quaternion between the vessel's forward axis and the target direction, expressed
+     * in the vessel frame. Each axis uses a time-optimal rate target limited by the
+     * available angular acceleration, followed by a rate PI loop whose output is scaled
+     * by moment of inertia / available torque (feedforward).
+     *
+     * Vessel frame: x = right (pitch), y = forward (roll), z = down (yaw).
+     */
+    class AttitudeController
+    {
+    private:
+        Vessel m_vessel;
+        krpc::Stream<std::tuple<double, double, double, double>> m_rotation_stream;
+        krpc::Stream<std::tuple<double, double, double>> m_angular_velocity_stream;
+        krpc::Stream<std::tuple<double, double, double>> m_moment_of_inertia_stream;
+        krpc::Stream<std::tuple<std::tuple<double, double, double>, std::tuple<double, double, double>>> m_available_torque_stream;
+        double m_period;
+        std::thread m_thread;
+        std::atomic<bool> m_running;
+        std::mutex m_mutex;
+        Vector3 m_target_direction;
+        Vector3 m_error;
+        double m_rate_integral[3];
+        LoopStatistics m_statistics;
+    public:
+        /* Gains, shared by all axes. */
+        double angle_gain = 2.0;
+        double rate_gain = 6.0;
+        double rate_integral_gain = 1.0;
+        double max_rate = 0.5;
+        double braking_factor = 0.5;
+    public:
+        AttitudeController(Vessel vessel, ReferenceFrame reference_frame, double rate = 50.0);
+        ~AttitudeController();
+    public:
+        void start();
+        void stop();
+        bool running();
+        void set_target_direction(Vector3 direction);
+        Vector3 error();
+        LoopStatistics statistics();
+    private:
+        void run();
+        void step(double dt);
+        double axis_control(int axis, double error, double rate, double inertia, double torque, double dt);
+    };
+
+    AttitudeController::AttitudeController(Vessel vessel, ReferenceFrame reference_frame, double rate)
+        : m_vessel(vessel),
+          m_rotation_stream(vessel.rotation_stream(reference_frame)),
+          m_angular_velocity_stream(vessel.angular_velocity_stream(reference_frame)),
+          m_moment_of_inertia_stream(vessel.moment_of_inertia_stream()),
+          m_available_torque_stream(vessel.available_torque_stream()),
+          m_period(1.0 / rate),
+          m_running(false),
+          m_target_direction(1, 0, 0),
+          m_rate_integral{0.0, 0.0, 0.0}
+    {
+    }
+
+    AttitudeController::~AttitudeController()
+    {
+        stop();
+    }
+
+    void AttitudeController::start()
+    {
+        if (m_running)
+        {
+            return;
+        }
+
+        /* The server autopilot and SAS would fight the control inputs. */
+        m_vessel.auto_pilot().disengage();
+        m_vessel.control().set_sas(false);
+
+        std::fill(m_rate_integral, m_rate_integral + 3, 0.0);
+        m_statistics.reset();
+        m_running = true;
+        m_thread = std::thread(&AttitudeController::run, this);
+    }
+
+    void AttitudeController::stop()
+    {
+        if (!m_running)
+        {
+            return;
+        }
+
+        m_running = false;
+        m_thread.join();
+
+        m_vessel.control().set_pitch(0);
+        m_vessel.control().set_yaw(0);
+        m_vessel.control().set_roll(0);
+    }
+
+    bool AttitudeController::running()
+    {
+        return m_running;
+    }
+
+    void AttitudeController::set_target_direction(Vector3 direction)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_target_direction = direction;
+    }
+
+    /* Last attitude error as (pitch, yaw, roll) in radians. */
+    Vector3 AttitudeController::error()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_error;
+    }
+
+    LoopStatistics AttitudeController::statistics()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_statistics;
+    }
+
+    void AttitudeController::run()
+    {
+        auto period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(m_period));
+        auto next = std::chrono::steady_clock::now();
+
+        while (m_running)
+        {
+            LoopClock clock;
+
+            step(m_period);
+
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_statistics.add(clock.elapsed(), m_period);
+            }
+
+            /* Fixed rate; skip missed ticks instead of bursting to catch up. */
+            next += period;
+            auto now = std::chrono::steady_clock::now();
+
+            if (next < now)
+            {
+                next = now;
+            }
+
+            std::this_thread::sleep_until(next);
+        }
+    }
+
+    void AttitudeController::step(double dt)
+    {
+        Vector3 target;
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            target = m_target_direction;
+        }
+
+        auto rotation = Quaternion(m_rotation_stream());
+        auto inverse = rotation.conjugate();
+        auto inertia = Vector3(m_moment_of_inertia_stream());
+        auto torque = m_available_torque_stream();
+        auto torque_positive = Vector3(std::get<0>(torque));
+        auto torque_negative = Vector3(std::get<1>(torque));
+
+        /* Error and angular velocity in the vessel frame. */
+        auto target_local = inverse.rotate(target);
+        auto error = Quaternion::from_to(Vector3(0, 1, 0), target_local).rotation_vector();
+        auto omega = inverse.rotate(Vector3(m_angular_velocity_stream()));
+
+        /* kRPC frames are left-handed, so positive control inputs oppose the axis components. */
+        auto pitch_error = -error.m_x;
+        auto yaw_error = -error.m_z;
+        auto pitch_rate = -omega.m_x;
+        auto yaw_rate = -omega.m_z;
+        auto roll_rate = -omega.m_y;
+
+        auto pitch = axis_control(0, pitch_error, pitch_rate, inertia.m_x, std::min(abs(torque_positive.m_x), abs(torque_negative.m_x)), dt);
+        auto yaw = axis_control(2, yaw_error, yaw_rate, inertia.m_z, std::min(abs(torque_positive.m_z), abs(torque_negative.m_z)), dt);
+        auto roll = axis_control(1, 0.0, roll_rate, inertia.m_y, std::min(abs(torque_positive.m_y), abs(torque_negative.m_y)), dt);
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_error = Vector3(pitch_error, yaw_error, 0.0);
+        }
+
+        auto control = m_vessel.control();
+        control.set_pitch(pitch);
+        control.set_yaw(yaw);
+        control.set_roll(roll);
+    }
+
+    double AttitudeController::axis_control(int axis, double error, double rate, double inertia, double torque, double dt)
+    {
+        if (torque <= 0.0 || inertia <= 0.0)
+        {
+            return 0.0;
+        }
+
+        /* Fastest rate from which we can still stop at the target, capped linearly near zero. */
+        auto max_acceleration = torque / inertia;
+        auto stopping_rate = sqrt(2 * max_acceleration * braking_factor * abs(error));
+        auto target_rate = std::copysign(std::min({stopping_rate, angle_gain * abs(error), max_rate}), error);
+        auto rate_error = target_rate - rate;
+
+        auto acceleration = rate_gain * rate_error + rate_integral_gain * m_rate_integral[axis];
+        auto output = acceleration * inertia / torque;
+
+        /* Only integrate while the actuator is not saturated. */
+        if (abs(output) < 1.0)
+        {
+            m_rate_integral[axis] += rate_error * dt;
+        }
+
+        return std::max(-1.0, std::min(1.0, output));
+    }
+}
@@ -0,0 +1,186 @@
+#pragma once
+
+#include <math.h>
+#include <array>
+#include <algorithm>
+#include "constants.hpp"
+
+namespace KSP
+{
+    const int CUTOFF_SAMPLES = 8;
+
+    /**
+     * Predicts when the end of a burn falls, from remaining delta-v telemetry.
+     *
+     * A least-squares line through the recent (time, remaining delta-v) samples at the current
+     * throttle gives the acceleration. Throttle is stepped down so that the last part of the burn
+     * takes at least min_frames physics frames. The cutoff is put on the physics frame boundary
+     * where the remaining delta-v is closest to zero. Frame boundaries are found from the phase
+     * of the sampled UT.
+     */
+    class BurnCutoff
+    {
+    private:
+        std::array<double, CUTOFF_SAMPLES> m_time;
+        std::array<double, CUTOFF_SAMPLES> m_delta_v;
+        int m_count = 0;
+        int m_next = 0;
+        double m_throttle = 0.0;
+        double m_full_acceleration = 0.0;
+        double m_frame;
+    public:
+        /* Physics frames the final throttle step should last at least. */
+        double min_frames = 10.0;
+        /* Time between sending a throttle command and it taking effect, in seconds. */
+        double command_latency = PHYSICS_FRAME / 2;
+        /* Throttle steps as fractions of the burn throttle. */
+        std::array<double, 4> steps = {1.0, 0.5, 0.25, 0.1};
+    public:
+        BurnCutoff(double frame = PHYSICS_FRAME);
+        ~BurnCutoff();
+    public:
+        void add(double time, double remaining_delta_v, double throttle);
+        double acceleration();
+        double throttle(double burn_throttle);
+        double cutoff_time();
+        double send_time();
+        double predicted_residual();
+        bool ready();
+    private:
+        int latest();
+        double frame_boundary(double time);
+    };
+
+    BurnCutoff::BurnCutoff(double frame) : m_frame(frame)
+    {
+    }
+
+    BurnCutoff::~BurnCutoff()
+    {
+    }
+
+    /* Samples at a different throttle start a new fit. Repeated times (no new physics frame) are ignored. */
+    void BurnCutoff::add(double time, double remaining_delta_v, double throttle)
+    {
+        if (throttle != m_throttle)
+        {
+            m_count = 0;
+            m_next = 0;
+            m_throttle = throttle;
+        }
+
+        if (m_count > 0 && time <= m_time[latest()])
+        {
+            return;
+        }
+
+        m_time[m_next] = time;
+        m_delta_v[m_next] = remaining_delta_v;
+        m_next = (m_next + 1) % CUTOFF_SAMPLES;
+        m_count = std::min(m_count + 1, CUTOFF_SAMPLES);
+
+        if (m_count >= 3 && m_throttle > 0.0)
+        {
+            m_full_acceleration = acceleration() / m_throttle;
+        }
+    }
+
+    /* Rate at which the remaining delta-v is falling, in m/s^2. */
+    double BurnCutoff::acceleration()
+    {
+        if (m_count < 3)
+        {
+            return m_full_acceleration * m_throttle;
+        }
+
+        auto mean_time = 0.0;
+        auto mean_delta_v = 0.0;
+
+        for (int i = 0; i < m_count; i++)
+        {
+            mean_time += m_time[i] / m_count;
+            mean_delta_v += m_delta_v[i] / m_count;
+        }
+
+        auto covariance = 0.0;
+        auto variance = 0.0;
+
+        for (int i = 0; i < m_count; i++)
+        {
+            covariance += (m_time[i] - mean_time) * (m_delta_v[i] - mean_delta_v);
+            variance += (m_time[i] - mean_time) * (m_time[i] - mean_time);
+        }
+
+        return variance > 0.0 ? -covariance / variance : m_full_acceleration * m_throttle;
+    }
+
+    /* Largest throttle step that still leaves min_frames frames of burning. */
+    double BurnCutoff::throttle(double burn_throttle)
+    {
+        if (m_count == 0 || m_full_acceleration <= 0.0)
+        {
+            return m_throttle > 0.0 ? m_throttle : burn_throttle;
+        }
+
+        auto remaining = m_delta_v[latest()];
+
+        for (auto step : steps)
+        {
+            auto candidate = std::min(m_throttle, step * burn_throttle);
+
+            if (remaining / (m_full_acceleration * candidate) >= min_frames * m_frame)
+            {
+                return candidate;
+            }
+        }
+
+        return std::min(m_throttle, steps.back() * burn_throttle);
+    }
+
+    /* Frame boundary at which to cut off. */
+    double BurnCutoff::cutoff_time()
+    {
+        auto a = acceleration();
+        auto i = latest();
+
+        if (a <= 0.0)
+        {
+            return m_time[i];
+        }
+
+        return frame_boundary(m_time[i] + m_delta_v[i] / a);
+    }
+
+    /* When to send the cutoff command so it lands on the cutoff frame. */
+    double BurnCutoff::send_time()
+    {
+        return cutoff_time() - command_latency;
+    }
+
+    /* Delta-v expected to be left (negative: overshot) when cutting off at cutoff_time(). */
+    double BurnCutoff::predicted_residual()
+    {
+        auto i = latest();
+
+        return m_delta_v[i] - acceleration() * (cutoff_time() - m_time[i]);
+    }
+
+    /* Enough samples at the current throttle for a fit. */
+    bool BurnCutoff::ready()
+    {
+        return m_count >= 3;
+    }
+
+    int BurnCutoff::latest()
+    {
+        return (m_next + CUTOFF_SAMPLES - 1) % CUTOFF_SAMPLES;
+    }
+
+    /* Nearest frame boundary, using the sample times as the frame phase. */
+    double BurnCutoff::frame_boundary(double time)
+    {
+        auto reference = m_time[latest()];
+
+        return reference + round((time - reference) / m_frame) * m_frame;
+    }
+}
@@ -0,0 +1,274 @@
+#pragma once
+
+#include <math.h>
+#include <vector>
+#include <map>
+#include "enums/types.hpp"
+#include "constants.hpp"
+
+namespace KSP
+{
+    /* One decouple stage of a burn. Masses are of the whole vessel, times are in UT. */
+    struct BurnStage
+    {
+        int decouple_stage;
+        double start_mass;
+        double propellant_mass;
+        /* Mass dropped when the stage is decoupled. */
+        double dropped_mass;
+        double thrust;
+        double exhaust_velocity;
+        double delta_v;
+        double start;
+        double end;
+    };
+
+    /**
+     * Multi-stage burn plan built from a single snapshot of the vessel's parts and engines.
+     * The plan holds when each stage starts and burns out, when to stage and when to cut off.
+     * During the burn, update() re-plans from the measured remaining delta-v and vessel mass.
+     * It only re-integrates the cached stages, so no further part-tree queries are needed.
+     */
+    class BurnPlan
+    {
+    private:
+        std::vector<BurnStage> m_stages;
+        size_t m_active = 0;
+        size_t m_used = 0;
+        double m_start_time = 0.0;
+        double m_stop_time = 0.0;
+        double m_lead_time = 0.0;
+        bool m_feasible = false;
+    public:
+        BurnPlan(Vessel vessel, double throttle);
+        BurnPlan(std::vector<BurnStage> stages);
+        ~BurnPlan();
+    public:
+        void plan(double delta_v, double node_time);
+        void update(double time, double remaining_delta_v, double mass);
+        bool stage_due(double time);
+        void staged();
+        double start_time();
+        double stop_time();
+        double lead_time();
+        double total_time();
+        bool feasible();
+        size_t active_stage();
+        size_t stage_count();
+        BurnStage stage(size_t index);
+    private:
+        double integrate(double start_time, double delta_v, double lead_delta_v);
+    };
+
+    BurnPlan::BurnPlan(Vessel vessel, double throttle)
+    {
+        std::map<int, double> mass;
+        std::map<int, double> dry_mass;
+        std::map<int, double> thrust;
+        std::map<int, double> mass_flow;
+
+        /* One walk over the parts and one over the engines. */
+        for (auto part : vessel.parts().all())
+        {
+            auto stage = part.decouple_stage();
+
+            mass[stage] += part.mass();
+            dry_mass[stage] += part.dry_mass();
+        }
+
+        for (auto engine : vessel.parts().engines())
+        {
+            auto stage = engine.part().decouple_stage();
+            auto engine_thrust = engine.available_thrust() * throttle;
+            auto isp = engine.specific_impulse();
+
+            /* Both from the current limiter and pressure, so their ratio is the real exhaust velocity. */
+            if (engine_thrust > 0.0 && isp > 0.0)
+            {
+                thrust[stage] += engine_thrust;
+                mass_flow[stage] += engine_thrust / (isp * STANDARD_GRAVITY);
+            }
+        }
+
+        /* Highest decouple stage is dropped first. */
+        auto total_mass = 0.0;
+
+        for (auto& [stage, stage_mass] : mass)
+        {
+            total_mass += stage_mass;
+        }
+
+        for (auto it = mass.rbegin(); it != mass.rend(); it++)
+        {
+            auto stage = it->first;
+            auto propellant = it->second - dry_mass[stage];
+
+            if (thrust[stage] > 0.0 && mass_flow[stage] > 0.0 && propellant > 0.0)
+            {
+                auto exhaust_velocity = thrust[stage] / mass_flow[stage];
+
+                m_stages.push_back({stage, total_mass, propellant, dry_mass[stage], thrust[stage], exhaust_velocity, 0.0, 0.0, 0.0});
+            }
+
+            total_mass -= it->second;
+        }
+
+        /* Stages without engines in between are dropped together with the stage below them. */
+        for (size_t i = 0; i + 1 < m_stages.size(); i++)
+        {
+            m_stages[i].dropped_mass = m_stages[i].start_mass - m_stages[i].propellant_mass - m_stages[i + 1].start_mass;
+        }
+    }
+
+    BurnPlan::BurnPlan(std::vector<BurnStage> stages) : m_stages(stages)
+    {
+    }
+
+    BurnPlan::~BurnPlan()
+    {
+    }
+
+    /* Full plan for a burn centred on the node: half of the delta-v before it, half after. */
+    void BurnPlan::plan(double delta_v, double node_time)
+    {
+        m_active = 0;
+        m_lead_time = integrate(0.0, delta_v, delta_v / 2);
+        m_start_time = node_time - m_lead_time;
+
+        for (auto& stage : m_stages)
+        {
+            stage.start += m_start_time;
+            stage.end += m_start_time;
+        }
+
+        m_stop_time += m_start_time;
+    }
+
+    /**
+     * Re-plans the rest of the burn from now, with the measured remaining delta-v and mass.
+     * The mass corrects the propellant left in the active stage, which moves staging and cutoff.
+     */
+    void BurnPlan::update(double time, double remaining_delta_v, double mass)
+    {
+        if (m_active >= m_stages.size())
+        {
+            return;
+        }
+
+        auto& active = m_stages[m_active];
+        auto burnout_mass = active.start_mass - active.propellant_mass;
+
+        /* Mass above the stage's burnout mass is propellant still in the active stage. */
+        active.start_mass = std::max(mass, burnout_mass);
+        active.propellant_mass = active.start_mass - burnout_mass;
+
+        integrate(time, remaining_delta_v, -1.0);
+    }
+
+    /* Staging is due when the active stage burns out while more stages are needed. */
+    bool BurnPlan::stage_due(double time)
+    {
+        return m_active + 1 < m_used && time >= m_stages[m_active].end;
+    }
+
+    void BurnPlan::staged()
+    {
+        m_active++;
+    }
+
+    double BurnPlan::start_time()
+    {
+        return m_start_time;
+    }
+
+    double BurnPlan::stop_time()
+    {
+        return m_stop_time;
+    }
+
+    double BurnPlan::lead_time()
+    {
+        return m_lead_time;
+    }
+
+    double BurnPlan::total_time()
+    {
+        return m_stop_time - m_start_time;
+    }
+
+    /* False if the stages do not hold the planned delta-v. */
+    bool BurnPlan::feasible()
+    {
+        return m_feasible;
+    }
+
+    size_t BurnPlan::active_stage()
+    {
+        return m_active;
+    }
+
+    size_t BurnPlan::stage_count()
+    {
+        return m_used;
+    }
+
+    BurnStage BurnPlan::stage(size_t index)
+    {
+        return m_stages[index];
+    }
+
+    /**
+     * Lays the stages from the active one onwards out in time from the start time until the
+     * delta-v is delivered. Returns the time from the start at which the lead delta-v has been
+     * burnt, if one is given.
+     */
+    double BurnPlan::integrate(double start_time, double delta_v, double lead_delta_v)
+    {
+        auto time = start_time;
+        auto delivered = 0.0;
+        auto lead_time = 0.0;
+
+        m_feasible = false;
+        m_used = m_active;
+
+        for (size_t i = m_active; i < m_stages.size(); i++)
+        {
+            auto& stage = m_stages[i];
+            auto ve = stage.exhaust_velocity;
+
+            /* Later stages start from the previous stage's burnout mass minus what it drops. */
+            if (i > m_active)
+            {
+                auto& previous = m_stages[i - 1];
+
+                stage.start_mass = previous.start_mass - previous.propellant_mass - previous.dropped_mass;
+            }
+
+            stage.delta_v = ve * log(stage.start_mass / (stage.start_mass - stage.propellant_mass));
+
+            auto burn_delta_v = std::min(stage.delta_v, delta_v - delivered);
+            auto burn_time = [&](double dv) { return stage.start_mass * (1 - exp(-dv / ve)) * ve / stage.thrust; };
+
+            if (lead_delta_v >= 0.0 && delivered < lead_delta_v && delivered + burn_delta_v >= lead_delta_v)
+            {
+                lead_time = time - start_time + burn_time(lead_delta_v - delivered);
+            }
+
+            stage.start = time;
+            stage.end = time + burn_time(stage.delta_v);
+            time += burn_time(burn_delta_v);
+            delivered += burn_delta_v;
+            m_used = i + 1;
+
+            if (delivered >= delta_v - 1e-9)
+            {
+                m_feasible = true;
+                break;
+            }
+        }
+
+        m_stop_time = time;
+
+        return lead_time;
+    }
+}
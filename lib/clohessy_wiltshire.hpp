@@ -0,0 +1,179 @@
+#pragma once
+
+#include <math.h>
+#include <algorithm>
+#include <stdexcept>
+#include "vector3.hpp"
+
+namespace KSP
+{
+    /* Smallest |sin(n t)|, or determinant relative to its scale, for a CW transfer time. */
+    const double SINGULAR_TRANSFER = 1e-6;
+
+    /* Position and velocity of the chaser relative to the target, in the target's Hill frame. */
+    struct RelativeState
+    {
+        Vector3 position;
+        Vector3 velocity;
+    };
+
+    /**
+     * Rotating frame of a target in a near-circular orbit: x radial out, y along-track, z orbit
+     * normal. Built from the target's inertial position and velocity. The axes are found with
+     * cross products only, so the handedness of kRPC's frames does not matter.
+     */
+    class HillFrame
+    {
+    private:
+        Vector3 m_position;
+        Vector3 m_velocity;
+        Vector3 m_radial;
+        Vector3 m_along_track;
+        Vector3 m_normal;
+        double m_angular_rate;
+        double m_mean_motion;
+    public:
+        HillFrame(Vector3 target_position, Vector3 target_velocity, double gravitational_parameter);
+        ~HillFrame();
+    public:
+        RelativeState relative(Vector3 position, Vector3 velocity);
+        Vector3 to_inertial(Vector3 vector);
+        double mean_motion();
+    };
+
+    /**
+     * Clohessy-Wiltshire (Hill) equations: linear relative motion near a target in a circular
+     * orbit. Valid while the separation is small compared to the orbit radius, i.e. the last
+     * few kilometres of a rendezvous.
+     */
+    class ClohessyWiltshire
+    {
+    private:
+        double m_n;
+    public:
+        ClohessyWiltshire(double mean_motion);
+        ~ClohessyWiltshire();
+    public:
+        RelativeState propagate(RelativeState state, double time);
+        Vector3 departure_velocity(Vector3 position, Vector3 target_position, double time);
+    };
+
+    HillFrame::HillFrame(Vector3 target_position, Vector3 target_velocity, double gravitational_parameter)
+        : m_position(target_position), m_velocity(target_velocity)
+    {
+        auto radius = target_position.length();
+        auto momentum = target_position.cross(target_velocity);
+        auto semi_major_axis = 1 / (2 / radius - target_velocity.dot(target_velocity) / gravitational_parameter);
+
+        m_radial = target_position.normalize();
+        m_normal = momentum.normalize();
+        m_along_track = m_normal.cross(m_radial);
+        m_angular_rate = momentum.length() / (radius * radius);
+        m_mean_motion = sqrt(gravitational_parameter / pow(semi_major_axis, 3));
+    }
+
+    HillFrame::~HillFrame()
+    {
+    }
+
+    /* The velocity is relative to the rotating frame, as the CW equations expect. */
+    RelativeState HillFrame::relative(Vector3 position, Vector3 velocity)
+    {
+        auto offset = position - m_position;
+        auto rotation = m_normal * m_angular_rate;
+        auto relative_velocity = velocity - m_velocity - rotation.cross(offset);
+
+        return {
+            Vector3(offset.dot(m_radial), offset.dot(m_along_track), offset.dot(m_normal)),
+            Vector3(relative_velocity.dot(m_radial), relative_velocity.dot(m_along_track), relative_velocity.dot(m_normal))
+        };
+    }
+
+    /* For burn directions: an impulse is the same in the rotating and inertial frame. */
+    Vector3 HillFrame::to_inertial(Vector3 vector)
+    {
+        return m_radial * vector.m_x + m_along_track * vector.m_y + m_normal * vector.m_z;
+    }
+
+    double HillFrame::mean_motion()
+    {
+        return m_mean_motion;
+    }
+
+    ClohessyWiltshire::ClohessyWiltshire(double mean_motion) : m_n(mean_motion)
+    {
+    }
+
+    ClohessyWiltshire::~ClohessyWiltshire()
+    {
+    }
+
+    RelativeState ClohessyWiltshire::propagate(RelativeState state, double time)
+    {
+        auto n = m_n;
+        auto s = sin(n * time);
+        auto c = cos(n * time);
+        auto [x, y, z] = state.position.to_tuple();
+        auto [vx, vy, vz] = state.velocity.to_tuple();
+
+        return {
+            Vector3(
+                (4 - 3 * c) * x + s / n * vx + 2 * (1 - c) / n * vy,
+                6 * (s - n * time) * x + y - 2 * (1 - c) / n * vx + (4 * s - 3 * n * time) / n * vy,
+                c * z + s / n * vz
+            ),
+            Vector3(
+                3 * n * s * x + c * vx + 2 * s * vy,
+                -6 * n * (1 - c) * x - 2 * s * vx + (4 * c - 3) * vy,
+                -n * s * z + c * vz
+            )
+        };
+    }
+
+    /**
+     * Velocity needed at position to reach target_position after time. Throws
+     * std::invalid_argument near a transfer time where the equations are singular: in plane at
+     * a whole number of orbits and a few more times past the first, out of plane at a whole
+     * number of half orbits unless the target is where the motion returns by itself.
+     */
+    Vector3 ClohessyWiltshire::departure_velocity(Vector3 position, Vector3 target_position, double time)
+    {
+        auto n = m_n;
+        auto s = sin(n * time);
+        auto c = cos(n * time);
+        auto [x, y, z] = position.to_tuple();
+        auto rz = target_position.m_z - c * z;
+
+        /* In plane: solve the 2x2 block of the position-from-velocity matrix. */
+        auto a = s / n;
+        auto b = 2 * (1 - c) / n;
+        auto d = (4 * s - 3 * n * time) / n;
+        auto rx = target_position.m_x - (4 - 3 * c) * x;
+        auto ry = target_position.m_y - 6 * (s - n * time) * x - y;
+        auto determinant = a * d + b * b;
+
+        /* The entries scale with 1 / n, so this is relative. */
+        if (abs(determinant * n * n) < SINGULAR_TRANSFER)
+        {
+            throw std::invalid_argument("CW transfer time is singular in plane");
+        }
+
+        /* Out of plane, such a time only reaches where the motion returns anyway, with any velocity. */
+        if (abs(s) < SINGULAR_TRANSFER)
+        {
+            if (abs(rz) > 1e-3 * (1.0 + abs(z)))
+            {
+                throw std::invalid_argument("CW transfer time is singular out of plane");
+            }
+
+            rz = 0.0;
+            s = 1.0;
+        }
+
+        return Vector3(
+            (d * rx - b * ry) / determinant,
+            (b * rx + a * ry) / determinant,
+            n * rz / s
+        );
+    }
+}
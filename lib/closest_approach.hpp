@@ -0,0 +1,262 @@
+#pragma once
+
+#include <math.h>
+#include <vector>
+#include <algorithm>
+#include "vector3.hpp"
+#include "kepler_orbit.hpp"
+
+namespace KSP
+{
+    /* Relative vectors are of the second orbit with respect to the first. */
+    struct Approach
+    {
+        double time;
+        double distance;
+        Vector3 relative_position;
+        Vector3 relative_velocity;
+    };
+
+    /**
+     * Brent's method: root of function in [a, b], where fa and fb have opposite signs.
+     * Combines bisection with secant and inverse quadratic steps, so it never does worse than
+     * bisection and usually converges in a handful of evaluations.
+     */
+    template <typename F>
+    double brent_root(F function, double a, double b, double fa, double fb, double tolerance)
+    {
+        auto c = a;
+        auto fc = fa;
+        auto d = b - a;
+        auto e = d;
+
+        for (int i = 0; i < 100; i++)
+        {
+            if ((fb > 0) == (fc > 0))
+            {
+                c = a;
+                fc = fa;
+                d = b - a;
+                e = d;
+            }
+
+            if (abs(fc) < abs(fb))
+            {
+                a = b;
+                b = c;
+                c = a;
+                fa = fb;
+                fb = fc;
+                fc = fa;
+            }
+
+            auto tolerance_1 = 2 * 1e-15 * abs(b) + tolerance / 2;
+            auto middle = (c - b) / 2;
+
+            if (abs(middle) <= tolerance_1 || fb == 0)
+            {
+                return b;
+            }
+
+            if (abs(e) >= tolerance_1 && abs(fa) > abs(fb))
+            {
+                auto s = fb / fa;
+                double p, q;
+
+                if (a == c)
+                {
+                    p = 2 * middle * s;
+                    q = 1 - s;
+                }
+                else
+                {
+                    auto r = fb / fc;
+                    auto t = fa / fc;
+
+                    p = s * (2 * middle * t * (t - r) - (b - a) * (r - 1));
+                    q = (t - 1) * (r - 1) * (s - 1);
+                }
+
+                if (p > 0)
+                {
+                    q = -q;
+                }
+
+                p = abs(p);
+
+                if (2 * p < std::min(3 * middle * q - abs(tolerance_1 * q), abs(e * q)))
+                {
+                    e = d;
+                    d = p / q;
+                }
+                else
+                {
+                    d = middle;
+                    e = d;
+                }
+            }
+            else
+            {
+                d = middle;
+                e = d;
+            }
+
+            a = b;
+            fa = fb;
+            b += abs(d) > tolerance_1 ? d : (middle > 0 ? tolerance_1 : -tolerance_1);
+            fb = function(b);
+        }
+
+        return b;
+    }
+
+    /**
+     * Closest approaches between two locally propagated orbits, e.g. a vessel and its target.
+     * The distance has a minimum where the range rate, relative position dot relative velocity,
+     * goes from negative to positive. The range rate is sampled over the revolutions ahead to
+     * bracket those crossings, and each one is solved with Brent's method. Each sample costs two
+     * Kepler solves, so the next approach of two low orbits takes a few microseconds.
+     */
+    class ClosestApproachFinder
+    {
+    private:
+        KeplerOrbit m_first;
+        KeplerOrbit m_second;
+    public:
+        /* Range-rate samples per revolution of the faster orbit. */
+        int samples_per_revolution = 36;
+        /* Longest search, in revolutions of the slower orbit. */
+        double max_revolutions = 200.0;
+        double time_tolerance = 1e-3;
+    public:
+        ClosestApproachFinder(KeplerOrbit first, KeplerOrbit second);
+        ~ClosestApproachFinder();
+    public:
+        std::vector<Approach> find(double start, size_t count);
+        Approach next(double start);
+        Approach minimum(double start, double end);
+        Approach at(double time);
+    private:
+        double range_rate(double time);
+    };
+
+    ClosestApproachFinder::ClosestApproachFinder(KeplerOrbit first, KeplerOrbit second) : m_first(first), m_second(second)
+    {
+    }
+
+    ClosestApproachFinder::~ClosestApproachFinder()
+    {
+    }
+
+    /* The next count approaches after start, in time order. Fewer if the horizon ends first. */
+    std::vector<Approach> ClosestApproachFinder::find(double start, size_t count)
+    {
+        std::vector<Approach> approaches;
+
+        auto fastest = std::max(m_first.mean_motion(), m_second.mean_motion());
+        auto slowest = std::min(m_first.mean_motion(), m_second.mean_motion());
+        auto step = 2 * M_PI / fastest / samples_per_revolution;
+
+        /**
+         * Nearby orbits meet about once per synodic period, so that sets the horizon.
+         * Open orbits are searched over the time one of them takes for a radian of mean anomaly.
+         */
+        auto synodic_period = 2 * M_PI / std::max(fastest - slowest, 1e-12);
+        auto horizon = (count + 1) * std::max(synodic_period, 2 * M_PI / slowest);
+
+        horizon = m_first.closed() && m_second.closed() ? std::min(horizon, max_revolutions * 2 * M_PI / slowest) : 1 / slowest;
+
+        auto end = start + horizon;
+
+        auto time = start;
+        auto rate = range_rate(time);
+
+        while (approaches.size() < count && time < end)
+        {
+            auto next_time = std::min(time + step, end);
+            auto next_rate = range_rate(next_time);
+
+            if (rate < 0 && next_rate >= 0)
+            {
+                auto root = brent_root([this](double t) { return range_rate(t); }, time, next_time, rate, next_rate, time_tolerance);
+
+                approaches.push_back(at(root));
+            }
+
+            time = next_time;
+            rate = next_rate;
+        }
+
+        return approaches;
+    }
+
+    /**
+     * The next approach after start. If the distance only grows within the horizon, the start
+     * itself is returned, as it is the closest point ahead.
+     */
+    Approach ClosestApproachFinder::next(double start)
+    {
+        auto approaches = find(start, 1);
+
+        return approaches.empty() ? at(start) : approaches.front();
+    }
+
+    /* Closest point within [start, end]: the lowest local minimum inside it, or an end. */
+    Approach ClosestApproachFinder::minimum(double start, double end)
+    {
+        auto fastest = std::max(m_first.mean_motion(), m_second.mean_motion());
+        auto step = 2 * M_PI / fastest / samples_per_revolution;
+        auto best = at(start);
+        auto last = at(end);
+
+        if (last.distance < best.distance)
+        {
+            best = last;
+        }
+
+        auto time = start;
+        auto rate = range_rate(time);
+
+        while (time < end)
+        {
+            auto next_time = std::min(time + step, end);
+            auto next_rate = range_rate(next_time);
+
+            if (rate < 0 && next_rate >= 0)
+            {
+                auto root = brent_root([this](double t) { return range_rate(t); }, time, next_time, rate, next_rate, time_tolerance);
+                auto approach = at(root);
+
+                if (approach.distance < best.distance)
+                {
+                    best = approach;
+                }
+            }
+
+            time = next_time;
+            rate = next_rate;
+        }
+
+        return best;
+    }
+
+    Approach ClosestApproachFinder::at(double time)
+    {
+        Vector3 first_position, first_velocity, second_position, second_velocity;
+
+        m_first.state_at(time, first_position, first_velocity);
+        m_second.state_at(time, second_position, second_velocity);
+
+        auto relative_position = second_position - first_position;
+
+        return {time, relative_position.length(), relative_position, second_velocity - first_velocity};
+    }
+
+    /* Half the time derivative of the squared distance. */
+    double ClosestApproachFinder::range_rate(double time)
+    {
+        auto approach = at(time);
+
+        return approach.relative_position.dot(approach.relative_velocity);
+    }
+}
@@ -0,0 +1,216 @@
+#pragma once
+
+#include <functional>
+#include "connection.hpp"
+#include "enums/types.hpp"
+
+namespace KSP
+{
+    /**
+     * Event made from a Condition. The server evaluates the condition and the client only gets
+     * a stream update when it becomes true, so checking it costs no RPC.
+     */
+    class Trigger
+    {
+    private:
+        krpc::Event m_event;
+        krpc::Stream<bool> m_stream;
+    public:
+        Trigger(krpc::Event event);
+        ~Trigger();
+    public:
+        void wait(double timeout = -1);
+        bool triggered();
+        int on_trigger(std::function<void()> callback);
+        krpc::Event& event();
+    };
+
+    /**
+     * Numeric server-side value, e.g. a stream-able call or a constant, that can be combined with
+     * arithmetic and compared into a Condition:
+     *
+     *   auto altitude = KSP::Quantity(connection, vessel.flight(frame).surface_altitude_call());
+     *   auto vspeed = KSP::Quantity(connection, vessel.flight(body_frame).vertical_speed_call());
+     *   auto trigger = (altitude < 2000 && vspeed < -5).trigger(connection);
+     *
+     * Values are compared as doubles, so float and integer calls can be mixed with constants.
+     */
+    class Quantity
+    {
+    private:
+        krpc::Client m_client;
+        Expression m_expression;
+    public:
+        Quantity(Connection& connection, krpc::schema::ProcedureCall call);
+        Quantity(krpc::Client client, Expression expression);
+        ~Quantity();
+    public:
+        Expression expression();
+        krpc::Client client();
+        Quantity constant(double value);
+    };
+
+    class Condition
+    {
+    private:
+        krpc::Client m_client;
+        Expression m_expression;
+    public:
+        Condition(krpc::Client client, Expression expression);
+        ~Condition();
+    public:
+        Expression expression();
+        krpc::Client client();
+        Trigger trigger(Connection& connection);
+    };
+
+    Trigger::Trigger(krpc::Event event) : m_event(event), m_stream(event.stream())
+    {
+    }
+
+    Trigger::~Trigger()
+    {
+    }
+
+    /* Blocks until the condition is true. */
+    void Trigger::wait(double timeout)
+    {
+        m_event.acquire();
+        m_event.wait(timeout);
+        m_event.release();
+    }
+
+    bool Trigger::triggered()
+    {
+        return m_stream();
+    }
+
+    /* Callback runs on the stream thread once the condition is true. */
+    int Trigger::on_trigger(std::function<void()> callback)
+    {
+        return m_event.add_callback(callback);
+    }
+
+    krpc::Event& Trigger::event()
+    {
+        return m_event;
+    }
+
+    Quantity::Quantity(Connection& connection, krpc::schema::ProcedureCall call)
+        : m_client(connection.client), m_expression(Expression::to_double(connection.client, Expression::call(connection.client, call)))
+    {
+    }
+
+    Quantity::Quantity(krpc::Client client, Expression expression) : m_client(client), m_expression(expression)
+    {
+    }
+
+    Quantity::~Quantity()
+    {
+    }
+
+    Expression Quantity::expression()
+    {
+        return m_expression;
+    }
+
+    krpc::Client Quantity::client()
+    {
+        return m_client;
+    }
+
+    Quantity Quantity::constant(double value)
+    {
+        return Quantity(m_client, Expression::constant_double(m_client, value));
+    }
+
+    Condition::Condition(krpc::Client client, Expression expression) : m_client(client), m_expression(expression)
+    {
+    }
+
+    Condition::~Condition()
+    {
+    }
+
+    Expression Condition::expression()
+    {
+        return m_expression;
+    }
+
+    krpc::Client Condition::client()
+    {
+        return m_client;
+    }
+
+    Trigger Condition::trigger(Connection& connection)
+    {
+        return Trigger(connection.krpc.add_event(m_expression));
+    }
+
+    typedef Expression (*BinaryExpression)(krpc::Client&, Expression, Expression);
+
+    Quantity combine(BinaryExpression function, Quantity a, Quantity b)
+    {
+        auto client = a.client();
+        return Quantity(client, function(client, a.expression(), b.expression()));
+    }
+
+    Condition compare(BinaryExpression function, Quantity a, Quantity b)
+    {
+        auto client = a.client();
+        return Condition(client, function(client, a.expression(), b.expression()));
+    }
+
+    /* Arithmetic on quantities. */
+    Quantity operator+(Quantity a, Quantity b) { return combine(Expression::add, a, b); }
+    Quantity operator+(Quantity a, double b) { return combine(Expression::add, a, a.constant(b)); }
+    Quantity operator+(double a, Quantity b) { return combine(Expression::add, b.constant(a), b); }
+    Quantity operator-(Quantity a, Quantity b) { return combine(Expression::subtract, a, b); }
+    Quantity operator-(Quantity a, double b) { return combine(Expression::subtract, a, a.constant(b)); }
+    Quantity operator-(double a, Quantity b) { return combine(Expression::subtract, b.constant(a), b); }
+    Quantity operator*(Quantity a, Quantity b) { return combine(Expression::multiply, a, b); }
+    Quantity operator*(Quantity a, double b) { return combine(Expression::multiply, a, a.constant(b)); }
+    Quantity operator*(double a, Quantity b) { return combine(Expression::multiply, b.constant(a), b); }
+    Quantity operator/(Quantity a, Quantity b) { return combine(Expression::divide, a, b); }
+    Quantity operator/(Quantity a, double b) { return combine(Expression::divide, a, a.constant(b)); }
+    Quantity operator/(double a, Quantity b) { return combine(Expression::divide, b.constant(a), b); }
+
+    /* Comparisons of quantities. */
+    Condition operator<(Quantity a, Quantity b) { return compare(Expression::less_than, a, b); }
+    Condition operator<(Quantity a, double b) { return compare(Expression::less_than, a, a.constant(b)); }
+    Condition operator<(double a, Quantity b) { return compare(Expression::less_than, b.constant(a), b); }
+    Condition operator<=(Quantity a, Quantity b) { return compare(Expression::less_than_or_equal, a, b); }
+    Condition operator<=(Quantity a, double b) { return compare(Expression::less_than_or_equal, a, a.constant(b)); }
+    Condition operator<=(double a, Quantity b) { return compare(Expression::less_than_or_equal, b.constant(a), b); }
+    Condition operator>(Quantity a, Quantity b) { return compare(Expression::greater_than, a, b); }
+    Condition operator>(Quantity a, double b) { return compare(Expression::greater_than, a, a.constant(b)); }
+    Condition operator>(double a, Quantity b) { return compare(Expression::greater_than, b.constant(a), b); }
+    Condition operator>=(Quantity a, Quantity b) { return compare(Expression::greater_than_or_equal, a, b); }
+    Condition operator>=(Quantity a, double b) { return compare(Expression::greater_than_or_equal, a, a.constant(b)); }
+    Condition operator>=(double a, Quantity b) { return compare(Expression::greater_than_or_equal, b.constant(a), b); }
+    Condition operator==(Quantity a, Quantity b) { return compare(Expression::equal, a, b); }
+    Condition operator==(Quantity a, double b) { return compare(Expression::equal, a, a.constant(b)); }
+    Condition operator==(double a, Quantity b) { return compare(Expression::equal, b.constant(a), b); }
+    Condition operator!=(Quantity a, Quantity b) { return compare(Expression::not_equal, a, b); }
+    Condition operator!=(Quantity a, double b) { return compare(Expression::not_equal, a, a.constant(b)); }
+    Condition operator!=(double a, Quantity b) { return compare(Expression::not_equal, b.constant(a), b); }
+
+    /* Logic on conditions. */
+    Condition operator&&(Condition a, Condition b)
+    {
+        auto client = a.client();
+        return Condition(client, Expression::and_(client, a.expression(), b.expression()));
+    }
+
+    Condition operator||(Condition a, Condition b)
+    {
+        auto client = a.client();
+        return Condition(client, Expression::or_(client, a.expression(), b.expression()));
+    }
+
+    Condition operator!(Condition a)
+    {
+        auto client = a.client();
+        return Condition(client, Expression::not_(client, a.expression()));
+    }
+}
@@ -0,0 +1,393 @@
+#pragma once
+
+#include <math.h>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include "kepler_orbit.hpp"
+#include "closest_approach.hpp"
+
+namespace KSP
+{
+    /* Up to this many primaries are checked against every object directly instead of through the grid. */
+    const size_t DIRECT_SCREENING_PRIMARIES = 8;
+
+    /**
+     * Closed orbits in structure-of-arrays layout, so one time step propagates a whole fleet in
+     * tight loops over contiguous fields. Only positions are computed.
+     */
+    class OrbitBatch
+    {
+    public:
+        std::vector<double> semi_major_axis;
+        std::vector<double> eccentricity;
+        std::vector<double> minor_axis_ratio;
+        std::vector<double> mean_motion;
+        std::vector<double> mean_anomaly_at_epoch;
+        std::vector<double> epoch;
+        std::vector<double> px, py, pz;
+        std::vector<double> qx, qy, qz;
+    public:
+        OrbitBatch(std::vector<KeplerOrbit>& orbits);
+        ~OrbitBatch();
+    public:
+        size_t size();
+        void propagate(double ut, double* x, double* y, double* z);
+    };
+
+    /* Approach between orbits first and second, by index, closer than the screening threshold. */
+    struct Conjunction
+    {
+        size_t first;
+        size_t second;
+        Approach approach;
+    };
+
+    /**
+     * Screens a fleet around one body for close approaches. Pairs whose periapsis-apoapsis
+     * shells are further apart than the threshold are skipped. The rest are found by sampling
+     * every orbit at a fixed step and hashing positions into a grid. Cells are the threshold
+     * plus the distance two objects can close in half a step, so any pair that comes within the
+     * threshold shares or neighbours a cell at the nearest sample. Runs of flagged steps are then
+     * refined with ClosestApproachFinder. Time steps and refinements are split over all cores.
+     * Only closed orbits are screened.
+     */
+    class ConjunctionScreening
+    {
+    private:
+        struct Candidate
+        {
+            uint32_t first;
+            uint32_t second;
+            uint32_t step;
+        };
+
+        std::vector<KeplerOrbit> m_orbits;
+        OrbitBatch m_batch;
+        std::vector<double> m_periapsis;
+        std::vector<double> m_apoapsis;
+        double m_max_speed = 0.0;
+    public:
+        double threshold = 1000.0;
+        /* Sampling step in seconds; larger steps mean larger cells and more candidates. */
+        double step = 5.0;
+        /* Zero uses every core. */
+        unsigned threads = 0;
+        /* Pairs left after the apsis filter and windows refined in the last screen(). */
+        size_t screened_pairs = 0;
+        size_t windows = 0;
+    public:
+        ConjunctionScreening(std::vector<KeplerOrbit> orbits);
+        ~ConjunctionScreening();
+    public:
+        std::vector<Conjunction> screen(double start, double duration, std::vector<size_t> primaries = {});
+    private:
+        bool shells_overlap(size_t first, size_t second);
+        void sample(double start, uint32_t first_step, uint32_t last_step, std::vector<bool>& primary, size_t primary_count, std::vector<Candidate>& candidates);
+    };
+
+    OrbitBatch::OrbitBatch(std::vector<KeplerOrbit>& orbits)
+    {
+        for (auto& orbit : orbits)
+        {
+            auto p = orbit.periapsis_direction();
+            auto q = orbit.periapsis_velocity_direction();
+
+            semi_major_axis.push_back(orbit.semi_major_axis());
+            eccentricity.push_back(orbit.eccentricity());
+            minor_axis_ratio.push_back(sqrt(1 - orbit.eccentricity() * orbit.eccentricity()));
+            mean_motion.push_back(orbit.mean_motion());
+            mean_anomaly_at_epoch.push_back(orbit.mean_anomaly_at_epoch());
+            epoch.push_back(orbit.epoch());
+            px.push_back(p.m_x);
+            py.push_back(p.m_y);
+            pz.push_back(p.m_z);
+            qx.push_back(q.m_x);
+            qy.push_back(q.m_y);
+            qz.push_back(q.m_z);
+        }
+    }
+
+    OrbitBatch::~OrbitBatch()
+    {
+    }
+
+    size_t OrbitBatch::size()
+    {
+        return semi_major_axis.size();
+    }
+
+    /* Positions at ut into x, y and z, which hold size() values each. */
+    void OrbitBatch::propagate(double ut, double* x, double* y, double* z)
+    {
+        auto count = size();
+
+        for (size_t i = 0; i < count; i++)
+        {
+            auto e = eccentricity[i];
+            auto mean_anomaly = remainder(mean_anomaly_at_epoch[i] + mean_motion[i] * (ut - epoch[i]), 2 * M_PI);
+            auto anomaly = e < 0.8 ? mean_anomaly + e * sin(mean_anomaly) : (mean_anomaly < 0 ? -M_PI : M_PI);
+
+            for (int j = 0; j < 20; j++)
+            {
+                auto correction = (anomaly - e * sin(anomaly) - mean_anomaly) / (1 - e * cos(anomaly));
+
+                anomaly -= correction;
+
+                if (abs(correction) < 1e-10)
+                {
+                    break;
+                }
+            }
+
+            auto perifocal_x = semi_major_axis[i] * (cos(anomaly) - e);
+            auto perifocal_y = semi_major_axis[i] * minor_axis_ratio[i] * sin(anomaly);
+
+            x[i] = px[i] * perifocal_x + qx[i] * perifocal_y;
+            y[i] = py[i] * perifocal_x + qy[i] * perifocal_y;
+            z[i] = pz[i] * perifocal_x + qz[i] * perifocal_y;
+        }
+    }
+
+    /* Orbits must be closed and around the same body. */
+    ConjunctionScreening::ConjunctionScreening(std::vector<KeplerOrbit> orbits) : m_orbits(orbits), m_batch(m_orbits)
+    {
+        for (auto& orbit : m_orbits)
+        {
+            m_periapsis.push_back(orbit.periapsis());
+            m_apoapsis.push_back(orbit.apoapsis());
+
+            /* Vis-viva at periapsis, the fastest point of the orbit. */
+            auto speed = sqrt(orbit.gravitational_parameter() * (2 / orbit.periapsis() - 1 / orbit.semi_major_axis()));
+            m_max_speed = std::max(m_max_speed, speed);
+        }
+    }
+
+    ConjunctionScreening::~ConjunctionScreening()
+    {
+    }
+
+    /**
+     * Conjunctions within [start, start + duration], sorted by time. With primaries, e.g. the
+     * active vessel and a station, only pairs that include one of them are screened; without,
+     * every pair is.
+     */
+    std::vector<Conjunction> ConjunctionScreening::screen(double start, double duration, std::vector<size_t> primaries)
+    {
+        auto count = m_orbits.size();
+        std::vector<bool> primary(count, primaries.empty());
+
+        for (auto index : primaries)
+        {
+            primary[index] = true;
+        }
+
+        auto primary_count = primaries.empty() ? count : primaries.size();
+
+        /* Pairs left after the apsis filter, for the statistics. */
+        screened_pairs = 0;
+
+        for (size_t i = 0; i < count; i++)
+        {
+            for (size_t j = 0; j < count && primary[i]; j++)
+            {
+                if (j != i && !(primary[j] && j < i) && shells_overlap(i, j))
+                {
+                    screened_pairs++;
+                }
+            }
+        }
+
+        auto steps = static_cast<uint32_t>(ceil(duration / step)) + 1;
+        auto thread_count = threads > 0 ? threads : std::max(1u, std::thread::hardware_concurrency());
+        std::vector<std::vector<Candidate>> candidates(thread_count);
+        std::vector<std::thread> workers;
+
+        for (unsigned t = 0; t < thread_count; t++)
+        {
+            auto first_step = steps * t / thread_count;
+            auto last_step = steps * (t + 1) / thread_count;
+
+            workers.emplace_back([this, start, first_step, last_step, &primary, primary_count, &candidates, t]() {
+                sample(start, first_step, last_step, primary, primary_count, candidates[t]);
+            });
+        }
+
+        for (auto& worker : workers)
+        {
+            worker.join();
+        }
+
+        /* Merge runs of consecutive steps of the same pair into one window. */
+        std::vector<Candidate> merged;
+
+        for (auto& part : candidates)
+        {
+            merged.insert(merged.end(), part.begin(), part.end());
+        }
+
+        std::sort(merged.begin(), merged.end(), [](const Candidate& a, const Candidate& b) {
+            return a.first != b.first ? a.first < b.first : (a.second != b.second ? a.second < b.second : a.step < b.step);
+        });
+
+        struct Window
+        {
+            size_t first;
+            size_t second;
+            double start;
+            double end;
+        };
+
+        std::vector<Window> window_list;
+
+        for (auto& candidate : merged)
+        {
+            auto begin = start + (candidate.step - 0.5) * step;
+            auto end = start + (candidate.step + 0.5) * step;
+
+            if (!window_list.empty() && window_list.back().first == candidate.first && window_list.back().second == candidate.second && window_list.back().end >= begin - 1e-9)
+            {
+                window_list.back().end = end;
+            }
+            else
+            {
+                window_list.push_back({candidate.first, candidate.second, begin, end});
+            }
+        }
+
+        windows = window_list.size();
+
+        /* Refine the windows in parallel. */
+        std::vector<std::vector<Conjunction>> found(thread_count);
+        workers.clear();
+
+        for (unsigned t = 0; t < thread_count; t++)
+        {
+            workers.emplace_back([this, &window_list, &found, t, thread_count, start, duration]() {
+                for (size_t w = t; w < window_list.size(); w += thread_count)
+                {
+                    auto& window = window_list[w];
+                    ClosestApproachFinder finder(m_orbits[window.first], m_orbits[window.second]);
+                    auto approach = finder.minimum(std::max(window.start, start), std::min(window.end, start + duration));
+
+                    if (approach.distance < threshold)
+                    {
+                        found[t].push_back({window.first, window.second, approach});
+                    }
+                }
+            });
+        }
+
+        for (auto& worker : workers)
+        {
+            worker.join();
+        }
+
+        std::vector<Conjunction> conjunctions;
+
+        for (auto& part : found)
+        {
+            conjunctions.insert(conjunctions.end(), part.begin(), part.end());
+        }
+
+        std::sort(conjunctions.begin(), conjunctions.end(), [](const Conjunction& a, const Conjunction& b) {
+            return a.approach.time < b.approach.time;
+        });
+
+        return conjunctions;
+    }
+
+    /* False if the radial gap between the two orbits is already larger than the threshold. */
+    bool ConjunctionScreening::shells_overlap(size_t first, size_t second)
+    {
+        return m_periapsis[first] - threshold <= m_apoapsis[second] && m_periapsis[second] - threshold <= m_apoapsis[first];
+    }
+
+    void ConjunctionScreening::sample(double start, uint32_t first_step, uint32_t last_step, std::vector<bool>& primary, size_t primary_count, std::vector<Candidate>& candidates)
+    {
+        auto count = m_batch.size();
+        auto cell = threshold + m_max_speed * step;
+        std::vector<double> x(count), y(count), z(count);
+        std::vector<std::pair<uint64_t, uint32_t>> grid(count);
+
+        /* 21 bits per axis covers two million cells either side of the body. */
+        auto key = [](int64_t i, int64_t j, int64_t k) {
+            return (static_cast<uint64_t>(i + (1 << 20)) << 42) | (static_cast<uint64_t>(j + (1 << 20)) << 21) | static_cast<uint64_t>(k + (1 << 20));
+        };
+
+        /* Each pair once: from its lower index if both ends are primaries. */
+        auto check = [&](uint32_t i, uint32_t j, uint32_t s) {
+            if (j == i || (primary[j] && j < i) || !shells_overlap(i, j))
+            {
+                return;
+            }
+
+            auto dx = x[j] - x[i];
+            auto dy = y[j] - y[i];
+            auto dz = z[j] - z[i];
+
+            if (dx * dx + dy * dy + dz * dz < cell * cell)
+            {
+                candidates.push_back({std::min(i, j), std::max(i, j), s});
+            }
+        };
+
+        /* A few primaries against everything is cheaper without the grid. */
+        auto use_grid = primary_count > DIRECT_SCREENING_PRIMARIES;
+
+        for (auto s = first_step; s < last_step; s++)
+        {
+            m_batch.propagate(start + s * step, x.data(), y.data(), z.data());
+
+            if (!use_grid)
+            {
+                for (uint32_t i = 0; i < count; i++)
+                {
+                    for (uint32_t j = 0; j < count && primary[i]; j++)
+                    {
+                        check(i, j, s);
+                    }
+                }
+
+                continue;
+            }
+
+            for (uint32_t i = 0; i < count; i++)
+            {
+                grid[i] = std::make_pair(key(floor(x[i] / cell), floor(y[i] / cell), floor(z[i] / cell)), i);
+            }
+
+            std::sort(grid.begin(), grid.end());
+
+            for (uint32_t i = 0; i < count; i++)
+            {
+                if (!primary[i])
+                {
+                    continue;
+                }
+
+                auto ci = static_cast<int64_t>(floor(x[i] / cell));
+                auto cj = static_cast<int64_t>(floor(y[i] / cell));
+                auto ck = static_cast<int64_t>(floor(z[i] / cell));
+
+                for (int64_t di = -1; di <= 1; di++)
+                {
+                    for (int64_t dj = -1; dj <= 1; dj++)
+                    {
+                        for (int64_t dk = -1; dk <= 1; dk++)
+                        {
+                            auto neighbour = key(ci + di, cj + dj, ck + dk);
+                            auto found = std::lower_bound(grid.begin(), grid.end(), std::make_pair(neighbour, uint32_t(0)));
+
+                            for (; found != grid.end() && found->first == neighbour; found++)
+                            {
+                                check(i, found->second, s);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
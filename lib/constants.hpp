@@ -3,4 +3,6 @@
 namespace KSP
 {
     const double STANDARD_GRAVITY = 9.80665;
+    /* Fixed physics time step of the game at 1x warp, in seconds. */
+    const double PHYSICS_FRAME = 0.02;
 }
\ No newline at end of file
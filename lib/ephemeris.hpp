@@ -0,0 +1,444 @@
+#pragma once
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <cmath>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include "vector3.hpp"
+#include "kepler_orbit.hpp"
+#include "patched_conics.hpp"
+#include "enums/bodies.hpp"
+
+namespace KSP
+{
+    const char EPHEMERIS_MAGIC[4] = {'K', 'E', 'P', '1'};
+    /* Per body, about 20 MiB of coefficients at degree 12. */
+    const uint32_t EPHEMERIS_MAX_SEGMENTS = 65536;
+
+    /* File layout: header, the bodies, then every segment's coefficients as one packed array. */
+    struct EphemerisHeader
+    {
+        char magic[4];
+        uint32_t body_count;
+        uint32_t degree;
+        uint32_t reserved;
+        double start;
+        double end;
+    };
+
+    /**
+     * One body's record. Its segments are of equal length and cover the whole span; each holds
+     * degree + 1 coefficients for x, then y, then z, of the position relative to the parent.
+     * The root has no segments.
+     */
+    struct EphemerisBody
+    {
+        char name[32];
+        int32_t parent;
+        uint32_t segment_count;
+        uint64_t first_coefficient;
+        double segment_length;
+        double gravitational_parameter;
+        double radius;
+        double sphere_of_influence;
+    };
+
+    /**
+     * Body positions and velocities at any time in a span, from Chebyshev polynomials fitted to
+     * each body's orbit and stored in a memory-mapped file. A query finds its segment by division
+     * and sums one polynomial per axis, so it costs the same anywhere in the span and needs no
+     * Kepler solve or RPC. Positions are relative to the parent, in the axes of KeplerOrbit.
+     * Generate the file once from stock elements or from the server's, then map it in each
+     * program that needs it.
+     */
+    class Ephemeris
+    {
+    private:
+        void* m_memory = nullptr;
+        size_t m_size = 0;
+        const EphemerisHeader* m_header = nullptr;
+        const EphemerisBody* m_bodies = nullptr;
+        const double* m_coefficients = nullptr;
+    public:
+        Ephemeris(std::string path);
+        Ephemeris(const Ephemeris&) = delete;
+        ~Ephemeris();
+    public:
+        static void generate(std::vector<ConicBody> bodies, double start, double span, std::string path, uint32_t degree = 12, double tolerance = 1.0);
+        Vector3 position(size_t body, double ut);
+        void state(size_t body, double ut, Vector3& position, Vector3& velocity);
+        Vector3 position_from_root(size_t body, double ut);
+        const EphemerisBody& body(size_t index);
+        size_t body_index(std::string name);
+        size_t body_count();
+        double start();
+        double end();
+    private:
+        static void fit(KeplerOrbit& orbit, double start, double length, uint32_t degree, double* coefficients);
+        static void evaluate(const double* coefficients, uint32_t degree, double x, double scale, Vector3& position, Vector3& velocity);
+    };
+
+    /**
+     * Stock system of bodies.hpp at UT 0: name, parent, gravitational parameter, radius, sphere of influence,
+     * then semi-major axis, eccentricity, inclination, longitude of ascending node, argument of
+     * periapsis (degrees) and mean anomaly at epoch (radians), around the parent.
+     */
+    std::vector<ConicBody> stock_bodies()
+    {
+        struct Elements
+        {
+            std::string name;
+            int parent;
+            double gravitational_parameter, radius, sphere_of_influence;
+            double semi_major_axis, eccentricity, inclination, longitude_of_ascending_node, argument_of_periapsis, mean_anomaly_at_epoch;
+        };
+
+        const Elements elements[] = {
+            {bodies::KERBOL, -1, 1.1723328e18, 261600000, INFINITY, 0, 0, 0, 0, 0, 0},
+            {bodies::MOHO, 0, 1.6860938e11, 250000, 9646663.0, 5263138304, 0.2, 7, 70, 15, 3.14},
+            {bodies::EVE, 0, 8.1717302e12, 700000, 85109365, 9832684544, 0.01, 2.1, 15, 0, 3.14},
+            {bodies::GILLY, 2, 8289449.8, 13000, 126123.27, 31500000, 0.55, 12, 80, 10, 0.9},
+            {bodies::KERBIN, 0, 3.5316e12, 600000, 84159286, 13599840256, 0, 0, 0, 0, 3.14},
+            {bodies::MUN, 4, 6.5138398e10, 200000, 2429559.1, 12000000, 0, 0, 0, 0, 1.7},
+            {bodies::MINMUS, 4, 1.7658e9, 60000, 2247428.4, 47000000, 0, 6, 78, 38, 0.9},
+            {bodies::DUNA, 0, 3.0136321e11, 320000, 47921949, 20726155264, 0.051, 0.06, 135.5, 0, 3.14},
+            {bodies::IKE, 7, 1.8568369e10, 130000, 1049598.9, 3200000, 0.03, 0.2, 0, 0, 1.7},
+            {bodies::DRES, 0, 2.1484489e10, 138000, 32832840, 40839348203, 0.145, 5, 280, 90, 3.14},
+            {bodies::JOOL, 0, 2.82528e14, 6000000, 2455985200, 68773560320, 0.05, 1.304, 52, 0, 0.1},
+            {bodies::LAYTHE, 10, 1.962e12, 500000, 3723645.8, 27184000, 0, 0, 0, 0, 3.14},
+            {bodies::VALL, 10, 2.074815e11, 300000, 2406401.4, 43152000, 0, 0, 0, 0, 0.9},
+            {bodies::TYLO, 10, 2.82528e12, 600000, 10856518, 68500000, 0, 0.025, 0, 0, 3.14},
+            {bodies::BOP, 10, 2.4868349e9, 65000, 1221060.9, 128500000, 0.235, 15, 10, 25, 0.9},
+            {bodies::POL, 10, 7.2170208e8, 44000, 1042138.9, 179890000, 0.171, 4.25, 2, 15, 0.9},
+            {bodies::EELOO, 0, 7.4410815e10, 210000, 119082940, 90118820000, 0.26, 6.15, 50, 260, 3.14},
+        };
+
+        std::vector<ConicBody> bodies;
+
+        for (auto& body : elements)
+        {
+            auto orbit = body.parent < 0 ? KeplerOrbit() : KeplerOrbit(
+                elements[body.parent].gravitational_parameter,
+                body.semi_major_axis,
+                body.eccentricity,
+                body.inclination * M_PI / 180,
+                body.longitude_of_ascending_node * M_PI / 180,
+                body.argument_of_periapsis * M_PI / 180,
+                body.mean_anomaly_at_epoch,
+                0.0
+            );
+
+            bodies.push_back({body.name, body.gravitational_parameter, body.radius, body.sphere_of_influence, body.parent, orbit});
+        }
+
+        return bodies;
+    }
+
+    /* Maps the file; throws if it is missing or not an ephemeris. */
+    Ephemeris::Ephemeris(std::string path)
+    {
+        auto descriptor = open(path.c_str(), O_RDONLY);
+
+        if (descriptor < 0)
+        {
+            throw std::runtime_error("Could not open '" + path + "'");
+        }
+
+        struct stat status;
+
+        if (fstat(descriptor, &status) != 0 || static_cast<size_t>(status.st_size) < sizeof(EphemerisHeader))
+        {
+            close(descriptor);
+            throw std::runtime_error("'" + path + "' is not an ephemeris");
+        }
+
+        m_size = status.st_size;
+        m_memory = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+        close(descriptor);
+
+        if (m_memory == MAP_FAILED)
+        {
+            m_memory = nullptr;
+            throw std::runtime_error("Could not map '" + path + "'");
+        }
+
+        m_header = static_cast<const EphemerisHeader*>(m_memory);
+        m_bodies = reinterpret_cast<const EphemerisBody*>(m_header + 1);
+        m_coefficients = reinterpret_cast<const double*>(m_bodies + m_header->body_count);
+
+        /* The records must fit before they are read, and evaluate needs at least a linear term. */
+        auto valid = std::memcmp(m_header->magic, EPHEMERIS_MAGIC, sizeof(m_header->magic)) == 0 && m_header->degree >= 1
+                  && sizeof(EphemerisHeader) + m_header->body_count * sizeof(EphemerisBody) <= m_size;
+        auto coefficient_count = 0ull;
+
+        /* Bodies are packed in order, so each starts where the previous one ended. */
+        for (uint32_t i = 0; valid && i < m_header->body_count; i++)
+        {
+            valid = m_bodies[i].first_coefficient == coefficient_count;
+            coefficient_count += 3ull * (m_header->degree + 1) * m_bodies[i].segment_count;
+        }
+
+        if (!valid || sizeof(EphemerisHeader) + m_header->body_count * sizeof(EphemerisBody) + coefficient_count * sizeof(double) != m_size)
+        {
+            munmap(m_memory, m_size);
+            m_memory = nullptr;
+            throw std::runtime_error("'" + path + "' is not an ephemeris");
+        }
+    }
+
+    Ephemeris::~Ephemeris()
+    {
+        if (m_memory != nullptr)
+        {
+            munmap(m_memory, m_size);
+        }
+    }
+
+    /**
+     * Fits every body over [start, start + span] and writes the file. Each body starts with a
+     * quarter of its period per segment, halved until the fit is within tolerance (m) of the
+     * orbit at points between the fitting nodes. Written to a temporary file and renamed.
+     * Throws if the degree is below 1 or a body needs more than EPHEMERIS_MAX_SEGMENTS segments.
+     */
+    void Ephemeris::generate(std::vector<ConicBody> bodies, double start, double span, std::string path, uint32_t degree, double tolerance)
+    {
+        if (degree < 1 || span <= 0.0)
+        {
+            throw std::invalid_argument("Ephemeris: need a degree of at least 1 and a positive span");
+        }
+
+        std::vector<EphemerisBody> records;
+        std::vector<double> coefficients;
+        auto per_segment = 3 * (degree + 1);
+
+        for (auto& body : bodies)
+        {
+            EphemerisBody record = {};
+
+            std::strncpy(record.name, body.name.c_str(), sizeof(record.name) - 1);
+            record.parent = body.parent;
+            record.first_coefficient = coefficients.size();
+            record.gravitational_parameter = body.gravitational_parameter;
+            record.radius = body.radius;
+            record.sphere_of_influence = body.sphere_of_influence;
+
+            if (body.parent >= 0)
+            {
+                auto segment_count = std::max(1u, static_cast<uint32_t>(ceil(span / (body.orbit.period() / 4))));
+                std::vector<double> fitted;
+
+                for (auto accurate = false; !accurate; segment_count *= 2)
+                {
+                    if (segment_count > EPHEMERIS_MAX_SEGMENTS)
+                    {
+                        throw std::runtime_error("Could not fit '" + body.name + "' to the tolerance in " + std::to_string(EPHEMERIS_MAX_SEGMENTS) + " segments");
+                    }
+
+                    auto length = span / segment_count;
+
+                    fitted.assign(static_cast<size_t>(segment_count) * per_segment, 0.0);
+                    accurate = true;
+
+                    for (uint32_t i = 0; i < segment_count && accurate; i++)
+                    {
+                        auto segment = fitted.data() + static_cast<size_t>(i) * per_segment;
+
+                        fit(body.orbit, start + i * length, length, degree, segment);
+
+                        for (uint32_t k = 0; k <= 2 * degree && accurate; k++)
+                        {
+                            auto x = cos(M_PI * (k + 0.5) / (2 * degree + 1));
+                            Vector3 position, velocity;
+
+                            evaluate(segment, degree, x, 2 / length, position, velocity);
+                            accurate = (position - body.orbit.position_at(start + (i + (x + 1) / 2) * length)).length() <= tolerance;
+                        }
+                    }
+
+                    record.segment_count = segment_count;
+                    record.segment_length = length;
+                }
+
+                coefficients.insert(coefficients.end(), fitted.begin(), fitted.end());
+            }
+
+            records.push_back(record);
+        }
+
+        EphemerisHeader header = {};
+        std::memcpy(header.magic, EPHEMERIS_MAGIC, sizeof(header.magic));
+        header.body_count = records.size();
+        header.degree = degree;
+        header.start = start;
+        header.end = start + span;
+
+        auto temporary = path + ".tmp";
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(EphemerisBody));
+        file.write(reinterpret_cast<const char*>(coefficients.data()), coefficients.size() * sizeof(double));
+        file.close();
+
+        if (!file || std::rename(temporary.c_str(), path.c_str()) != 0)
+        {
+            throw std::runtime_error("Could not write '" + path + "'");
+        }
+    }
+
+    Vector3 Ephemeris::position(size_t body, double ut)
+    {
+        Vector3 position, velocity;
+
+        state(body, ut, position, velocity);
+
+        return position;
+    }
+
+    /* Relative to the parent. Throws outside the span, where the polynomials do not hold. */
+    void Ephemeris::state(size_t body, double ut, Vector3& position, Vector3& velocity)
+    {
+        auto& record = m_bodies[body];
+
+        if (record.segment_count == 0)
+        {
+            position = Vector3(0, 0, 0);
+            velocity = Vector3(0, 0, 0);
+            return;
+        }
+
+        if (ut < m_header->start || ut > m_header->end)
+        {
+            throw std::out_of_range("UT " + std::to_string(ut) + " is outside the ephemeris");
+        }
+
+        auto offset = (ut - m_header->start) / record.segment_length;
+        auto segment = std::min(static_cast<uint32_t>(offset), record.segment_count - 1);
+        auto x = 2 * (offset - segment) - 1;
+        auto coefficients = m_coefficients + record.first_coefficient + static_cast<size_t>(segment) * 3 * (m_header->degree + 1);
+
+        evaluate(coefficients, m_header->degree, x, 2 / record.segment_length, position, velocity);
+    }
+
+    /* Relative to the root, e.g. the Sun, by adding up the parents' positions. */
+    Vector3 Ephemeris::position_from_root(size_t body, double ut)
+    {
+        auto position = Vector3(0, 0, 0);
+
+        for (auto index = static_cast<int32_t>(body); index >= 0; index = m_bodies[index].parent)
+        {
+            position = position + this->position(index, ut);
+        }
+
+        return position;
+    }
+
+    const EphemerisBody& Ephemeris::body(size_t index)
+    {
+        return m_bodies[index];
+    }
+
+    /* Index of the body with the name; the number of bodies if there is none. */
+    size_t Ephemeris::body_index(std::string name)
+    {
+        for (size_t i = 0; i < m_header->body_count; i++)
+        {
+            if (name == std::string(m_bodies[i].name, strnlen(m_bodies[i].name, sizeof(m_bodies[i].name))))
+            {
+                return i;
+            }
+        }
+
+        return m_header->body_count;
+    }
+
+    size_t Ephemeris::body_count()
+    {
+        return m_header->body_count;
+    }
+
+    double Ephemeris::start()
+    {
+        return m_header->start;
+    }
+
+    double Ephemeris::end()
+    {
+        return m_header->end;
+    }
+
+    /* Interpolates the orbit at the Chebyshev nodes of [start, start + length]. */
+    void Ephemeris::fit(KeplerOrbit& orbit, double start, double length, uint32_t degree, double* coefficients)
+    {
+        auto count = degree + 1;
+        std::vector<Vector3> samples(count);
+
+        for (uint32_t k = 0; k < count; k++)
+        {
+            samples[k] = orbit.position_at(start + (cos(M_PI * (k + 0.5) / count) + 1) / 2 * length);
+        }
+
+        for (uint32_t j = 0; j < count; j++)
+        {
+            auto sum = Vector3(0, 0, 0);
+
+            for (uint32_t k = 0; k < count; k++)
+            {
+                sum = sum + samples[k] * cos(M_PI * j * (k + 0.5) / count);
+            }
+
+            sum = sum * ((j == 0 ? 1.0 : 2.0) / count);
+            coefficients[j] = sum.m_x;
+            coefficients[count + j] = sum.m_y;
+            coefficients[2 * count + j] = sum.m_z;
+        }
+    }
+
+    /**
+     * Sums the series at x in [-1, 1] by the recurrences of the Chebyshev polynomials T and U,
+     * the derivative of T_j being j * U_(j-1). scale converts d/dx to d/dt.
+     */
+    void Ephemeris::evaluate(const double* coefficients, uint32_t degree, double x, double scale, Vector3& position, Vector3& velocity)
+    {
+        auto count = degree + 1;
+        auto x_coefficients = coefficients;
+        auto y_coefficients = coefficients + count;
+        auto z_coefficients = coefficients + 2 * count;
+
+        double t_previous = 1, t_current = x, u_previous = 0, u_current = 1;
+        double px = x_coefficients[0] + x_coefficients[1] * x;
+        double py = y_coefficients[0] + y_coefficients[1] * x;
+        double pz = z_coefficients[0] + z_coefficients[1] * x;
+        double vx = x_coefficients[1], vy = y_coefficients[1], vz = z_coefficients[1];
+
+        for (uint32_t j = 2; j < count; j++)
+        {
+            auto t_next = 2 * x * t_current - t_previous;
+            auto u_next = 2 * x * u_current - u_previous;
+
+            px += x_coefficients[j] * t_next;
+            py += y_coefficients[j] * t_next;
+            pz += z_coefficients[j] * t_next;
+            vx += x_coefficients[j] * j * u_next;
+            vy += y_coefficients[j] * j * u_next;
+            vz += z_coefficients[j] * j * u_next;
+
+            t_previous = t_current;
+            t_current = t_next;
+            u_previous = u_current;
+            u_current = u_next;
+        }
+
+        position = Vector3(px, py, pz);
+        velocity = Vector3(vx * scale, vy * scale, vz * scale);
+    }
+}
@@ -0,0 +1,532 @@
+#pragma once
+
+#include <mutex>
+#include <atomic>
+#include <future>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <iostream>
+#include <exception>
+#include <stdexcept>
+#include <functional>
+#include <type_traits>
+#include <unordered_map>
+#include <condition_variable>
+
+namespace KSP
+{
+    /**
+     * Bounded lock-free queue for one producer thread and one consumer thread. push() and pop()
+     * are wait-free; wait() lets an idle consumer sleep until the next push() or wake().
+     * Capacity is rounded up to a power of two.
+     */
+    template <typename T>
+    class SpscQueue
+    {
+    private:
+        std::vector<T> m_buffer;
+        size_t m_mask;
+        alignas(64) std::atomic<size_t> m_head;
+        alignas(64) std::atomic<size_t> m_tail;
+        alignas(64) std::atomic<unsigned> m_sequence;
+    public:
+        SpscQueue(size_t capacity);
+        ~SpscQueue();
+    public:
+        bool push(T&& value);
+        bool pop(T& value);
+        bool empty();
+        void wait(const std::atomic<bool>& running);
+        void wake();
+    };
+
+    /**
+     * Runs RPCs for a control loop on a dedicated thread. Actuator writes are posted and the loop
+     * carries on computing; getters return a future. Calls run in the order they were issued.
+     * A single thread, e.g. the control loop, may issue calls. The kRPC client still makes one
+     * round trip per call, so throughput is unchanged and only the wait moves off the control
+     * loop; PipelinedChannel keeps several calls on the wire instead.
+     */
+    class IoThread
+    {
+    private:
+        SpscQueue<std::function<void()>> m_queue;
+        std::atomic<bool> m_running;
+        std::thread m_thread;
+    public:
+        IoThread(size_t capacity = 1024);
+        ~IoThread();
+    public:
+        void post(std::function<void()> call);
+        template <typename F>
+        std::future<std::invoke_result_t<F>> submit(F call);
+        void flush();
+        void stop();
+    private:
+        void enqueue(std::function<void()>&& call);
+        void run();
+    };
+
+    /**
+     * Pipelined calls over an in-order or tagged request/response transport. The control loop
+     * queues calls without waiting; a writer thread sends everything queued as one tagged batch
+     * while fewer than max_in_flight batches are unanswered, and a reader thread matches each
+     * response to its batch by tag and completes the futures. Throughput is bound by the
+     * transport rather than by the round trip. A single thread may issue calls.
+     * send(tag, calls) writes one batch; receive() blocks for the next response and returns its
+     * tag and one result per call. A transport error fails every unanswered call and every
+     * later one.
+     */
+    template <typename Call, typename Result>
+    class PipelinedChannel
+    {
+    private:
+        typedef std::function<void(Result*, std::exception_ptr)> Completion;
+
+        std::function<void(uint64_t, const std::vector<Call>&)> m_send;
+        std::function<std::pair<uint64_t, std::vector<Result>>()> m_receive;
+        size_t m_max_in_flight;
+        size_t m_max_batch;
+        SpscQueue<std::pair<Call, Completion>> m_queue;
+        std::unordered_map<uint64_t, std::vector<Completion>> m_in_flight;
+        uint64_t m_next_tag;
+        std::exception_ptr m_error;
+        bool m_writer_done;
+        std::mutex m_mutex;
+        std::condition_variable m_condition;
+        std::atomic<bool> m_running;
+        std::thread m_writer;
+        std::thread m_reader;
+    public:
+        PipelinedChannel(
+            std::function<void(uint64_t, const std::vector<Call>&)> send,
+            std::function<std::pair<uint64_t, std::vector<Result>>()> receive,
+            size_t max_in_flight = 8,
+            size_t max_batch = 64,
+            size_t capacity = 1024
+        );
+        ~PipelinedChannel();
+    public:
+        std::future<Result> call(Call call);
+        template <typename F>
+        std::future<std::invoke_result_t<F, Result&>> call(Call call, F decode);
+        void stop();
+    private:
+        void enqueue(Call&& call, Completion&& completion);
+        void fail(std::vector<Completion>& completions, std::exception_ptr error);
+        void write();
+        void read();
+    };
+
+    template <typename T>
+    SpscQueue<T>::SpscQueue(size_t capacity) : m_head(0), m_tail(0), m_sequence(0)
+    {
+        size_t size = 1;
+
+        while (size < capacity)
+        {
+            size <<= 1;
+        }
+
+        m_buffer.resize(size);
+        m_mask = size - 1;
+    }
+
+    template <typename T>
+    SpscQueue<T>::~SpscQueue()
+    {
+    }
+
+    /* Producer only. Returns false if the queue is full. */
+    template <typename T>
+    bool SpscQueue<T>::push(T&& value)
+    {
+        auto tail = m_tail.load(std::memory_order_relaxed);
+
+        if (tail - m_head.load(std::memory_order_acquire) > m_mask)
+        {
+            return false;
+        }
+
+        m_buffer[tail & m_mask] = std::move(value);
+        m_tail.store(tail + 1, std::memory_order_release);
+        wake();
+
+        return true;
+    }
+
+    /* Consumer only. Returns false if the queue is empty. */
+    template <typename T>
+    bool SpscQueue<T>::pop(T& value)
+    {
+        auto head = m_head.load(std::memory_order_relaxed);
+
+        if (head == m_tail.load(std::memory_order_acquire))
+        {
+            return false;
+        }
+
+        value = std::move(m_buffer[head & m_mask]);
+        m_head.store(head + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    template <typename T>
+    bool SpscQueue<T>::empty()
+    {
+        return m_head.load(std::memory_order_acquire) == m_tail.load(std::memory_order_acquire);
+    }
+
+    /* Consumer only. Sleeps until something is pushed, or running is cleared and wake() called. */
+    template <typename T>
+    void SpscQueue<T>::wait(const std::atomic<bool>& running)
+    {
+        auto sequence = m_sequence.load(std::memory_order_acquire);
+
+        if (empty() && running.load(std::memory_order_acquire))
+        {
+            m_sequence.wait(sequence, std::memory_order_acquire);
+        }
+    }
+
+    template <typename T>
+    void SpscQueue<T>::wake()
+    {
+        m_sequence.fetch_add(1, std::memory_order_release);
+        m_sequence.notify_one();
+    }
+
+    IoThread::IoThread(size_t capacity) : m_queue(capacity), m_running(true)
+    {
+        m_thread = std::thread(&IoThread::run, this);
+    }
+
+    /* Sends what is still queued before stopping. */
+    IoThread::~IoThread()
+    {
+        stop();
+    }
+
+    /* Fire and forget, e.g. post([&]() { vessel.control().set_throttle(throttle); }). */
+    void IoThread::post(std::function<void()> call)
+    {
+        enqueue([call]() {
+            try
+            {
+                call();
+            }
+            catch (const std::exception& exception)
+            {
+                std::cout << "IO thread: " << exception.what() << std::endl;
+            }
+        });
+    }
+
+    /* The future holds the call's result, or its exception. */
+    template <typename F>
+    std::future<std::invoke_result_t<F>> IoThread::submit(F call)
+    {
+        auto task = std::make_shared<std::packaged_task<std::invoke_result_t<F>()>>(call);
+        auto future = task->get_future();
+
+        enqueue([task]() { (*task)(); });
+
+        return future;
+    }
+
+    /* Blocks until every call issued so far has been sent. */
+    void IoThread::flush()
+    {
+        submit([]() {}).wait();
+    }
+
+    void IoThread::stop()
+    {
+        if (!m_running.exchange(false))
+        {
+            return;
+        }
+
+        m_queue.wake();
+        m_thread.join();
+    }
+
+    void IoThread::enqueue(std::function<void()>&& call)
+    {
+        /* Queue full: the I/O thread is behind, so wait for it rather than drop a command. */
+        while (!m_queue.push(std::move(call)))
+        {
+            std::this_thread::yield();
+        }
+    }
+
+    void IoThread::run()
+    {
+        std::function<void()> call;
+
+        while (m_running.load(std::memory_order_acquire) || !m_queue.empty())
+        {
+            while (m_queue.pop(call))
+            {
+                call();
+            }
+
+            m_queue.wait(m_running);
+        }
+    }
+
+    template <typename Call, typename Result>
+    PipelinedChannel<Call, Result>::PipelinedChannel(
+        std::function<void(uint64_t, const std::vector<Call>&)> send,
+        std::function<std::pair<uint64_t, std::vector<Result>>()> receive,
+        size_t max_in_flight,
+        size_t max_batch,
+        size_t capacity
+    ) : m_send(send), m_receive(receive), m_max_in_flight(std::max<size_t>(1, max_in_flight)), m_max_batch(std::max<size_t>(1, max_batch)),
+        m_queue(capacity), m_next_tag(0), m_writer_done(false), m_running(true)
+    {
+        m_writer = std::thread(&PipelinedChannel::write, this);
+        m_reader = std::thread(&PipelinedChannel::read, this);
+    }
+
+    /* Waits for the answers to every call already issued before stopping. */
+    template <typename Call, typename Result>
+    PipelinedChannel<Call, Result>::~PipelinedChannel()
+    {
+        stop();
+    }
+
+    template <typename Call, typename Result>
+    std::future<Result> PipelinedChannel<Call, Result>::call(Call call)
+    {
+        return this->call(std::move(call), [](Result& result) { return std::move(result); });
+    }
+
+    /* decode(result) runs on the reader thread; the future holds its value, or the call's error. */
+    template <typename Call, typename Result>
+    template <typename F>
+    std::future<std::invoke_result_t<F, Result&>> PipelinedChannel<Call, Result>::call(Call call, F decode)
+    {
+        typedef std::invoke_result_t<F, Result&> Value;
+
+        auto promise = std::make_shared<std::promise<Value>>();
+        auto future = promise->get_future();
+
+        enqueue(std::move(call), [promise, decode](Result* result, std::exception_ptr error) {
+            try
+            {
+                if (error)
+                {
+                    std::rethrow_exception(error);
+                }
+
+                if constexpr (std::is_void_v<Value>)
+                {
+                    decode(*result);
+                    promise->set_value();
+                }
+                else
+                {
+                    promise->set_value(decode(*result));
+                }
+            }
+            catch (...)
+            {
+                promise->set_exception(std::current_exception());
+            }
+        });
+
+        return future;
+    }
+
+    template <typename Call, typename Result>
+    void PipelinedChannel<Call, Result>::stop()
+    {
+        if (!m_running.exchange(false))
+        {
+            return;
+        }
+
+        m_queue.wake();
+        m_writer.join();
+        m_reader.join();
+    }
+
+    template <typename Call, typename Result>
+    void PipelinedChannel<Call, Result>::enqueue(Call&& call, Completion&& completion)
+    {
+        auto item = std::make_pair(std::move(call), std::move(completion));
+
+        /* Queue full: the writer is behind, so wait for it rather than drop a command. */
+        while (!m_queue.push(std::move(item)))
+        {
+            std::this_thread::yield();
+        }
+    }
+
+    template <typename Call, typename Result>
+    void PipelinedChannel<Call, Result>::fail(std::vector<Completion>& completions, std::exception_ptr error)
+    {
+        for (auto& completion : completions)
+        {
+            completion(nullptr, error);
+        }
+    }
+
+    /* Writer thread: sends the queued calls in batches while the pipe has room. */
+    template <typename Call, typename Result>
+    void PipelinedChannel<Call, Result>::write()
+    {
+        std::pair<Call, Completion> item;
+        std::vector<Call> calls;
+        std::vector<Completion> completions;
+
+        while (m_running.load(std::memory_order_acquire) || !m_queue.empty())
+        {
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_condition.wait(lock, [this]() { return m_in_flight.size() < m_max_in_flight || m_error; });
+            }
+
+            while (calls.size() < m_max_batch && m_queue.pop(item))
+            {
+                calls.push_back(std::move(item.first));
+                completions.push_back(std::move(item.second));
+            }
+
+            if (calls.empty())
+            {
+                m_queue.wait(m_running);
+                continue;
+            }
+
+            std::exception_ptr error;
+
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                error = m_error;
+            }
+
+            if (!error)
+            {
+                auto tag = m_next_tag++;
+
+                try
+                {
+                    /* Registered first, as the response may arrive before send returns. */
+                    {
+                        std::lock_guard<std::mutex> lock(m_mutex);
+                        m_in_flight.emplace(tag, std::move(completions));
+                    }
+
+                    m_condition.notify_all();
+                    m_send(tag, calls);
+                }
+                catch (...)
+                {
+                    /* The reader fails this batch with the rest once the broken connection stops it. */
+                    std::lock_guard<std::mutex> lock(m_mutex);
+
+                    if (!m_error)
+                    {
+                        m_error = std::current_exception();
+                    }
+                }
+            }
+            else
+            {
+                fail(completions, error);
+            }
+
+            calls.clear();
+            completions.clear();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_writer_done = true;
+        }
+
+        m_condition.notify_all();
+    }
+
+    /* Reader thread: completes each batch as its response arrives. */
+    template <typename Call, typename Result>
+    void PipelinedChannel<Call, Result>::read()
+    {
+        while (true)
+        {
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_condition.wait(lock, [this]() { return !m_in_flight.empty() || m_writer_done; });
+
+                if (m_in_flight.empty())
+                {
+                    return;
+                }
+            }
+
+            std::vector<Completion> completions;
+
+            try
+            {
+                auto response = m_receive();
+
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    auto batch = m_in_flight.find(response.first);
+
+                    if (batch == m_in_flight.end())
+                    {
+                        throw std::runtime_error("Response to unknown request tag " + std::to_string(response.first));
+                    }
+
+                    completions = std::move(batch->second);
+                    m_in_flight.erase(batch);
+                }
+
+                m_condition.notify_all();
+
+                if (response.second.size() != completions.size())
+                {
+                    throw std::runtime_error("Response has " + std::to_string(response.second.size()) + " results for " + std::to_string(completions.size()) + " calls");
+                }
+
+                for (size_t i = 0; i < completions.size(); i++)
+                {
+                    completions[i](&response.second[i], nullptr);
+                }
+            }
+            catch (...)
+            {
+                /* The connection can no longer be trusted: fail everything unanswered, and later calls. */
+                std::unordered_map<uint64_t, std::vector<Completion>> in_flight;
+                auto error = std::current_exception();
+
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+
+                    if (!m_error)
+                    {
+                        m_error = error;
+                    }
+
+                    error = m_error;
+                    in_flight.swap(m_in_flight);
+                }
+
+                m_condition.notify_all();
+                fail(completions, error);
+
+                for (auto& batch : in_flight)
+                {
+                    fail(batch.second, error);
+                }
+            }
+        }
+    }
+}
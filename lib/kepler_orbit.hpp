@@ -0,0 +1,314 @@
+#pragma once
+
+#include <math.h>
+#include "vector3.hpp"
+
+namespace KSP
+{
+    /**
+     * Two-body orbit propagated locally from its elements, so positions and velocities at any UT
+     * cost no RPCs. Uses the same axes as velocity_at(): KSP's y-up convention, the orbit normal
+     * of an equatorial orbit along y. Elliptic and hyperbolic orbits are supported.
+     * The perifocal axes are computed once, so a state costs one Kepler solve.
+     */
+    class KeplerOrbit
+    {
+    private:
+        double m_mu;
+        double m_a;
+        double m_e;
+        double m_mean_anomaly_at_epoch;
+        double m_epoch;
+        double m_mean_motion;
+        /* Unit vectors to periapsis and 90 degrees ahead of it. */
+        Vector3 m_p;
+        Vector3 m_q;
+    public:
+        KeplerOrbit();
+        KeplerOrbit(
+            double gravitational_parameter,
+            double semi_major_axis,
+            double eccentricity,
+            double inclination,
+            double longitude_of_ascending_node,
+            double argument_of_periapsis,
+            double mean_anomaly_at_epoch,
+            double epoch
+        );
+        ~KeplerOrbit();
+    public:
+        static KeplerOrbit from_state(Vector3 position, Vector3 velocity, double gravitational_parameter, double ut);
+    public:
+        Vector3 position_at(double ut);
+        Vector3 velocity_at(double ut);
+        void state_at(double ut, Vector3& position, Vector3& velocity);
+        double mean_anomaly_at(double ut);
+        double eccentric_anomaly_at(double ut);
+        double gravitational_parameter();
+        double semi_major_axis();
+        double eccentricity();
+        double mean_motion();
+        double mean_anomaly_at_epoch();
+        double epoch();
+        double period();
+        double periapsis();
+        double apoapsis();
+        Vector3 normal();
+        Vector3 periapsis_direction();
+        Vector3 periapsis_velocity_direction();
+        bool closed();
+    };
+
+    KeplerOrbit::KeplerOrbit() : m_mu(1), m_a(1), m_e(0), m_mean_anomaly_at_epoch(0), m_epoch(0), m_mean_motion(1), m_p(1, 0, 0), m_q(0, 0, 1)
+    {
+    }
+
+    /* Angles in radians, as kRPC returns them. */
+    KeplerOrbit::KeplerOrbit(
+        double gravitational_parameter,
+        double semi_major_axis,
+        double eccentricity,
+        double inclination,
+        double longitude_of_ascending_node,
+        double argument_of_periapsis,
+        double mean_anomaly_at_epoch,
+        double epoch
+    ) : m_mu(gravitational_parameter), m_a(semi_major_axis), m_e(eccentricity), m_mean_anomaly_at_epoch(mean_anomaly_at_epoch), m_epoch(epoch)
+    {
+        auto cos_lan = cos(longitude_of_ascending_node);
+        auto sin_lan = sin(longitude_of_ascending_node);
+        auto cos_aop = cos(argument_of_periapsis);
+        auto sin_aop = sin(argument_of_periapsis);
+        auto cos_i = cos(inclination);
+        auto sin_i = sin(inclination);
+
+        m_mean_motion = sqrt(m_mu / pow(abs(m_a), 3));
+        m_p = Vector3(
+            cos_aop * cos_lan - sin_aop * cos_i * sin_lan,
+            sin_aop * sin_i,
+            cos_aop * sin_lan + sin_aop * cos_i * cos_lan
+        );
+        m_q = Vector3(
+            -(sin_aop * cos_lan + cos_aop * cos_i * sin_lan),
+            cos_aop * sin_i,
+            cos_aop * cos_i * cos_lan - sin_aop * sin_lan
+        );
+    }
+
+    KeplerOrbit::~KeplerOrbit()
+    {
+    }
+
+    /* Orbit through a position and velocity at ut. A circular orbit gets its periapsis at position. */
+    KeplerOrbit KeplerOrbit::from_state(Vector3 position, Vector3 velocity, double gravitational_parameter, double ut)
+    {
+        KeplerOrbit orbit;
+        auto radius = position.length();
+        auto momentum = position.cross(velocity);
+        auto eccentricity_vector = velocity.cross(momentum) / gravitational_parameter - position / radius;
+
+        orbit.m_mu = gravitational_parameter;
+        orbit.m_a = 1 / (2 / radius - velocity.dot(velocity) / gravitational_parameter);
+        orbit.m_e = eccentricity_vector.length();
+        orbit.m_epoch = ut;
+        orbit.m_mean_motion = sqrt(gravitational_parameter / pow(abs(orbit.m_a), 3));
+        orbit.m_p = orbit.m_e > 1e-9 ? eccentricity_vector / orbit.m_e : position / radius;
+        orbit.m_q = momentum.cross(orbit.m_p).normalize();
+
+        /* Anomaly of position, measured from periapsis towards the direction of motion. */
+        auto true_anomaly = atan2(position.dot(orbit.m_q), position.dot(orbit.m_p));
+        auto e = orbit.m_e;
+
+        if (e < 1)
+        {
+            auto eccentric_anomaly = 2 * atan(sqrt((1 - e) / (1 + e)) * tan(true_anomaly / 2));
+            orbit.m_mean_anomaly_at_epoch = eccentric_anomaly - e * sin(eccentric_anomaly);
+        }
+        else
+        {
+            auto hyperbolic_anomaly = 2 * atanh(sqrt((e - 1) / (e + 1)) * tan(true_anomaly / 2));
+            orbit.m_mean_anomaly_at_epoch = e * sinh(hyperbolic_anomaly) - hyperbolic_anomaly;
+        }
+
+        return orbit;
+    }
+
+    Vector3 KeplerOrbit::position_at(double ut)
+    {
+        Vector3 position;
+        Vector3 velocity;
+
+        state_at(ut, position, velocity);
+
+        return position;
+    }
+
+    Vector3 KeplerOrbit::velocity_at(double ut)
+    {
+        Vector3 position;
+        Vector3 velocity;
+
+        state_at(ut, position, velocity);
+
+        return velocity;
+    }
+
+    void KeplerOrbit::state_at(double ut, Vector3& position, Vector3& velocity)
+    {
+        auto anomaly = eccentric_anomaly_at(ut);
+        auto e = m_e;
+        double x, y, vx, vy;
+
+        if (e < 1)
+        {
+            auto c = cos(anomaly);
+            auto s = sin(anomaly);
+            auto b = sqrt(1 - e * e);
+            auto r = m_a * (1 - e * c);
+            auto speed = sqrt(m_mu * m_a) / r;
+
+            x = m_a * (c - e);
+            y = m_a * b * s;
+            vx = -speed * s;
+            vy = speed * b * c;
+        }
+        else
+        {
+            auto a = -m_a;
+            auto c = cosh(anomaly);
+            auto s = sinh(anomaly);
+            auto b = sqrt(e * e - 1);
+            auto r = a * (e * c - 1);
+            auto speed = sqrt(m_mu * a) / r;
+
+            x = a * (e - c);
+            y = a * b * s;
+            vx = -speed * s;
+            vy = speed * b * c;
+        }
+
+        position = m_p * x + m_q * y;
+        velocity = m_p * vx + m_q * vy;
+    }
+
+    /* Not wrapped, so it grows with time; the Kepler solve wraps it. */
+    double KeplerOrbit::mean_anomaly_at(double ut)
+    {
+        return m_mean_anomaly_at_epoch + m_mean_motion * (ut - m_epoch);
+    }
+
+    /* Hyperbolic anomaly for open orbits. Newton's method, a few iterations from a good start. */
+    double KeplerOrbit::eccentric_anomaly_at(double ut)
+    {
+        auto mean_anomaly = mean_anomaly_at(ut);
+        auto e = m_e;
+
+        if (e < 1)
+        {
+            mean_anomaly = remainder(mean_anomaly, 2 * M_PI);
+
+            auto anomaly = e < 0.8 ? mean_anomaly : (mean_anomaly < 0 ? -M_PI : M_PI);
+
+            for (int i = 0; i < 30; i++)
+            {
+                auto step = (anomaly - e * sin(anomaly) - mean_anomaly) / (1 - e * cos(anomaly));
+
+                anomaly -= step;
+
+                if (abs(step) < 1e-12)
+                {
+                    break;
+                }
+            }
+
+            return anomaly;
+        }
+
+        auto anomaly = asinh(mean_anomaly / e);
+
+        for (int i = 0; i < 50; i++)
+        {
+            auto step = (e * sinh(anomaly) - anomaly - mean_anomaly) / (e * cosh(anomaly) - 1);
+
+            anomaly -= step;
+
+            if (abs(step) < 1e-12)
+            {
+                break;
+            }
+        }
+
+        return anomaly;
+    }
+
+    double KeplerOrbit::gravitational_parameter()
+    {
+        return m_mu;
+    }
+
+    /* Negative for hyperbolic orbits. */
+    double KeplerOrbit::semi_major_axis()
+    {
+        return m_a;
+    }
+
+    double KeplerOrbit::eccentricity()
+    {
+        return m_e;
+    }
+
+    double KeplerOrbit::mean_motion()
+    {
+        return m_mean_motion;
+    }
+
+    double KeplerOrbit::mean_anomaly_at_epoch()
+    {
+        return m_mean_anomaly_at_epoch;
+    }
+
+    double KeplerOrbit::epoch()
+    {
+        return m_epoch;
+    }
+
+    /* Infinite for open orbits. */
+    double KeplerOrbit::period()
+    {
+        return closed() ? 2 * M_PI / m_mean_motion : INFINITY;
+    }
+
+    /* Radii, not altitudes. */
+    double KeplerOrbit::periapsis()
+    {
+        return m_a * (1 - m_e);
+    }
+
+    double KeplerOrbit::apoapsis()
+    {
+        return closed() ? m_a * (1 + m_e) : INFINITY;
+    }
+
+    /* Unit vector along the angular momentum. */
+    Vector3 KeplerOrbit::normal()
+    {
+        return m_p.cross(m_q);
+    }
+
+    /* Unit vector from the body to periapsis. */
+    Vector3 KeplerOrbit::periapsis_direction()
+    {
+        return m_p;
+    }
+
+    /* Unit vector along the velocity at periapsis. */
+    Vector3 KeplerOrbit::periapsis_velocity_direction()
+    {
+        return m_q;
+    }
+
+    bool KeplerOrbit::closed()
+    {
+        return m_e < 1;
+    }
+}
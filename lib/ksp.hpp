@@ -16,4 +16,33 @@
 #include "angles.hpp"
 #include "stages.hpp"
 #include "constants.hpp"
-#include "orbital_mechanics.hpp"
\ No newline at end of file
+#include "orbital_mechanics.hpp"
+#include "quaternion.hpp"
+#include "loop_statistics.hpp"
+#include "attitude_controller.hpp"
+#include "powered_descent.hpp"
+#include "ascent_guidance.hpp"
+#include "ascent_table.hpp"
+#include "ascent_simulator.hpp"
+#include "burn_plan.hpp"
+#include "burn_cutoff.hpp"
+#include "scheduler.hpp"
+#include "condition.hpp"
+#include "state_machine.hpp"
+#include "mission_task.hpp"
+#include "vessel_runtime.hpp"
+#include "io_thread.hpp"
+#include "rpc_pipeline.hpp"
+#include "telemetry.hpp"
+#include "resilient_connection.hpp"
+#include "metadata_cache.hpp"
+#include "kepler_orbit.hpp"
+#include "closest_approach.hpp"
+#include "conjunction_screening.hpp"
+#include "clohessy_wiltshire.hpp"
+#include "rendezvous.hpp"
+#include "phasing_planner.hpp"
+#include "transfer_optimizer.hpp"
+#include "patched_conics.hpp"
+#include "ephemeris.hpp"
+#include "reentry_predictor.hpp"
\ No newline at end of file
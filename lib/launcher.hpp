@@ -1,11 +1,21 @@
 #pragma once
 
+#include <cmath>
+#include <memory>
+#include <iostream>
 #include "angles.hpp"
 #include "countdown.hpp"
+#include "vector3.hpp"
+#include "constants.hpp"
+#include "ascent_guidance.hpp"
+#include "ascent_table.hpp"
 
 namespace KSP
 {
     const double TURN_SPEED = 120;
+    const double GUIDANCE_CYCLE = 0.1;
+    /* Largest difference between a table's target apoapsis and the mission's, in m. */
+    const double TABLE_TARGET_TOLERANCE = 1000.0;
 
     class Launcher
     {
@@ -16,14 +26,23 @@ namespace KSP
         double m_inclination;
         double m_turn_altitude = 0.0;
         bool m_orbit;
+        std::unique_ptr<AscentGuidance> m_guidance;
+        ReferenceFrame m_guidance_reference_frame;
+        double m_guidance_altitude = 0.0;
+        double m_guidance_cycle_time = -1.0;
+        AscentTable m_table;
+        double m_target_apoapsis = 0.0;
     public:
         Launcher(Vessel vessel, ResourcesMap resources, double inclination = 0.0, bool orbit = true);
         ~Launcher();
     public:
         void launch(double throttle = 1.0, int countdown = 0);
-        bool step(int current_stage, double altitude, double speed);
+        void enable_guidance(double target_altitude, double engage_altitude);
+        bool load_table(std::string path, double target_apoapsis);
+        bool step(int current_stage, double altitude, double speed, double apoapsis = -INFINITY);
     private:
         double altitude_function_derivative(double altitude);
+        void guidance_pitch(double& target_pitch);
     };
 
     Launcher::Launcher(Vessel vessel, ResourcesMap resources, double inclination, bool orbit)
@@ -48,7 +67,46 @@ namespace KSP
         m_vessel.control().activate_next_stage();
     }
 
-    bool Launcher::step(int stage, double altitude, double speed)
+    /**
+     * Closed-loop guidance of the pitch above the engage altitude, for the least delta-v to a
+     * circular orbit at the target altitude. The caller still cuts the engines once the apoapsis
+     * reaches the target, then coasts and circularises, as with the turn.
+     */
+    void Launcher::enable_guidance(double target_altitude, double engage_altitude)
+    {
+        auto body = m_vessel.orbit().body();
+
+        m_guidance = std::make_unique<AscentGuidance>(body.gravitational_parameter(), body.equatorial_radius() + target_altitude);
+        m_guidance_reference_frame = body.non_rotating_reference_frame();
+        m_guidance_altitude = engage_altitude;
+        m_guidance_cycle_time = -1.0;
+    }
+
+    /**
+     * Flies the pitch and throttle program from a table made by tools/ascent_optimizer. Keeps the
+     * turn if the file cannot be read or was optimised for another target apoapsis.
+     */
+    bool Launcher::load_table(std::string path, double target_apoapsis)
+    {
+        if (!m_table.load(path))
+        {
+            m_table = AscentTable();
+            return false;
+        }
+
+        if (std::abs(m_table.target_altitude() - target_apoapsis) > TABLE_TARGET_TOLERANCE)
+        {
+            std::cout << "Ignoring " << path << ": made for an apoapsis of " << m_table.target_altitude() << " m, not " << target_apoapsis << " m" << std::endl;
+            m_table = AscentTable();
+            return false;
+        }
+
+        m_target_apoapsis = target_apoapsis;
+        return true;
+    }
+
+    /* Needs the apoapsis altitude when flying a table; without it the table's coast is never trusted. */
+    bool Launcher::step(int stage, double altitude, double speed, double apoapsis)
     {
         /* Set turn altitude if speed is above a limit and craft goes to orbit. */
         if (m_orbit && speed > TURN_SPEED && m_turn_altitude <= 0.01)
@@ -60,6 +118,31 @@ namespace KSP
         auto target_pitch = m_turn_altitude > 0.01 ? std::max(0.0, rad_to_deg(atan2(altitude, altitude_function_derivative(altitude) * altitude))) : 90;
         auto target_heading = 90 + m_inclination;
 
+        /*
+         * The program coasts where the simulated craft had reached its apoapsis. A craft that
+         * underperforms the simulation would coast short of it for ever, so drop the table and
+         * fly the turn at full throttle instead.
+         */
+        if (!m_table.empty() && m_table.throttle(altitude) <= 0.0 && apoapsis < m_target_apoapsis)
+        {
+            std::cout << "Apoapsis short of the table's target, continuing on the standard turn" << std::endl;
+            m_table = AscentTable();
+            m_vessel.control().set_throttle(1.0);
+        }
+
+        /* A precomputed program replaces the turn. */
+        if (!m_table.empty())
+        {
+            target_pitch = m_table.pitch(altitude);
+            m_vessel.control().set_throttle(m_table.throttle(altitude));
+        }
+
+        /* Guidance overrides the turn once it has converged. */
+        if (m_guidance && altitude >= m_guidance_altitude)
+        {
+            guidance_pitch(target_pitch);
+        }
+
         m_vessel.auto_pilot().target_pitch_and_heading(target_pitch, target_heading);
 
         /* Stage when fuel is low. */
@@ -78,4 +161,33 @@ namespace KSP
     {
         return (altitude - m_turn_altitude) / (10000 - m_turn_altitude);
     }
+
+    /* Runs a guidance major cycle at most every GUIDANCE_CYCLE seconds; close to cutoff the steering is held. */
+    void Launcher::guidance_pitch(double& target_pitch)
+    {
+        auto time = m_vessel.met();
+
+        if (!m_guidance->terminal(time) && time - m_guidance_cycle_time >= GUIDANCE_CYCLE)
+        {
+            auto position = Vector3(m_vessel.position(m_guidance_reference_frame));
+            auto velocity = Vector3(m_vessel.velocity(m_guidance_reference_frame));
+            auto radius = position.length();
+            auto mass = m_vessel.mass();
+
+            m_guidance_cycle_time = time;
+            m_guidance->update(
+                time,
+                radius,
+                position.dot(velocity) / radius,
+                position.cross(velocity).length() / radius,
+                m_vessel.thrust() / mass,
+                m_vessel.specific_impulse() * STANDARD_GRAVITY
+            );
+        }
+
+        if (m_guidance->converged())
+        {
+            target_pitch = rad_to_deg(m_guidance->pitch(time));
+        }
+    }
 }
\ No newline at end of file
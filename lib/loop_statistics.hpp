@@ -0,0 +1,84 @@
+#pragma once
+
+#include <chrono>
+#include <iostream>
+#include <algorithm>
+
+namespace KSP
+{
+    /* Wall-clock timing of a control loop, in seconds. */
+    class LoopStatistics
+    {
+    public:
+        LoopStatistics();
+    public:
+        unsigned long count;
+        unsigned long overruns;
+        double last;
+        double mean;
+        double max;
+    public:
+        void add(double seconds, double period = 0.0);
+        void reset();
+    public:
+        friend std::ostream& operator<<(std::ostream& out, const LoopStatistics& statistics);
+    };
+
+    /* Steady-clock stopwatch started on construction. */
+    class LoopClock
+    {
+    private:
+        std::chrono::steady_clock::time_point m_start;
+    public:
+        LoopClock();
+    public:
+        double elapsed();
+    };
+
+    LoopStatistics::LoopStatistics()
+    {
+        reset();
+    }
+
+    void LoopStatistics::add(double seconds, double period)
+    {
+        count++;
+        last = seconds;
+        mean += (seconds - mean) / count;
+        max = std::max(max, seconds);
+
+        if (period > 0.0 && seconds > period)
+        {
+            overruns++;
+        }
+    }
+
+    void LoopStatistics::reset()
+    {
+        count = 0;
+        overruns = 0;
+        last = 0.0;
+        mean = 0.0;
+        max = 0.0;
+    }
+
+    std::ostream& operator<<(std::ostream& out, const LoopStatistics& s)
+    {
+        out << "loops: " << s.count
+            << "  last: " << s.last * 1000 << " ms"
+            << "  mean: " << s.mean * 1000 << " ms"
+            << "  max: " << s.max * 1000 << " ms"
+            << "  overruns: " << s.overruns;
+
+        return out;
+    }
+
+    LoopClock::LoopClock() : m_start(std::chrono::steady_clock::now())
+    {
+    }
+
+    double LoopClock::elapsed()
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - m_start).count();
+    }
+}
@@ -1,15 +1,29 @@
 #pragma once
 
 #include <math.h>
+#include <string>
+#include <iostream>
+#include <stdexcept>
 #include "enums/types.hpp"
 #include "connection.hpp"
 #include "node_executor.hpp"
 #include "sleep.hpp"
 #include "vector3.hpp"
 #include "angles.hpp"
+#include "orbital_mechanics.hpp"
+#include "phasing_planner.hpp"
+#include "transfer_optimizer.hpp"
+#include "reentry_predictor.hpp"
+#include "loop_statistics.hpp"
+#include "condition.hpp"
 
 namespace KSP
 {
+    /* Furthest a deorbit target may lie off the ground track, in m. */
+    const double MAX_CROSS_TRACK = 20000.0;
+    /* Passes to wait for the ground track to come within MAX_CROSS_TRACK; in low Kerbin orbit it shifts over 300 km per pass. */
+    const int MAX_DEORBIT_REVOLUTIONS = 24;
+
     class Maneuver
     {
     private:
@@ -25,7 +39,11 @@ namespace KSP
         void lower_orbit_from_apoapsis(double periapsis_target);
         void raise_orbit_from_periapsis(double apoapsis_target);
         void transfer_to_body(Body target);
+        void transfer_to_body_with_plane_change(Body target);
         void transfer_to_vessel(Vessel target);
+        void transfer_to_vessel(Vessel target, double max_time);
+        ReentryImpact deorbit_to(double latitude, double longitude, double periapsis_target, ReentryPredictor& predictor);
+        void descend_to(double latitude, double longitude, double parachute_altitude, ReentryPredictor& predictor);
     private:
         double calculate_velocity(Orbit orbit);
         double calculate_velocity(Orbit orbit, double apoapsis, double periapsis, double altitude);
@@ -36,6 +54,7 @@ namespace KSP
         double calculate_transfer_delta_v(double current_radius, double target_radius, double gravitational_parameter);
         double calculate_transfer_delta_v(Orbit current_orbit, Orbit target_orbit);
         void transfer(Orbit target_orbit, Vector3 target_position);
+        void transfer(PhasingPlan plan);
         void change_inclination(Orbit target_orbit, Vector3 target_position, Vector3 target_velocity);
     };
 
@@ -166,6 +185,43 @@ namespace KSP
         transfer(target_orbit, target_position);
     }
 
+    /**
+     * Transfer to the target body with the plane change folded into the transfer, instead of
+     * change_inclination() followed by transfer_to_body(). A mid-course burn, if the plan has
+     * one, is re-planned from the orbit the first burn actually produced.
+     */
+    void Maneuver::transfer_to_body_with_plane_change(Body target)
+    {
+        auto orbit = m_vessel.orbit();
+        TransferOptimizer optimizer(kepler_orbit(orbit), kepler_orbit(target.orbit()));
+        auto plan = optimizer.optimize(m_connection.space_center.ut());
+
+        if (plan.burns.empty())
+        {
+            std::cout << "NO COMBINED TRANSFER, CHANGING INCLINATION FIRST" << std::endl;
+            change_inclination(target);
+            transfer_to_body(target);
+            return;
+        }
+
+        std::cout << "TRANSFER DELTA-V: " << plan.delta_v << " BURNS: " << plan.burns.size() << std::endl;
+
+        auto first = plan.burns[0];
+        auto first_node = m_vessel.control().add_node(first.time, first.prograde, first.normal, first.radial);
+
+        NodeExecutor first_executor(first_node, m_vessel);
+        first_executor.execute(m_connection, 1.0);
+
+        if (plan.burns.size() > 1)
+        {
+            auto second = optimizer.correction(kepler_orbit(m_vessel.orbit()), plan.burns[1].time, plan.arrival_time);
+            auto second_node = m_vessel.control().add_node(second.time, second.prograde, second.normal, second.radial);
+
+            NodeExecutor second_executor(second_node, m_vessel);
+            second_executor.execute(m_connection, 1.0);
+        }
+    }
+
     void Maneuver::transfer_to_vessel(Vessel target)
     {
         auto target_orbit = target.orbit();
@@ -175,6 +231,254 @@ namespace KSP
         transfer(target_orbit, target_position);
     }
 
+    /**
+     * Transfer to the target with the cheapest plan that arrives within max_time seconds, flying
+     * a few revolutions of a phasing orbit instead of waiting for the next Hohmann window.
+     * Like the direct transfer, it leaves matching the target's orbit to the rendezvous.
+     */
+    void Maneuver::transfer_to_vessel(Vessel target, double max_time)
+    {
+        auto orbit = m_vessel.orbit();
+        auto body = orbit.body();
+        auto start = m_connection.space_center.ut();
+        PhasingPlanner planner(kepler_orbit(orbit), kepler_orbit(target.orbit()));
+
+        planner.min_radius = body.equatorial_radius() + body.atmosphere_depth();
+        planner.max_radius = body.sphere_of_influence();
+
+        auto front = planner.pareto_front(start);
+
+        if (front.empty())
+        {
+            std::cout << "NO PHASING PLAN, WAITING FOR TRANSFER WINDOW" << std::endl;
+            transfer_to_vessel(target);
+            return;
+        }
+
+        for (auto& plan : front)
+        {
+            std::cout << "ARRIVAL: T+" << plan.arrival_time - start << " DELTA-V: " << plan.delta_v << " REVOLUTIONS: " << plan.revolutions << std::endl;
+        }
+
+        auto plan = PhasingPlanner::cheapest(front, start + max_time);
+
+        std::cout << "CHOSEN: T+" << plan.arrival_time - start << " DELTA-V: " << plan.delta_v << std::endl;
+
+        transfer(plan);
+    }
+
+    /**
+     * Deorbit burn that puts the impact point of the capsule modelled by predictor on the target,
+     * at the latitude and longitude in degrees. Coasts until a burn down to periapsis_target would
+     * land on the target, then burns retrograde until the live prediction reaches it, re-predicting
+     * at 10 Hz. Only the downrange distance can be corrected this way, so a pass whose ground track
+     * is further than MAX_CROSS_TRACK from the target is skipped: time is warped to shortly before
+     * the next pass, as the planet turns under the orbit. Throws if none of MAX_DEORBIT_REVOLUTIONS
+     * passes comes close enough. The burn stops if the periapsis drops below the surface, the
+     * engines flame out or it runs well past the expected burn time.
+     */
+    ReentryImpact Maneuver::deorbit_to(double latitude, double longitude, double periapsis_target, ReentryPredictor& predictor)
+    {
+        auto body = m_vessel.orbit().body();
+        auto reference_frame = body.reference_frame();
+        auto position_stream = m_vessel.position_stream(reference_frame);
+        auto velocity_stream = m_vessel.velocity_stream(reference_frame);
+        auto periapsis_stream = m_vessel.orbit().periapsis_altitude_stream();
+        auto thrust_stream = m_vessel.thrust_stream();
+        auto ut_stream = m_connection.space_center.ut_stream();
+        auto retrograde_direction = Vector3(0, -1, 0);
+
+        predictor.gravitational_parameter = body.gravitational_parameter();
+        predictor.body_radius = body.equatorial_radius();
+        predictor.rotational_speed = body.rotational_speed();
+        predictor.atmosphere_depth = body.atmosphere_depth();
+
+        auto target = predictor.surface_position(latitude, longitude);
+        auto previous_angle = 0.0;
+        auto delta_v = 0.0;
+        auto revolution = 1;
+        ReentryImpact impact;
+
+        /* The target is met again a little under an orbit later on a retrograde orbit, later on a prograde one. */
+        auto revisit_time = 1 / (1 / m_vessel.orbit().period() + 1 / body.rotational_period());
+
+        m_vessel.auto_pilot().set_reference_frame(m_vessel.orbital_reference_frame());
+        m_vessel.auto_pilot().set_target_direction(retrograde_direction.to_tuple());
+        m_vessel.auto_pilot().engage();
+
+        /* The target comes closer as the orbit carries the vessel towards it; wait until it crosses the impact point. */
+        while (true)
+        {
+            auto position = Vector3(position_stream());
+            auto velocity = Vector3(velocity_stream());
+            auto target_angle = ReentryPredictor::angle_ahead(position, velocity, target);
+            auto deorbit_velocity = predictor.deorbit_velocity(position, velocity, periapsis_target);
+
+            impact = predictor.predict(position, deorbit_velocity, ut_stream());
+
+            if (impact.impact && previous_angle > ReentryPredictor::angle_ahead(position, velocity, impact.position)
+                && target_angle <= ReentryPredictor::angle_ahead(position, velocity, impact.position))
+            {
+                /* Off the great circle from here to the impact point, which the burn only moves along. */
+                auto normal = position.cross(impact.position).normalize();
+                auto cross_track = abs(asin(target.normalize().dot(normal))) * predictor.body_radius;
+
+                std::cout << "TARGET " << cross_track / 1000 << " KM OFF THE GROUND TRACK ON PASS " << revolution << std::endl;
+
+                if (cross_track <= MAX_CROSS_TRACK)
+                {
+                    delta_v = (velocity - deorbit_velocity).length();
+                    break;
+                }
+
+                if (revolution++ >= MAX_DEORBIT_REVOLUTIONS)
+                {
+                    throw std::runtime_error("Deorbit target stayed over " + std::to_string(MAX_CROSS_TRACK / 1000) + " km off the ground track for "
+                                             + std::to_string(MAX_DEORBIT_REVOLUTIONS) + " passes");
+                }
+
+                /* Skip most of the way to the next pass, then look for the crossing again. */
+                m_connection.space_center.warp_to(ut_stream() + 0.75 * revisit_time);
+                previous_angle = 0.0;
+                continue;
+            }
+
+            previous_angle = target_angle;
+            sleep_milliseconds(100);
+        }
+
+        auto burn_time = get_burn_time(m_vessel, delta_v, 1.0);
+
+        if (!std::isfinite(burn_time))
+        {
+            throw std::runtime_error("No thrust for the deorbit burn");
+        }
+
+        std::cout << "DEORBIT BURN OF " << delta_v << " M/S, IMPACT IN " << impact.time - ut_stream() << " S" << std::endl;
+
+        /* Burning before the vessel has turned would throw the impact off the target. */
+        m_vessel.auto_pilot().wait();
+        m_vessel.control().set_throttle(1.0);
+
+        LoopClock clock;
+
+        while (periapsis_stream() > 0)
+        {
+            auto position = Vector3(position_stream());
+            auto velocity = Vector3(velocity_stream());
+
+            impact = predictor.predict(position, velocity, ut_stream());
+
+            if (impact.impact && ReentryPredictor::angle_ahead(position, velocity, impact.position) <= ReentryPredictor::angle_ahead(position, velocity, target))
+            {
+                break;
+            }
+
+            /* Engines take a moment to spool up, so only a lasting loss of thrust is a flameout. */
+            if ((clock.elapsed() > 1.0 && thrust_stream() <= 0) || clock.elapsed() > 2 * burn_time + 5)
+            {
+                std::cout << "DEORBIT BURN STOPPED SHORT AFTER " << clock.elapsed() << " S" << std::endl;
+                break;
+            }
+
+            sleep_milliseconds(100);
+        }
+
+        m_vessel.control().set_throttle(0.0);
+
+        std::cout << "PREDICTED IMPACT: " << impact.latitude << ", " << impact.longitude << ", "
+                  << impact.position.angle_3d(target) * predictor.body_radius / 1000 << " KM FROM TARGET" << std::endl;
+
+        return impact;
+    }
+
+    /**
+     * Follows the predicted impact at 5 Hz down to parachute_altitude above the surface, fitting the
+     * predictor's drag model to the measured drag and its mass to the vessel's as it goes. Reads
+     * everything from streams; the parachute altitude is a server-side event, so the deploy is not
+     * late by a tick. Prints the prediction when it moves and once at the end.
+     */
+    void Maneuver::descend_to(double latitude, double longitude, double parachute_altitude, ReentryPredictor& predictor)
+    {
+        auto reference_frame = m_vessel.orbit().body().reference_frame();
+        auto flight = m_vessel.flight(reference_frame);
+        auto target = predictor.surface_position(latitude, longitude);
+        auto position_stream = m_vessel.position_stream(reference_frame);
+        auto velocity_stream = m_vessel.velocity_stream(reference_frame);
+        auto altitude_stream = flight.mean_altitude_stream();
+        auto density_stream = flight.atmosphere_density_stream();
+        auto drag_stream = flight.drag_stream();
+        auto ut_stream = m_connection.space_center.ut_stream();
+        auto surface_altitude = Quantity(m_connection, m_vessel.flight(m_vessel.surface_reference_frame()).surface_altitude_call());
+        auto parachute_trigger = (surface_altitude <= parachute_altitude).trigger(m_connection);
+        auto printed = Vector3(0, 0, 0);
+        ReentryImpact impact;
+
+        auto print = [&]() {
+            std::cout << "PREDICTED IMPACT: " << impact.latitude << ", " << impact.longitude << ", "
+                      << impact.position.angle_3d(target) * predictor.body_radius / 1000 << " KM FROM TARGET" << std::endl;
+            printed = impact.position;
+        };
+
+        predictor.mass = m_vessel.mass();
+
+        while (!parachute_trigger.triggered())
+        {
+            auto position = Vector3(position_stream());
+            auto velocity = Vector3(velocity_stream());
+
+            predictor.calibrate(altitude_stream(), density_stream(), Vector3(drag_stream()).length(), velocity.length());
+            impact = predictor.predict(position, velocity, ut_stream());
+
+            /* Once per kilometre the prediction moves. */
+            if ((impact.position - printed).length() > 1000.0)
+            {
+                print();
+            }
+
+            sleep_milliseconds(200);
+        }
+
+        print();
+    }
+
+    /* The second burn is timed from the orbit the first one actually produced. */
+    void Maneuver::transfer(PhasingPlan plan)
+    {
+        if (plan.revolutions == 0 || plan.phasing_orbit == PHASE_BEFORE_TRANSFER)
+        {
+            auto transfer_time = plan.transfer_time;
+
+            if (plan.revolutions > 0)
+            {
+                auto phasing_node = m_vessel.control().add_node(plan.phasing_time, plan.phasing_delta_v);
+
+                NodeExecutor phasing_executor(phasing_node, m_vessel);
+                phasing_executor.execute(m_connection, 1.0);
+
+                transfer_time = plan.phasing_time + plan.revolutions * m_vessel.orbit().period();
+            }
+
+            auto transfer_node = m_vessel.control().add_node(transfer_time, plan.transfer_delta_v);
+
+            NodeExecutor transfer_executor(transfer_node, m_vessel);
+            transfer_executor.execute(m_connection, 1.0);
+        }
+        else
+        {
+            auto transfer_node = m_vessel.control().add_node(plan.transfer_time, plan.transfer_delta_v);
+
+            NodeExecutor transfer_executor(transfer_node, m_vessel);
+            transfer_executor.execute(m_connection, 1.0);
+
+            auto phasing_time = plan.transfer_time + m_vessel.orbit().period() / 2;
+            auto phasing_node = m_vessel.control().add_node(phasing_time, plan.phasing_delta_v);
+
+            NodeExecutor phasing_executor(phasing_node, m_vessel);
+            phasing_executor.execute(m_connection, 1.0);
+        }
+    }
+
     void Maneuver::transfer(Orbit target_orbit, Vector3 target_position)
     {
         auto current_orbit = m_vessel.orbit();
@@ -0,0 +1,604 @@
+#pragma once
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <cmath>
+#include <deque>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <algorithm>
+#include <unordered_map>
+#include "connection.hpp"
+#include "burn_plan.hpp"
+#include "kepler_orbit.hpp"
+#include "patched_conics.hpp"
+#include "enums/types.hpp"
+
+namespace KSP
+{
+    const char METADATA_CACHE_MAGIC[4] = {'K', 'M', 'C', '3'};
+
+    /* Constants of a celestial body and its orbit around the parent. The orbit is zero for the Sun. */
+    struct BodyMetadata
+    {
+        char name[32];
+        char parent[32];
+        /* Remote object IDs; only valid in the game session they were fetched in, 0 if unknown. */
+        uint64_t body_id;
+        uint64_t reference_frame_id;
+        uint64_t non_rotating_reference_frame_id;
+        double gravitational_parameter;
+        double equatorial_radius;
+        double atmosphere_depth;
+        double flying_high_altitude_threshold;
+        double sphere_of_influence;
+        double rotational_period;
+        double surface_gravity;
+        double semi_major_axis;
+        double eccentricity;
+        double inclination;
+        double longitude_of_ascending_node;
+        double argument_of_periapsis;
+        double mean_anomaly_at_epoch;
+        double epoch;
+    };
+
+    /* Stage layout of a craft, as built by BurnPlan, at the mass it was fetched at. */
+    struct CraftMetadata
+    {
+        char name[64];
+        double mass;
+        double throttle;
+        uint32_t first_stage;
+        uint32_t stage_count;
+    };
+
+    /* File layout: header, then the bodies, the crafts and all craft stages as packed arrays. */
+    struct MetadataCacheHeader
+    {
+        char magic[4];
+        uint32_t body_count;
+        uint64_t key;
+        uint32_t craft_count;
+        uint32_t stage_count;
+        /* Non-zero if the bodies are every body in the system. */
+        uint32_t complete;
+        uint32_t reserved;
+    };
+
+    /**
+     * On-disk cache of metadata that does not change during a game: body constants, the orbit
+     * hierarchy and craft stage layouts. The file is mapped at startup and used in place, so a
+     * warm start reads them without RPCs. The key is the given save name plus the server version;
+     * a file with another key is ignored and rewritten.
+     * The cached bodies are checked against the server once, on the first lookup of any of them:
+     * one body is looked up by name and its gravitational parameter compared, and a mismatch, e.g.
+     * from a mod changing the system, drops every body. If its ID differs, the game was restarted
+     * since the file was written and body IDs are fetched again as they are used.
+     * Craft layouts are only reused at the same mass, e.g. for a craft on the pad or a burn that
+     * is flown again after a restart.
+     */
+    class MetadataCache
+    {
+    private:
+        Connection* m_connection;
+        std::string m_path;
+        uint64_t m_key;
+        void* m_memory = nullptr;
+        size_t m_size = 0;
+        std::unordered_map<std::string, const BodyMetadata*> m_bodies;
+        std::unordered_map<std::string, const CraftMetadata*> m_crafts;
+        const BurnStage* m_stages = nullptr;
+        /* Records fetched this run; deques keep the pointers above stable. */
+        std::deque<BodyMetadata> m_fetched_bodies;
+        std::deque<std::pair<CraftMetadata, std::vector<BurnStage>>> m_fetched_crafts;
+        std::unordered_map<std::string, const std::vector<BurnStage>*> m_fetched_stages;
+        std::unordered_map<std::string, Body> m_server_bodies;
+        bool m_complete = false;
+        bool m_validated = false;
+        bool m_session_valid = false;
+        bool m_dirty = false;
+    public:
+        double mass_tolerance = 1e-3;
+    public:
+        MetadataCache(Connection& connection, std::string path = "metadata.cache", std::string key = "default");
+        MetadataCache(const MetadataCache&) = delete;
+        ~MetadataCache();
+    public:
+        const BodyMetadata& constants(std::string name);
+        Body body(std::string name);
+        ReferenceFrame reference_frame(std::string name);
+        ReferenceFrame non_rotating_reference_frame(std::string name);
+        std::vector<ConicBody> conic_bodies();
+        BurnPlan burn_plan(Vessel vessel, double throttle);
+        size_t size();
+        void save();
+    private:
+        void load();
+        void unmap();
+        void validate();
+        bool mapped(const BodyMetadata* record);
+        bool needs_handles(const BodyMetadata* record);
+        const BodyMetadata& fetch(std::string name);
+        const BodyMetadata& handles(std::string name);
+        std::unordered_map<std::string, Body>& server_bodies();
+    };
+
+    /* FNV-1a. */
+    uint64_t metadata_cache_key(std::string key)
+    {
+        uint64_t hash = 14695981039346656037ull;
+
+        for (auto character : key)
+        {
+            hash = (hash ^ static_cast<uint8_t>(character)) * 1099511628211ull;
+        }
+
+        return hash;
+    }
+
+    MetadataCache::MetadataCache(Connection& connection, std::string path, std::string key)
+        : m_connection(&connection), m_path(path)
+    {
+        m_key = metadata_cache_key(key + '\0' + connection.krpc.get_status().version);
+        load();
+    }
+
+    /* Writes the records fetched this run. */
+    MetadataCache::~MetadataCache()
+    {
+        try
+        {
+            save();
+        }
+        catch (const std::exception& exception)
+        {
+            std::cout << "Could not save metadata cache: " << exception.what() << std::endl;
+        }
+
+        unmap();
+    }
+
+    /* Needs no RPCs once the body is cached and the cache validated. */
+    const BodyMetadata& MetadataCache::constants(std::string name)
+    {
+        validate();
+
+        auto found = m_bodies.find(name);
+
+        if (found == m_bodies.end())
+        {
+            return fetch(name);
+        }
+
+        return *found->second;
+    }
+
+    Body MetadataCache::body(std::string name)
+    {
+        return Body(&m_connection->client, handles(name).body_id);
+    }
+
+    ReferenceFrame MetadataCache::reference_frame(std::string name)
+    {
+        return ReferenceFrame(&m_connection->client, handles(name).reference_frame_id);
+    }
+
+    ReferenceFrame MetadataCache::non_rotating_reference_frame(std::string name)
+    {
+        return ReferenceFrame(&m_connection->client, handles(name).non_rotating_reference_frame_id);
+    }
+
+    /**
+     * Every body with its orbit, as KSP::conic_bodies gives them, for PatchedConicPredictor and
+     * Ephemeris. Fetching the whole system takes a few hundred RPCs, so this is where a warm start
+     * gains the most.
+     */
+    std::vector<ConicBody> MetadataCache::conic_bodies()
+    {
+        validate();
+
+        std::vector<std::string> names;
+
+        if (!m_complete)
+        {
+            for (auto& [name, body] : server_bodies())
+            {
+                names.push_back(name);
+            }
+        }
+        else
+        {
+            for (auto& [name, record] : m_bodies)
+            {
+                names.push_back(name);
+            }
+        }
+
+        /* Sorted by name, as in KSP::conic_bodies. */
+        std::sort(names.begin(), names.end());
+
+        std::vector<ConicBody> conic;
+
+        for (auto& name : names)
+        {
+            auto& record = constants(name);
+            auto root = record.parent[0] == '\0';
+            auto orbit = KeplerOrbit();
+
+            if (!root)
+            {
+                orbit = KeplerOrbit(
+                    constants(record.parent).gravitational_parameter,
+                    record.semi_major_axis,
+                    record.eccentricity,
+                    record.inclination,
+                    record.longitude_of_ascending_node,
+                    record.argument_of_periapsis,
+                    record.mean_anomaly_at_epoch,
+                    record.epoch
+                );
+            }
+
+            conic.push_back({name, record.gravitational_parameter, record.equatorial_radius, root ? INFINITY : record.sphere_of_influence, -1, orbit});
+        }
+
+        for (auto& body : conic)
+        {
+            auto parent = std::string(constants(body.name).parent);
+
+            for (size_t j = 0; j < conic.size(); j++)
+            {
+                if (conic[j].name == parent)
+                {
+                    body.parent = j;
+                }
+            }
+        }
+
+        if (!m_complete)
+        {
+            m_complete = true;
+            m_dirty = true;
+        }
+
+        return conic;
+    }
+
+    /**
+     * Burn plan from the cached stage layout if the vessel has the name and mass it was cached at.
+     * That costs two RPCs instead of a query per part and engine.
+     */
+    BurnPlan MetadataCache::burn_plan(Vessel vessel, double throttle)
+    {
+        auto name = vessel.name();
+        auto mass = vessel.mass();
+        auto found = m_crafts.find(name);
+
+        if (found != m_crafts.end() && found->second->throttle == throttle && std::abs(found->second->mass - mass) <= mass_tolerance * mass)
+        {
+            auto fetched = m_fetched_stages.find(name);
+
+            if (fetched != m_fetched_stages.end())
+            {
+                return BurnPlan(*fetched->second);
+            }
+
+            auto first = m_stages + found->second->first_stage;
+
+            return BurnPlan(std::vector<BurnStage>(first, first + found->second->stage_count));
+        }
+
+        BurnPlan plan(vessel, throttle);
+        CraftMetadata craft = {};
+        std::vector<BurnStage> stages;
+
+        for (size_t i = 0; i < plan.stage_count(); i++)
+        {
+            stages.push_back(plan.stage(i));
+        }
+
+        std::strncpy(craft.name, name.c_str(), sizeof(craft.name) - 1);
+        craft.mass = mass;
+        craft.throttle = throttle;
+        craft.stage_count = stages.size();
+
+        m_fetched_crafts.push_back(std::make_pair(craft, stages));
+        m_crafts[name] = &m_fetched_crafts.back().first;
+        m_fetched_stages[name] = &m_fetched_crafts.back().second;
+        m_dirty = true;
+
+        return plan;
+    }
+
+    /* Number of cached bodies. */
+    size_t MetadataCache::size()
+    {
+        return m_bodies.size();
+    }
+
+    /**
+     * Written to a temporary file and renamed, so a crash never leaves a partial cache. IDs from
+     * an earlier game session that were not fetched again are written as unknown.
+     */
+    void MetadataCache::save()
+    {
+        if (!m_dirty)
+        {
+            return;
+        }
+
+        std::vector<BodyMetadata> bodies;
+        std::vector<BurnStage> stages;
+        std::vector<CraftMetadata> crafts;
+
+        for (auto& [name, body] : m_bodies)
+        {
+            auto record = *body;
+
+            if (needs_handles(body))
+            {
+                record.body_id = 0;
+                record.reference_frame_id = 0;
+                record.non_rotating_reference_frame_id = 0;
+            }
+
+            bodies.push_back(record);
+        }
+
+        for (auto& [name, craft] : m_crafts)
+        {
+            auto record = *craft;
+            auto fetched = m_fetched_stages.find(name);
+
+            record.first_stage = stages.size();
+
+            if (fetched != m_fetched_stages.end())
+            {
+                stages.insert(stages.end(), fetched->second->begin(), fetched->second->end());
+            }
+            else
+            {
+                stages.insert(stages.end(), m_stages + craft->first_stage, m_stages + craft->first_stage + craft->stage_count);
+            }
+
+            crafts.push_back(record);
+        }
+
+        MetadataCacheHeader header = {};
+        std::memcpy(header.magic, METADATA_CACHE_MAGIC, sizeof(header.magic));
+        header.key = m_key;
+        header.body_count = bodies.size();
+        header.craft_count = crafts.size();
+        header.stage_count = stages.size();
+        header.complete = m_complete;
+
+        auto temporary = m_path + ".tmp";
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(bodies.data()), bodies.size() * sizeof(BodyMetadata));
+        file.write(reinterpret_cast<const char*>(crafts.data()), crafts.size() * sizeof(CraftMetadata));
+        file.write(reinterpret_cast<const char*>(stages.data()), stages.size() * sizeof(BurnStage));
+        file.close();
+
+        if (!file || std::rename(temporary.c_str(), m_path.c_str()) != 0)
+        {
+            throw std::runtime_error("Could not write '" + m_path + "'");
+        }
+
+        m_dirty = false;
+    }
+
+    /* A missing, truncated or differently keyed file leaves the cache empty. */
+    void MetadataCache::load()
+    {
+        auto descriptor = open(m_path.c_str(), O_RDONLY);
+
+        if (descriptor < 0)
+        {
+            return;
+        }
+
+        struct stat status;
+
+        if (fstat(descriptor, &status) != 0 || static_cast<size_t>(status.st_size) < sizeof(MetadataCacheHeader))
+        {
+            close(descriptor);
+            return;
+        }
+
+        m_size = status.st_size;
+        m_memory = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+        close(descriptor);
+
+        if (m_memory == MAP_FAILED)
+        {
+            m_memory = nullptr;
+            return;
+        }
+
+        auto header = static_cast<const MetadataCacheHeader*>(m_memory);
+        auto size = sizeof(MetadataCacheHeader)
+            + header->body_count * sizeof(BodyMetadata)
+            + header->craft_count * sizeof(CraftMetadata)
+            + header->stage_count * sizeof(BurnStage);
+
+        if (std::memcmp(header->magic, METADATA_CACHE_MAGIC, sizeof(header->magic)) != 0 || header->key != m_key || size != m_size)
+        {
+            unmap();
+            return;
+        }
+
+        auto bodies = reinterpret_cast<const BodyMetadata*>(header + 1);
+        auto crafts = reinterpret_cast<const CraftMetadata*>(bodies + header->body_count);
+        m_stages = reinterpret_cast<const BurnStage*>(crafts + header->craft_count);
+        m_complete = header->complete != 0;
+
+        for (uint32_t i = 0; i < header->body_count; i++)
+        {
+            m_bodies[std::string(bodies[i].name, strnlen(bodies[i].name, sizeof(bodies[i].name)))] = &bodies[i];
+        }
+
+        for (uint32_t i = 0; i < header->craft_count; i++)
+        {
+            if (crafts[i].first_stage + crafts[i].stage_count <= header->stage_count)
+            {
+                m_crafts[std::string(crafts[i].name, strnlen(crafts[i].name, sizeof(crafts[i].name)))] = &crafts[i];
+            }
+        }
+    }
+
+    void MetadataCache::unmap()
+    {
+        if (m_memory != nullptr)
+        {
+            munmap(m_memory, m_size);
+            m_memory = nullptr;
+        }
+    }
+
+    /**
+     * Once per run, two RPCs: looks up a cached body by name, whatever the game session, and
+     * compares its gravitational parameter. A missing body or a mismatch drops every cached body.
+     * The same lookup tells whether the cached IDs are from this game session.
+     */
+    void MetadataCache::validate()
+    {
+        if (m_validated)
+        {
+            return;
+        }
+
+        m_validated = true;
+
+        /* Prefer a record that has IDs, so the session can be checked too. */
+        const BodyMetadata* record = nullptr;
+
+        for (auto& [name, body] : m_bodies)
+        {
+            if (mapped(body) && (record == nullptr || record->body_id == 0))
+            {
+                record = body;
+            }
+        }
+
+        if (record == nullptr)
+        {
+            return;
+        }
+
+        auto found = server_bodies().find(record->name);
+
+        if (found == server_bodies().end() || found->second.gravitational_parameter() != record->gravitational_parameter)
+        {
+            std::cout << "Metadata cache is stale, fetching again." << std::endl;
+
+            m_bodies.clear();
+            m_complete = false;
+            m_dirty = true;
+            return;
+        }
+
+        m_session_valid = record->body_id != 0 && found->second._id == record->body_id;
+    }
+
+    /* Whether the record is in the mapped file, rather than fetched this run. */
+    bool MetadataCache::mapped(const BodyMetadata* record)
+    {
+        auto address = reinterpret_cast<const char*>(record);
+        auto memory = static_cast<const char*>(m_memory);
+
+        return m_memory != nullptr && address >= memory && address < memory + m_size;
+    }
+
+    /* Records fetched this run are always current; mapped ones only in the session they came from. */
+    bool MetadataCache::needs_handles(const BodyMetadata* record)
+    {
+        return mapped(record) && (!m_session_valid || record->body_id == 0);
+    }
+
+    /* About twenty RPCs; only done once per body and save. */
+    const BodyMetadata& MetadataCache::fetch(std::string name)
+    {
+        auto body = server_bodies().at(name);
+        auto orbit = body.orbit();
+        BodyMetadata record = {};
+
+        std::strncpy(record.name, name.c_str(), sizeof(record.name) - 1);
+        record.body_id = body._id;
+        record.reference_frame_id = body.reference_frame()._id;
+        record.non_rotating_reference_frame_id = body.non_rotating_reference_frame()._id;
+        record.gravitational_parameter = body.gravitational_parameter();
+        record.equatorial_radius = body.equatorial_radius();
+        record.atmosphere_depth = body.atmosphere_depth();
+        record.flying_high_altitude_threshold = body.flying_high_altitude_threshold();
+        record.sphere_of_influence = body.sphere_of_influence();
+        record.rotational_period = body.rotational_period();
+        record.surface_gravity = body.surface_gravity();
+
+        /* The Sun has no orbit. */
+        if (!(orbit == Orbit()))
+        {
+            std::strncpy(record.parent, orbit.body().name().c_str(), sizeof(record.parent) - 1);
+            record.semi_major_axis = orbit.semi_major_axis();
+            record.eccentricity = orbit.eccentricity();
+            record.inclination = orbit.inclination();
+            record.longitude_of_ascending_node = orbit.longitude_of_ascending_node();
+            record.argument_of_periapsis = orbit.argument_of_periapsis();
+            record.mean_anomaly_at_epoch = orbit.mean_anomaly_at_epoch();
+            record.epoch = orbit.epoch();
+        }
+
+        m_fetched_bodies.push_back(record);
+        m_bodies[name] = &m_fetched_bodies.back();
+        m_dirty = true;
+
+        return m_fetched_bodies.back();
+    }
+
+    /* Record with IDs that are valid in this game session. */
+    const BodyMetadata& MetadataCache::handles(std::string name)
+    {
+        auto& cached = constants(name);
+
+        if (!needs_handles(&cached))
+        {
+            return cached;
+        }
+
+        /* Constants are still good, only the IDs are fetched again. */
+        auto record = cached;
+        auto body = server_bodies().at(name);
+
+        record.body_id = body._id;
+        record.reference_frame_id = body.reference_frame()._id;
+        record.non_rotating_reference_frame_id = body.non_rotating_reference_frame()._id;
+
+        m_fetched_bodies.push_back(record);
+        m_bodies[name] = &m_fetched_bodies.back();
+        m_dirty = true;
+
+        return m_fetched_bodies.back();
+    }
+
+    /* All bodies come from one RPC, made on first use. */
+    std::unordered_map<std::string, Body>& MetadataCache::server_bodies()
+    {
+        if (m_server_bodies.empty())
+        {
+            auto bodies = m_connection->space_center.bodies();
+            m_server_bodies.insert(bodies.begin(), bodies.end());
+        }
+
+        return m_server_bodies;
+    }
+}
@@ -0,0 +1,418 @@
+#pragma once
+
+#include <mutex>
+#include <deque>
+#include <chrono>
+#include <vector>
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <condition_variable>
+#include "condition.hpp"
+
+namespace KSP
+{
+    class Executor;
+
+    /**
+     * Coroutine for mission scripts, run by an Executor. Awaiting a Task runs it on the same
+     * executor and resumes the caller when it finishes; exceptions propagate to the caller.
+     */
+    class Task
+    {
+    public:
+        struct promise_type;
+        typedef std::coroutine_handle<promise_type> Handle;
+
+        struct FinalAwaiter
+        {
+            bool await_ready() noexcept { return false; }
+            void await_suspend(Handle handle) noexcept;
+            void await_resume() noexcept {}
+        };
+
+        struct promise_type
+        {
+            Executor* executor = nullptr;
+            std::coroutine_handle<> continuation;
+            std::exception_ptr exception;
+            bool done = false;
+
+            Task get_return_object() { return Task(Handle::from_promise(*this)); }
+            std::suspend_always initial_suspend() noexcept { return {}; }
+            FinalAwaiter final_suspend() noexcept { return {}; }
+            void return_void() {}
+            void unhandled_exception() { exception = std::current_exception(); }
+        };
+    private:
+        Handle m_handle;
+    public:
+        Task(Handle handle);
+        Task(Task&& other) noexcept;
+        Task(const Task&) = delete;
+        ~Task();
+    public:
+        bool done();
+        Handle handle();
+        bool await_ready();
+        void await_suspend(Handle caller);
+        void await_resume();
+    };
+
+    /**
+     * Single-threaded executor. Parked coroutines are resumed when their condition holds. The
+     * conditions are re-checked whenever a stream or event callback calls notify(), and at least
+     * every poll_period otherwise. Many vessels or subsystems can run as tasks in one thread.
+     */
+    class Executor
+    {
+    private:
+        struct Waiter
+        {
+            std::coroutine_handle<> handle;
+            std::function<bool()> ready;
+        };
+
+        std::vector<Task> m_tasks;
+        std::deque<std::coroutine_handle<>> m_ready;
+        std::vector<Waiter> m_waiting;
+        std::mutex m_mutex;
+        std::condition_variable m_condition;
+        bool m_notified = false;
+    public:
+        std::chrono::milliseconds poll_period = std::chrono::milliseconds(10);
+    public:
+        Executor();
+        ~Executor();
+    public:
+        void spawn(Task task);
+        void run();
+        void schedule(std::coroutine_handle<> handle);
+        void park(std::coroutine_handle<> handle, std::function<bool()> ready);
+        void notify();
+    private:
+        bool finished();
+    };
+
+    /* Awaitable that suspends until a predicate holds, or a server-side trigger fires. */
+    class Until
+    {
+    private:
+        std::function<bool()> m_ready;
+        std::vector<Trigger> m_triggers;
+    public:
+        Until(std::function<bool()> ready);
+        Until(Trigger trigger);
+        ~Until();
+    public:
+        bool await_ready();
+        void await_suspend(Task::Handle caller);
+        void await_resume();
+    };
+
+    /* Awaitable that runs tasks concurrently and resumes when all have finished. */
+    class WhenAll
+    {
+    private:
+        std::vector<Task> m_tasks;
+    public:
+        WhenAll(std::vector<Task> tasks);
+        ~WhenAll();
+    public:
+        bool await_ready();
+        void await_suspend(Task::Handle caller);
+        void await_resume();
+    };
+
+    Task::Task(Handle handle) : m_handle(handle)
+    {
+    }
+
+    Task::Task(Task&& other) noexcept : m_handle(other.m_handle)
+    {
+        other.m_handle = nullptr;
+    }
+
+    Task::~Task()
+    {
+        if (m_handle)
+        {
+            m_handle.destroy();
+        }
+    }
+
+    bool Task::done()
+    {
+        return !m_handle || m_handle.promise().done;
+    }
+
+    Task::Handle Task::handle()
+    {
+        return m_handle;
+    }
+
+    bool Task::await_ready()
+    {
+        return done();
+    }
+
+    void Task::await_suspend(Handle caller)
+    {
+        m_handle.promise().executor = caller.promise().executor;
+        m_handle.promise().continuation = caller;
+        caller.promise().executor->schedule(m_handle);
+    }
+
+    void Task::await_resume()
+    {
+        if (m_handle.promise().exception)
+        {
+            std::rethrow_exception(m_handle.promise().exception);
+        }
+    }
+
+    void Task::FinalAwaiter::await_suspend(Handle handle) noexcept
+    {
+        auto& promise = handle.promise();
+
+        promise.done = true;
+
+        if (promise.continuation)
+        {
+            promise.executor->schedule(promise.continuation);
+        }
+    }
+
+    Executor::Executor()
+    {
+    }
+
+    Executor::~Executor()
+    {
+    }
+
+    void Executor::spawn(Task task)
+    {
+        task.handle().promise().executor = this;
+        schedule(task.handle());
+        m_tasks.push_back(std::move(task));
+    }
+
+    /* Runs until every spawned task has finished. Rethrows the first task exception. */
+    void Executor::run()
+    {
+        while (!finished())
+        {
+            /* Resume what is ready; resumed coroutines may park or schedule others. */
+            while (!m_ready.empty())
+            {
+                auto handle = m_ready.front();
+
+                m_ready.pop_front();
+                handle.resume();
+            }
+
+            for (auto& task : m_tasks)
+            {
+                if (task.done() && task.handle().promise().exception)
+                {
+                    std::rethrow_exception(task.handle().promise().exception);
+                }
+            }
+
+            if (finished())
+            {
+                break;
+            }
+
+            /* Wait for a stream callback or the poll period, then re-check parked conditions. */
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+
+                m_condition.wait_for(lock, poll_period, [this]() { return m_notified; });
+                m_notified = false;
+            }
+
+            for (size_t i = 0; i < m_waiting.size();)
+            {
+                if (m_waiting[i].ready())
+                {
+                    m_ready.push_back(m_waiting[i].handle);
+                    m_waiting[i] = m_waiting.back();
+                    m_waiting.pop_back();
+                }
+                else
+                {
+                    i++;
+                }
+            }
+        }
+    }
+
+    void Executor::schedule(std::coroutine_handle<> handle)
+    {
+        m_ready.push_back(handle);
+    }
+
+    void Executor::park(std::coroutine_handle<> handle, std::function<bool()> ready)
+    {
+        m_waiting.push_back({handle, ready});
+    }
+
+    /* Thread-safe; wakes the executor to re-check parked conditions. */
+    void Executor::notify()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_notified = true;
+        }
+
+        m_condition.notify_one();
+    }
+
+    bool Executor::finished()
+    {
+        for (auto& task : m_tasks)
+        {
+            if (!task.done())
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    Until::Until(std::function<bool()> ready) : m_ready(ready)
+    {
+    }
+
+    Until::Until(Trigger trigger) : m_ready([trigger]() mutable { return trigger.triggered(); }), m_triggers({trigger})
+    {
+    }
+
+    Until::~Until()
+    {
+    }
+
+    bool Until::await_ready()
+    {
+        return m_ready();
+    }
+
+    void Until::await_suspend(Task::Handle caller)
+    {
+        auto executor = caller.promise().executor;
+
+        /* Server-side triggers wake the executor as soon as they fire. */
+        for (auto& trigger : m_triggers)
+        {
+            trigger.on_trigger([executor]() { executor->notify(); });
+        }
+
+        executor->park(caller, m_ready);
+    }
+
+    /* The condition has held, so the server can stop evaluating it. */
+    void Until::await_resume()
+    {
+        for (auto& trigger : m_triggers)
+        {
+            trigger.event().remove();
+        }
+    }
+
+    WhenAll::WhenAll(std::vector<Task> tasks) : m_tasks(std::move(tasks))
+    {
+    }
+
+    WhenAll::~WhenAll()
+    {
+    }
+
+    bool WhenAll::await_ready()
+    {
+        for (auto& task : m_tasks)
+        {
+            if (!task.done())
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    void WhenAll::await_suspend(Task::Handle caller)
+    {
+        auto executor = caller.promise().executor;
+
+        for (auto& task : m_tasks)
+        {
+            task.handle().promise().executor = executor;
+            executor->schedule(task.handle());
+        }
+
+        executor->park(caller, [this]() { return await_ready(); });
+    }
+
+    void WhenAll::await_resume()
+    {
+        for (auto& task : m_tasks)
+        {
+            task.await_resume();
+        }
+    }
+
+    /* Suspends until the predicate, typically on stream values, holds. */
+    Until until(std::function<bool()> ready)
+    {
+        return Until(ready);
+    }
+
+    /* Suspends until a server-side condition is true, e.g. until((altitude > 70000).trigger(connection)). */
+    Until until(Trigger trigger)
+    {
+        return Until(trigger);
+    }
+
+    Until altitude_above(Connection& connection, Vessel vessel, double altitude)
+    {
+        return Until((Quantity(connection, vessel.flight().mean_altitude_call()) > altitude).trigger(connection));
+    }
+
+    Until altitude_below(Connection& connection, Vessel vessel, double altitude)
+    {
+        return Until((Quantity(connection, vessel.flight().mean_altitude_call()) < altitude).trigger(connection));
+    }
+
+    /* Suspends until the game's universal time reaches the given UT. */
+    Until ut_reached(krpc::Stream<double>& ut_stream, double time)
+    {
+        return Until([&ut_stream, time]() { return ut_stream() >= time; });
+    }
+
+    /* Suspends for a wall-clock duration without blocking other tasks. */
+    Until sleep_for(double seconds)
+    {
+        auto end = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(seconds));
+
+        return Until([end]() { return std::chrono::steady_clock::now() >= end; });
+    }
+
+    WhenAll when_all(std::vector<Task> tasks)
+    {
+        return WhenAll(std::move(tasks));
+    }
+
+    template <typename... Tasks>
+    WhenAll when_all(Task first, Tasks... rest)
+    {
+        std::vector<Task> tasks;
+
+        tasks.push_back(std::move(first));
+        (tasks.push_back(std::move(rest)), ...);
+
+        return WhenAll(std::move(tasks));
+    }
+}
@@ -7,6 +7,9 @@
 #include "constants.hpp"
 #include "stages.hpp"
 #include "formulae.hpp"
+#include "burn_plan.hpp"
+#include "burn_cutoff.hpp"
+#include "metadata_cache.hpp"
 
 namespace KSP
 {
@@ -15,17 +18,18 @@ namespace KSP
     private:
         ManeuverNode m_node;
         Vessel m_vessel;
+        /* Optional; reuses the stage layout instead of walking the parts for the burn plan. */
+        MetadataCache* m_metadata;
+        double m_residual_delta_v = 0.0;
     public:
-        NodeExecutor(ManeuverNode node, Vessel vessel);
+        NodeExecutor(ManeuverNode node, Vessel vessel, MetadataCache* metadata = nullptr);
         ~NodeExecutor();
     public:
         void execute(Connection connection, double throttle);
-    private:
-        double get_burn_time(double throttle, double delta_v_factor = 1.0);
-        double get_burn_time_stage(int stage, double throttle, double delta_v_remaining);
+        double residual_delta_v();
     };
 
-    NodeExecutor::NodeExecutor(ManeuverNode node, Vessel vessel) : m_node(node), m_vessel(vessel)
+    NodeExecutor::NodeExecutor(ManeuverNode node, Vessel vessel, MetadataCache* metadata) : m_node(node), m_vessel(vessel), m_metadata(metadata)
     {
 
     }
@@ -42,73 +46,28 @@ namespace KSP
             return;
         }
 
-        /* Get burn times. */
-        auto current_stage = get_current_decouple_stage(m_vessel);
-        auto stage_total_burn_time = get_decouple_stage_burn_time(current_stage, m_vessel, throttle, connection);
-        auto stage_total_delta_v = get_decouple_stage_delta_v(current_stage, m_vessel, throttle);
-        auto remaining_delta_v = m_node.remaining_delta_v();
-        auto lead_delta_v = remaining_delta_v / 2;
-        auto burn_time = get_burn_time_stage(current_stage, throttle, remaining_delta_v);
-        auto decouple_index = 0;
-        auto decouple_at = std::vector<double>();
-        auto total_burn_time = 0.0;
-        auto lead_burn_time = 0.0;
-
-        while(stage_total_burn_time <= burn_time)
-        {
-            remaining_delta_v -= stage_total_delta_v;
-
-            if (remaining_delta_v >= lead_delta_v)
-            {
-                lead_burn_time += get_burn_time_stage(current_stage, throttle, stage_total_delta_v);
-            }
-            else if (remaining_delta_v + stage_total_delta_v >= lead_delta_v)
-            {
-                lead_burn_time += get_burn_time_stage(current_stage, throttle, remaining_delta_v + stage_total_delta_v - lead_delta_v);
-            }
-
-            current_stage--;
-            total_burn_time += stage_total_burn_time;
-            decouple_at.push_back(total_burn_time);
-
-            stage_total_burn_time = get_decouple_stage_burn_time(current_stage, m_vessel, throttle, connection);
-            burn_time = get_burn_time_stage(current_stage, throttle, remaining_delta_v);
-            stage_total_delta_v = get_decouple_stage_delta_v(current_stage, m_vessel, throttle);
-        }
-
-        total_burn_time += burn_time;
-        remaining_delta_v -= stage_total_delta_v;
-
-        if (remaining_delta_v >= lead_delta_v)
-        {
-            lead_burn_time += get_burn_time_stage(current_stage, throttle, stage_total_delta_v);
-        }
-        else if (remaining_delta_v + stage_total_delta_v >= lead_delta_v)
-        {
-            lead_burn_time += get_burn_time_stage(current_stage, throttle, remaining_delta_v + stage_total_delta_v - lead_delta_v);
-        }
-
-        auto burn_start_time = m_node.ut() - lead_burn_time;
-        auto burn_stop_time = m_node.ut() + (total_burn_time - lead_burn_time);
+        /* Plan the burn from one snapshot of the vessel. */
+        auto plan = m_metadata != nullptr ? m_metadata->burn_plan(m_vessel, throttle) : BurnPlan(m_vessel, throttle);
+        plan.plan(m_node.remaining_delta_v(), m_node.ut());
 
         auto ut_call = connection.space_center.ut_call();
         auto ut_stream = connection.space_center.ut_stream();
-        auto current_stage_stream = m_vessel.control().current_stage_stream();
+        auto mass_stream = m_vessel.mass_stream();
         auto remaining_delta_v_stream = m_node.remaining_delta_v_stream();
         auto remaining_vector_stream = m_node.remaining_burn_vector_stream();
 
-        for (size_t i = 0; i < decouple_at.size(); i++)
+        if (!plan.feasible())
         {
-            decouple_at[i] += burn_start_time;
+            std::cout << "NOT ENOUGH DELTA-V FOR NODE" << std::endl;
         }
 
-        std::cout << "TOTAL TIME: " << total_burn_time << std::endl;
-        std::cout << "LEAD TIME:  " << lead_burn_time << std::endl;
-        std::cout << "START TIME: " << burn_start_time - ut_stream() << std::endl;
-        std::cout << "STOP TIME:  " << burn_stop_time - ut_stream() << std::endl;
+        std::cout << "TOTAL TIME: " << plan.total_time() << std::endl;
+        std::cout << "LEAD TIME:  " << plan.lead_time() << std::endl;
+        std::cout << "START TIME: " << plan.start_time() - ut_stream() << std::endl;
+        std::cout << "STOP TIME:  " << plan.stop_time() - ut_stream() << std::endl;
 
         /* Warp 60s until burn. */
-        connection.space_center.warp_to(burn_start_time - 60.0, 100000.0F, 4.0F);
+        connection.space_center.warp_to(plan.start_time() - 60.0, 100000.0F, 4.0F);
 
         /* Enable autopilot. */
         sleep_milliseconds(100);
@@ -120,7 +79,7 @@ namespace KSP
         sleep_milliseconds(100);
 
         /* Target node burn vector. */
-        while (ut_stream() < burn_start_time - 0.01)
+        while (ut_stream() < plan.start_time() - 0.01)
         {
             m_vessel.auto_pilot().set_target_direction(remaining_vector_stream());
             KSP::sleep_milliseconds(10);
@@ -129,80 +88,72 @@ namespace KSP
         /* Throttle up. */
         m_vessel.control().set_throttle(throttle);
 
-        /* Target node burn vector. */
-        while (ut_stream() < burn_stop_time - 1)
+        /* Target node burn vector, re-plan from the measured delta-v and mass, and stage on burnout. */
+        while (ut_stream() < plan.stop_time() - 1)
         {
-            auto stage = current_stage_stream();
+            auto time = ut_stream();
 
             m_vessel.auto_pilot().set_target_direction(remaining_vector_stream());
+            plan.update(time, remaining_delta_v_stream(), mass_stream());
 
-            if (
-                decouple_index < decouple_at.size()
-                && ut_stream() >= decouple_at[decouple_index]
-            ) {
+            if (plan.stage_due(time))
+            {
                 m_vessel.control().activate_next_stage();
-                decouple_index++;
+                plan.staged();
             }
 
             KSP::sleep_milliseconds(10);
         }
 
-        // remaining_delta_v = remaining_delta_v_stream();
-        // auto formula_constant = 10;
-        // auto twr = get_twr(m_vessel, m_vessel.orbit().body());
-
-        // while (remaining_delta_v_stream() > 0.5)
-        // {
-        //     auto throttle = std::min(1.0 / pow(M_E, -0.4 * (twr / 5) * (remaining_delta_v - formula_constant)), 1.0);
-        //     m_vessel.control().set_throttle(throttle);
-        //     m_vessel.auto_pilot().set_target_direction(remaining_vector_stream());
+        /* Step the throttle down and cut off on the physics frame where the node is done. */
+        BurnCutoff cutoff;
+        auto current_throttle = throttle;
 
-        //     std::cout << throttle << std::endl;
+        while (true)
+        {
+            ut_stream.acquire();
+            ut_stream.wait();
+            ut_stream.release();
 
-        //     remaining_delta_v = remaining_delta_v_stream();
+            auto time = ut_stream();
 
-        //     KSP::sleep_milliseconds(10);
-        // }
+            cutoff.add(time, remaining_delta_v_stream(), current_throttle);
+            m_vessel.auto_pilot().set_target_direction(remaining_vector_stream());
 
+            auto next_throttle = cutoff.throttle(throttle);
 
-        /* Throttle down. */
-        m_vessel.control().set_throttle(0);
-        burn_stop_time = get_burn_time(throttle * 0.5) + ut_stream();
-        m_vessel.control().set_throttle(throttle * 0.5);
-
-        /* Target node burn vector. */
-        while (ut_stream() < burn_stop_time - 0.001)
-        {
-            m_vessel.auto_pilot().set_target_direction(remaining_vector_stream());
-            KSP::sleep_milliseconds(1);
+            if (next_throttle != current_throttle)
+            {
+                current_throttle = next_throttle;
+                m_vessel.control().set_throttle(current_throttle);
+            }
+            else if (cutoff.ready() && cutoff.send_time() < time + PHYSICS_FRAME)
+            {
+                /* The cutoff falls before the next sample: wait out the rest of this frame. */
+                std::this_thread::sleep_for(std::chrono::duration<double>(std::max(0.0, cutoff.send_time() - time)));
+                break;
+            }
         }
 
+        auto predicted_residual = cutoff.predicted_residual();
+
         /* Cut engines, disable autopilot, remove node. */
         m_vessel.control().set_throttle(0);
         sleep_milliseconds(100);
+
+        /* Magnitude of what is left, whereas the prediction is negative for an overshoot. */
+        m_residual_delta_v = remaining_delta_v_stream();
+        std::cout << "RESIDUAL DELTA-V: " << m_residual_delta_v << " m/s (predicted " << predicted_residual << " m/s)" << std::endl;
+
         m_vessel.auto_pilot().disengage();
         sleep_milliseconds(100);
         m_node.remove();
     }
 
-    double NodeExecutor::get_burn_time(double throttle, double delta_v_factor)
+    /* Remaining delta-v of the node just after the last cutoff. */
+    double NodeExecutor::residual_delta_v()
     {
-        auto g = STANDARD_GRAVITY;
-        auto isp = m_vessel.specific_impulse();
-        auto mass = m_vessel.mass();
-        auto mass_delta = mass - mass / pow(M_E, (m_node.remaining_delta_v() * delta_v_factor) / (g * isp));
-
-        return mass_delta * g * isp / (m_vessel.available_thrust() * throttle);
-    }
-
-    double NodeExecutor::get_burn_time_stage(int stage, double throttle, double delta_v_remaining)
-    {
-        auto g = STANDARD_GRAVITY;
-        auto isp = get_decouple_stage_isp(stage, m_vessel, throttle);
-        auto mass = get_decouple_stage_mass(stage, m_vessel) + get_decouple_stage_mass_above(stage, m_vessel);
-        auto mass_delta = mass - mass / pow(M_E, (delta_v_remaining) / (g * isp));
-
-        return mass_delta * g * isp / (get_decouple_stage_thrust(stage, m_vessel, throttle) * throttle);
+        return m_residual_delta_v;
     }
 }
 
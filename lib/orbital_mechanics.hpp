@@ -1,8 +1,11 @@
 #pragma once
 
+#include <map>
 #include <math.h>
 #include "enums/types.hpp"
 #include "vector3.hpp"
+#include "kepler_orbit.hpp"
+#include "patched_conics.hpp"
 
 namespace KSP
 {
@@ -42,4 +45,58 @@ namespace KSP
             ov_approach.m_x * (cos(aop)*sin(lan) + sin(aop)*cos(i)*cos(lan)) + ov_approach.m_y * (cos(aop)*cos(i)*cos(lan) - sin(aop)*sin(lan))
         );
     }
+
+    /* Snapshot of the orbit's elements for local propagation; nine RPCs. */
+    KeplerOrbit kepler_orbit(Orbit orbit)
+    {
+        return KeplerOrbit(
+            orbit.body().gravitational_parameter(),
+            orbit.semi_major_axis(),
+            orbit.eccentricity(),
+            orbit.inclination(),
+            orbit.longitude_of_ascending_node(),
+            orbit.argument_of_periapsis(),
+            orbit.mean_anomaly_at_epoch(),
+            orbit.epoch()
+        );
+    }
+
+    /**
+     * Constants and orbits of every body for local patched-conic prediction; about fourteen RPCs
+     * per body. The root, the Sun, has no orbit and an unbounded sphere of influence.
+     */
+    std::vector<ConicBody> conic_bodies(std::map<std::string, Body> bodies)
+    {
+        std::vector<ConicBody> conic;
+        std::vector<std::string> parents;
+
+        for (auto& [name, body] : bodies)
+        {
+            auto orbit = body.orbit();
+            auto root = orbit == Orbit();
+
+            conic.push_back({
+                name,
+                body.gravitational_parameter(),
+                body.equatorial_radius(),
+                root ? INFINITY : body.sphere_of_influence(),
+                -1,
+                root ? KeplerOrbit() : kepler_orbit(orbit)
+            });
+            parents.push_back(root ? "" : orbit.body().name());
+        }
+
+        for (size_t i = 0; i < conic.size(); i++)
+        {
+            for (size_t j = 0; j < conic.size(); j++)
+            {
+                if (conic[j].name == parents[i])
+                {
+                    conic[i].parent = j;
+                }
+            }
+        }
+
+        return conic;
+    }
 }
@@ -0,0 +1,350 @@
+#pragma once
+
+#include <math.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "vector3.hpp"
+#include "kepler_orbit.hpp"
+#include "closest_approach.hpp"
+
+namespace KSP
+{
+    /* A body of the system. Its orbit is around the parent; the root has no parent. */
+    struct ConicBody
+    {
+        std::string name;
+        double gravitational_parameter;
+        double radius;
+        double sphere_of_influence;
+        int parent;
+        KeplerOrbit orbit;
+    };
+
+    enum PatchTransition
+    {
+        /* The prediction ran out of time or patches. */
+        PATCH_FINAL,
+        /* Entered the sphere of influence of one of the body's moons. */
+        PATCH_ENCOUNTER,
+        /* Left the body's sphere of influence for its parent's. */
+        PATCH_ESCAPE,
+        /* Hit the surface. */
+        PATCH_IMPACT
+    };
+
+    /* One conic of a trajectory, valid from start to end, around body. */
+    struct ConicPatch
+    {
+        size_t body;
+        KeplerOrbit orbit;
+        double start;
+        double end;
+        PatchTransition transition;
+    };
+
+    /**
+     * Patched-conic trajectory prediction, locally, as KSP does it: the vessel follows a Kepler
+     * orbit around one body until it enters a moon's sphere of influence, leaves the body's own,
+     * or hits the surface, and continues on the conic through its state relative to the next body.
+     * SOI exits and impacts are solved in closed form from the anomaly at that radius. Encounters
+     * are found by stepping towards the moon no faster than the two can close the gap, so none is
+     * missed, and solving the crossing with Brent's method. A Mun flyby from low Kerbin orbit
+     * takes a few dozen Kepler solves, so burn searches can try thousands of predictions a second.
+     */
+    class PatchedConicPredictor
+    {
+    private:
+        std::vector<ConicBody> m_bodies;
+    public:
+        int max_patches = 5;
+        double time_tolerance = 1e-3;
+        /* Shortest step of the encounter search, e.g. while grazing a sphere of influence. */
+        double min_step = 1.0;
+        /* Prograde delta-v samples over the range of a burn search. */
+        int burn_samples = 40;
+        /* Predictions made since construction. */
+        size_t predictions = 0;
+    public:
+        PatchedConicPredictor(std::vector<ConicBody> bodies);
+        ~PatchedConicPredictor();
+    public:
+        std::vector<ConicPatch> predict(size_t body, KeplerOrbit orbit, double start, double duration);
+        double periapsis_in(std::vector<ConicPatch>& patches, size_t body);
+        double prograde_for_periapsis(size_t body, KeplerOrbit orbit, double burn_time, size_t target, double target_periapsis, double low, double high, double duration);
+        KeplerOrbit burn(KeplerOrbit orbit, double time, double prograde);
+        ConicBody& body(size_t index);
+        size_t body_index(std::string name);
+    private:
+        double radius_time(KeplerOrbit& orbit, double radius, double start, bool outgoing);
+        double encounter_time(KeplerOrbit& orbit, size_t moon, double start, double end);
+    };
+
+    PatchedConicPredictor::PatchedConicPredictor(std::vector<ConicBody> bodies) : m_bodies(bodies)
+    {
+    }
+
+    PatchedConicPredictor::~PatchedConicPredictor()
+    {
+    }
+
+    /* Patches from start until duration has passed, the surface is hit or max_patches is reached. */
+    std::vector<ConicPatch> PatchedConicPredictor::predict(size_t body, KeplerOrbit orbit, double start, double duration)
+    {
+        std::vector<ConicPatch> patches;
+        auto end = start + duration;
+        auto time = start;
+
+        predictions++;
+
+        while (patches.size() < static_cast<size_t>(max_patches))
+        {
+            auto& current = m_bodies[body];
+            ConicPatch patch = {body, orbit, time, end, PATCH_FINAL};
+            size_t moon = 0;
+
+            if (orbit.periapsis() < current.radius)
+            {
+                auto impact = radius_time(orbit, current.radius, time, false);
+
+                if (impact < patch.end)
+                {
+                    patch.end = impact;
+                    patch.transition = PATCH_IMPACT;
+                }
+            }
+
+            if (!orbit.closed() || orbit.apoapsis() > current.sphere_of_influence)
+            {
+                auto escape = radius_time(orbit, current.sphere_of_influence, time, true);
+
+                if (escape < patch.end)
+                {
+                    patch.end = escape;
+                    patch.transition = PATCH_ESCAPE;
+                }
+            }
+
+            for (size_t i = 0; i < m_bodies.size(); i++)
+            {
+                if (m_bodies[i].parent == static_cast<int>(body))
+                {
+                    auto encounter = encounter_time(orbit, i, time, patch.end);
+
+                    if (encounter < patch.end)
+                    {
+                        patch.end = encounter;
+                        patch.transition = PATCH_ENCOUNTER;
+                        moon = i;
+                    }
+                }
+            }
+
+            patches.push_back(patch);
+
+            Vector3 position, velocity, body_position, body_velocity;
+
+            if (patch.transition == PATCH_ENCOUNTER)
+            {
+                orbit.state_at(patch.end, position, velocity);
+                m_bodies[moon].orbit.state_at(patch.end, body_position, body_velocity);
+                orbit = KeplerOrbit::from_state(position - body_position, velocity - body_velocity, m_bodies[moon].gravitational_parameter, patch.end);
+                body = moon;
+            }
+            else if (patch.transition == PATCH_ESCAPE && current.parent >= 0)
+            {
+                orbit.state_at(patch.end, position, velocity);
+                current.orbit.state_at(patch.end, body_position, body_velocity);
+                orbit = KeplerOrbit::from_state(position + body_position, velocity + body_velocity, m_bodies[current.parent].gravitational_parameter, patch.end);
+                body = current.parent;
+            }
+            else
+            {
+                break;
+            }
+
+            time = patch.end;
+        }
+
+        return patches;
+    }
+
+    /**
+     * Periapsis radius of the first patch around body, NaN if the trajectory never gets there.
+     * Below the body's radius for an impact.
+     */
+    double PatchedConicPredictor::periapsis_in(std::vector<ConicPatch>& patches, size_t body)
+    {
+        for (auto& patch : patches)
+        {
+            if (patch.body == body)
+            {
+                return patch.orbit.periapsis();
+            }
+        }
+
+        return NAN;
+    }
+
+    /**
+     * Prograde delta-v at burn_time, negative for retrograde, within [low, high], that puts the
+     * periapsis around target at target_periapsis (a radius). The range is sampled, each crossing
+     * is solved with Brent's method, and the smallest burn is returned, as there can be one for
+     * either side of a moon. NaN if no burn in the range does it.
+     */
+    double PatchedConicPredictor::prograde_for_periapsis(size_t body, KeplerOrbit orbit, double burn_time, size_t target, double target_periapsis, double low, double high, double duration)
+    {
+        auto error = [&](double prograde) {
+            auto patches = predict(body, burn(orbit, burn_time, prograde), burn_time, duration);
+
+            return periapsis_in(patches, target) - target_periapsis;
+        };
+
+        double best = NAN;
+        auto previous = low;
+        auto previous_error = error(low);
+
+        for (int i = 1; i <= burn_samples; i++)
+        {
+            auto current = low + (high - low) * i / burn_samples;
+            auto current_error = error(current);
+
+            if (std::isfinite(previous_error) && std::isfinite(current_error) && (previous_error > 0) != (current_error > 0))
+            {
+                auto root = brent_root(error, previous, current, previous_error, current_error, 1e-4);
+
+                if (!(abs(root) >= abs(best)))
+                {
+                    best = root;
+                }
+            }
+
+            previous = current;
+            previous_error = current_error;
+        }
+
+        return best;
+    }
+
+    /* Orbit after an impulsive prograde burn at time. */
+    KeplerOrbit PatchedConicPredictor::burn(KeplerOrbit orbit, double time, double prograde)
+    {
+        Vector3 position, velocity;
+
+        orbit.state_at(time, position, velocity);
+
+        return KeplerOrbit::from_state(position, velocity + velocity.normalize() * prograde, orbit.gravitational_parameter(), time);
+    }
+
+    ConicBody& PatchedConicPredictor::body(size_t index)
+    {
+        return m_bodies[index];
+    }
+
+    /* Index of the body with the name; the number of bodies if there is none. */
+    size_t PatchedConicPredictor::body_index(std::string name)
+    {
+        for (size_t i = 0; i < m_bodies.size(); i++)
+        {
+            if (m_bodies[i].name == name)
+            {
+                return i;
+            }
+        }
+
+        return m_bodies.size();
+    }
+
+    /**
+     * Next time after start the orbit passes radius, on the way out or in. Infinite if it never
+     * does, e.g. above its apoapsis, or on the way out of a hyperbola that is already past it.
+     */
+    double PatchedConicPredictor::radius_time(KeplerOrbit& orbit, double radius, double start, bool outgoing)
+    {
+        auto a = orbit.semi_major_axis();
+        auto e = orbit.eccentricity();
+        auto mean_anomaly = orbit.mean_anomaly_at(start);
+
+        if (e < 1e-9)
+        {
+            return INFINITY;
+        }
+
+        if (orbit.closed())
+        {
+            auto cos_anomaly = (1 - radius / a) / e;
+
+            if (abs(cos_anomaly) > 1)
+            {
+                return INFINITY;
+            }
+
+            auto anomaly = outgoing ? acos(cos_anomaly) : -acos(cos_anomaly);
+            auto difference = fmod(anomaly - e * sin(anomaly) - mean_anomaly, 2 * M_PI);
+
+            if (difference <= 1e-9)
+            {
+                difference += 2 * M_PI;
+            }
+
+            return start + difference / orbit.mean_motion();
+        }
+
+        auto cosh_anomaly = (1 - radius / a) / e;
+
+        if (cosh_anomaly < 1)
+        {
+            return INFINITY;
+        }
+
+        auto anomaly = outgoing ? acosh(cosh_anomaly) : -acosh(cosh_anomaly);
+        auto difference = e * sinh(anomaly) - anomaly - mean_anomaly;
+
+        return difference > 1e-9 ? start + difference / orbit.mean_motion() : INFINITY;
+    }
+
+    /**
+     * First time in [start, end] the orbit enters the moon's sphere of influence. Steps of the gap
+     * to the sphere over the fastest the two can close it are safe, so they shrink only near it.
+     * A trajectory that starts inside, e.g. just after escaping the moon, must leave it first.
+     */
+    double PatchedConicPredictor::encounter_time(KeplerOrbit& orbit, size_t moon, double start, double end)
+    {
+        auto& body = m_bodies[moon];
+        auto moon_orbit = body.orbit;
+        auto sphere = body.sphere_of_influence;
+
+        if (orbit.periapsis() > moon_orbit.apoapsis() + sphere || orbit.apoapsis() < moon_orbit.periapsis() - sphere)
+        {
+            return INFINITY;
+        }
+
+        /* Both are fastest at periapsis. */
+        auto mu = orbit.gravitational_parameter();
+        auto closing_speed = sqrt(mu * (2 / orbit.periapsis() - 1 / orbit.semi_major_axis()))
+                           + sqrt(mu * (2 / moon_orbit.periapsis() - 1 / moon_orbit.semi_major_axis()));
+
+        auto gap = [&](double time) { return (orbit.position_at(time) - moon_orbit.position_at(time)).length() - sphere; };
+
+        auto time = start;
+        auto current = gap(time);
+        auto outside = current > 0;
+
+        while (time < end)
+        {
+            auto next_time = std::min(time + std::max(abs(current) / closing_speed, min_step), end);
+            auto next = gap(next_time);
+
+            if (outside && next <= 0)
+            {
+                return brent_root(gap, time, next_time, current, next, time_tolerance);
+            }
+
+            outside = next > 0;
+            time = next_time;
+            current = next;
+        }
+
+        return INFINITY;
+    }
+}
@@ -0,0 +1,369 @@
+#pragma once
+
+#include <math.h>
+#include <vector>
+#include <thread>
+#include <algorithm>
+#include "vector3.hpp"
+#include "kepler_orbit.hpp"
+#include "closest_approach.hpp"
+
+namespace KSP
+{
+    enum PhasingOrbit
+    {
+        /* Phasing revolutions in an orbit through the chaser's radius, then the transfer. */
+        PHASE_BEFORE_TRANSFER,
+        /* The transfer first, then phasing revolutions in an orbit through the target's radius. */
+        PHASE_AFTER_TRANSFER
+    };
+
+    /**
+     * One way of reaching the target. Burns are prograde delta-v in m/s, negative for retrograde.
+     * Zero revolutions is the direct Hohmann transfer at the next window, without a phasing burn.
+     */
+    struct PhasingPlan
+    {
+        PhasingOrbit phasing_orbit;
+        int revolutions;
+        /* Radius of the phasing orbit's other apsis. */
+        double phasing_radius;
+        double phasing_time;
+        double phasing_delta_v;
+        double transfer_time;
+        double transfer_delta_v;
+        /* Burn that matches the target's orbit on arrival; left to the rendezvous. */
+        double arrival_delta_v;
+        /* Sum of the burn magnitudes. */
+        double delta_v;
+        double arrival_time;
+        double miss_distance;
+    };
+
+    /**
+     * Plans transfers to a target in a nearly coplanar, nearly circular orbit, trading wait time
+     * against delta-v. Instead of coasting until the next Hohmann window, the chaser can fly a few
+     * revolutions of a lower or higher phasing orbit, before the transfer or after it, so it
+     * arrives when the target is there. Revolution counts are searched on separate threads, over
+     * departure times and every phasing period that keeps the apsis within bounds. Plans that could
+     * be on the Pareto front, where no other plan is both faster and cheaper, are propagated with
+     * their burns to check they meet the target.
+     */
+    class PhasingPlanner
+    {
+    private:
+        KeplerOrbit m_chaser;
+        KeplerOrbit m_target;
+    public:
+        int max_revolutions = 50;
+        /* Departure times tried over one chaser revolution. */
+        int departure_samples = 36;
+        /* Bounds on the phasing orbit's other apsis, e.g. the top of the atmosphere and the sphere of influence. */
+        double min_radius = 0.0;
+        double max_radius = INFINITY;
+        /* Latest arrival considered, in seconds after the start. Ten Kerbin days. */
+        double horizon = 216000.0;
+        /* Time before the first burn, to turn the vessel. */
+        double lead_time = 120.0;
+        /* Plans whose propagated trajectory passes further from the target are dropped. */
+        double max_miss_distance = 10000.0;
+        /* Smallest saving in m/s for a slower plan to be on the front; without it, nearby departures crowd it. */
+        double delta_v_resolution = 1.0;
+        /* Zero uses every core. */
+        unsigned threads = 0;
+        /* Plans found and plans propagated in the last search. */
+        size_t searched_plans = 0;
+        size_t propagated_plans = 0;
+    public:
+        PhasingPlanner(KeplerOrbit chaser, KeplerOrbit target);
+        ~PhasingPlanner();
+    public:
+        std::vector<PhasingPlan> pareto_front(double start);
+        static PhasingPlan cheapest(std::vector<PhasingPlan>& front, double latest_arrival);
+    private:
+        static bool by_arrival(const PhasingPlan& a, const PhasingPlan& b);
+        void plan(double start, PhasingOrbit phasing_orbit, int revolutions, std::vector<PhasingPlan>& plans);
+        bool propagate(PhasingPlan& plan);
+    };
+
+    PhasingPlanner::PhasingPlanner(KeplerOrbit chaser, KeplerOrbit target) : m_chaser(chaser), m_target(target)
+    {
+    }
+
+    PhasingPlanner::~PhasingPlanner()
+    {
+    }
+
+    /**
+     * Plans on the front of arrival time against delta-v, fastest first, so cheapest last.
+     * Each thread sorts its plans by arrival and only propagates those cheaper than every faster
+     * plan it has already confirmed, as the rest cannot be on the front.
+     */
+    std::vector<PhasingPlan> PhasingPlanner::pareto_front(double start)
+    {
+        /* The direct transfer, then both phasing orbits for each revolution count. */
+        std::vector<std::pair<PhasingOrbit, int>> searches = {{PHASE_BEFORE_TRANSFER, 0}};
+
+        for (int revolutions = 1; revolutions <= max_revolutions; revolutions++)
+        {
+            searches.push_back({PHASE_BEFORE_TRANSFER, revolutions});
+            searches.push_back({PHASE_AFTER_TRANSFER, revolutions});
+        }
+
+        auto thread_count = threads > 0 ? threads : std::max(1u, std::thread::hardware_concurrency());
+        std::vector<std::vector<PhasingPlan>> found(thread_count);
+        std::vector<size_t> searched(thread_count, 0);
+        std::vector<size_t> propagated(thread_count, 0);
+        std::vector<std::thread> workers;
+
+        for (unsigned t = 0; t < thread_count; t++)
+        {
+            workers.emplace_back([this, start, &searches, &found, &searched, &propagated, thread_count, t]() {
+                std::vector<PhasingPlan> plans;
+
+                for (size_t i = t; i < searches.size(); i += thread_count)
+                {
+                    plan(start, searches[i].first, searches[i].second, plans);
+                }
+
+                std::sort(plans.begin(), plans.end(), by_arrival);
+
+                auto cheapest = INFINITY;
+
+                for (auto& candidate : plans)
+                {
+                    if (candidate.delta_v < cheapest - delta_v_resolution)
+                    {
+                        propagated[t]++;
+
+                        if (propagate(candidate))
+                        {
+                            found[t].push_back(candidate);
+                            cheapest = candidate.delta_v;
+                        }
+                    }
+                }
+
+                searched[t] = plans.size();
+            });
+        }
+
+        for (auto& worker : workers)
+        {
+            worker.join();
+        }
+
+        std::vector<PhasingPlan> plans;
+        std::vector<PhasingPlan> front;
+        searched_plans = 0;
+        propagated_plans = 0;
+
+        for (unsigned t = 0; t < thread_count; t++)
+        {
+            plans.insert(plans.end(), found[t].begin(), found[t].end());
+            searched_plans += searched[t];
+            propagated_plans += propagated[t];
+        }
+
+        /* Propagation moves arrivals slightly, so the merged plans are sorted again. */
+        std::sort(plans.begin(), plans.end(), by_arrival);
+
+        for (auto& plan : plans)
+        {
+            if (front.empty() || plan.delta_v < front.back().delta_v - delta_v_resolution)
+            {
+                front.push_back(plan);
+            }
+        }
+
+        return front;
+    }
+
+    /* Cheapest plan arriving by latest_arrival, or the fastest one if none does. */
+    PhasingPlan PhasingPlanner::cheapest(std::vector<PhasingPlan>& front, double latest_arrival)
+    {
+        auto best = front.front();
+
+        for (auto& plan : front)
+        {
+            if (plan.arrival_time <= latest_arrival && plan.delta_v < best.delta_v)
+            {
+                best = plan;
+            }
+        }
+
+        return best;
+    }
+
+    bool PhasingPlanner::by_arrival(const PhasingPlan& a, const PhasingPlan& b)
+    {
+        return a.arrival_time != b.arrival_time ? a.arrival_time < b.arrival_time : a.delta_v < b.delta_v;
+    }
+
+    /**
+     * Angles are measured in the chaser's plane from its position at start, treating both orbits
+     * as circles at their semi-major axes. The target is met half a revolution after the transfer
+     * burn, so revolutions of period P must satisfy
+     *     phase + n2 * (d + k * P + T) = n1 * d + pi + 2 * pi * m
+     * for departure d, transfer time T and any whole m. Without phasing, this fixes d. With
+     * phasing, d is sampled and each m within the apsis bounds gives a period.
+     */
+    void PhasingPlanner::plan(double start, PhasingOrbit phasing_orbit, int revolutions, std::vector<PhasingPlan>& plans)
+    {
+        auto mu = m_chaser.gravitational_parameter();
+        auto chaser_radius = m_chaser.semi_major_axis();
+        auto target_radius = m_target.semi_major_axis();
+        auto chaser_motion = m_chaser.mean_motion();
+        auto target_motion = m_target.mean_motion();
+        auto chaser_position = m_chaser.position_at(start);
+        auto target_position = m_target.position_at(start);
+        auto phase = atan2(m_chaser.normal().dot(chaser_position.cross(target_position)), chaser_position.dot(target_position));
+
+        auto vis_viva = [mu](double radius, double semi_major_axis) { return sqrt(mu * (2 / radius - 1 / semi_major_axis)); };
+        auto period = [mu](double semi_major_axis) { return 2 * M_PI * sqrt(pow(semi_major_axis, 3) / mu); };
+
+        auto transfer_axis = (chaser_radius + target_radius) / 2;
+        auto transfer_duration = period(transfer_axis) / 2;
+        auto chaser_speed = vis_viva(chaser_radius, chaser_radius);
+        auto target_speed = vis_viva(target_radius, target_radius);
+        auto departure_speed = vis_viva(chaser_radius, transfer_axis);
+        auto arrival_speed = vis_viva(target_radius, transfer_axis);
+
+        PhasingPlan plan;
+        plan.phasing_orbit = phasing_orbit;
+        plan.revolutions = revolutions;
+
+        if (revolutions == 0)
+        {
+            auto rate = chaser_motion - target_motion;
+
+            /* Co-orbital: the phase never changes, so there is no window. */
+            if (abs(rate) < 1e-12)
+            {
+                return;
+            }
+
+            auto departure = (phase + target_motion * transfer_duration - M_PI) / rate;
+            auto spacing = 2 * M_PI / abs(rate);
+
+            departure += ceil((lead_time - departure) / spacing) * spacing;
+
+            plan.phasing_radius = chaser_radius;
+            plan.phasing_time = start + departure;
+            plan.phasing_delta_v = 0;
+            plan.transfer_time = start + departure;
+            plan.transfer_delta_v = departure_speed - chaser_speed;
+            plan.arrival_delta_v = target_speed - arrival_speed;
+            plan.delta_v = abs(plan.transfer_delta_v) + abs(plan.arrival_delta_v);
+            plan.arrival_time = plan.transfer_time + transfer_duration;
+
+            if (plan.arrival_time - start <= horizon)
+            {
+                plans.push_back(plan);
+            }
+
+            return;
+        }
+
+        auto before = phasing_orbit == PHASE_BEFORE_TRANSFER;
+        auto apsis_radius = before ? chaser_radius : target_radius;
+        auto speed_in = before ? chaser_speed : arrival_speed;
+        auto speed_out = before ? departure_speed : target_speed;
+        auto shortest = revolutions * period((apsis_radius + std::max(min_radius, 1.0)) / 2);
+        auto longest = std::min(revolutions * period((apsis_radius + max_radius) / 2), horizon);
+        auto target_period = 2 * M_PI / target_motion;
+
+        for (int sample = 0; sample < departure_samples; sample++)
+        {
+            auto departure = lead_time + sample * 2 * M_PI / chaser_motion / departure_samples;
+
+            /* Phasing time for m = 0; each further m adds one target period. */
+            auto base = (chaser_motion * departure + M_PI - phase) / target_motion - departure - transfer_duration;
+            auto lowest = static_cast<long>(ceil((shortest - base) / target_period));
+            auto highest = static_cast<long>(floor((longest - base) / target_period));
+
+            for (auto m = lowest; m <= highest; m++)
+            {
+                auto phasing_period = (base + m * target_period) / revolutions;
+                auto phasing_axis = cbrt(mu * pow(phasing_period / (2 * M_PI), 2));
+                auto phasing_radius = 2 * phasing_axis - apsis_radius;
+                auto phasing_speed = vis_viva(apsis_radius, phasing_axis);
+
+                if (phasing_radius < min_radius || phasing_radius > max_radius)
+                {
+                    continue;
+                }
+
+                plan.phasing_radius = phasing_radius;
+
+                if (before)
+                {
+                    plan.phasing_time = start + departure;
+                    plan.transfer_time = plan.phasing_time + revolutions * phasing_period;
+                    plan.phasing_delta_v = phasing_speed - speed_in;
+                    plan.transfer_delta_v = speed_out - phasing_speed;
+                    plan.arrival_delta_v = target_speed - arrival_speed;
+                }
+                else
+                {
+                    plan.transfer_time = start + departure;
+                    plan.phasing_time = plan.transfer_time + transfer_duration;
+                    plan.transfer_delta_v = departure_speed - chaser_speed;
+                    plan.phasing_delta_v = phasing_speed - speed_in;
+                    plan.arrival_delta_v = speed_out - phasing_speed;
+                }
+
+                plan.delta_v = abs(plan.phasing_delta_v) + abs(plan.transfer_delta_v) + abs(plan.arrival_delta_v);
+                plan.arrival_time = start + departure + revolutions * phasing_period + transfer_duration;
+
+                if (plan.arrival_time - start <= horizon)
+                {
+                    plans.push_back(plan);
+                }
+            }
+        }
+    }
+
+    /**
+     * Flies the plan on the real orbits with prograde burns, as the vessel would: the second burn
+     * is timed from the orbit the first one actually produced. Updates the burn times, arrival and
+     * miss distance, and returns whether the target is met.
+     */
+    bool PhasingPlanner::propagate(PhasingPlan& plan)
+    {
+        auto mu = m_chaser.gravitational_parameter();
+        auto orbit = m_chaser;
+        Vector3 position, velocity;
+
+        auto burn = [&](double time, double delta_v) {
+            orbit.state_at(time, position, velocity);
+            orbit = KeplerOrbit::from_state(position, velocity + velocity.normalize() * delta_v, mu, time);
+        };
+
+        if (plan.revolutions == 0)
+        {
+            burn(plan.transfer_time, plan.transfer_delta_v);
+        }
+        else if (plan.phasing_orbit == PHASE_BEFORE_TRANSFER)
+        {
+            burn(plan.phasing_time, plan.phasing_delta_v);
+            plan.transfer_time = plan.phasing_time + plan.revolutions * orbit.period();
+            burn(plan.transfer_time, plan.transfer_delta_v);
+        }
+        else
+        {
+            burn(plan.transfer_time, plan.transfer_delta_v);
+            plan.phasing_time = plan.transfer_time + orbit.period() / 2;
+            burn(plan.phasing_time, plan.phasing_delta_v);
+        }
+
+        /* The approach nearest the planned arrival, within a tenth of a target revolution. */
+        auto window = m_target.period() / 10;
+        auto approach = ClosestApproachFinder(orbit, m_target).minimum(plan.arrival_time - window, plan.arrival_time + window);
+
+        plan.arrival_time = approach.time;
+        plan.miss_distance = approach.distance;
+
+        return plan.miss_distance <= max_miss_distance;
+    }
+}
@@ -1,10 +1,49 @@
 #pragma once
 
 #include <math.h>
+#include <array>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
 #include "timer.hpp"
 
 namespace KSP
 {
+    struct PIDGains
+    {
+        double kP;
+        double kI;
+        double kD;
+    };
+
+    enum AntiWindup
+    {
+        /* Only the I_bound clamp on the integral term. */
+        ANTI_WINDUP_NONE,
+        /* Stop integrating while the output is saturated in the direction of the error. */
+        ANTI_WINDUP_CLAMPING,
+        /* Bleed the integral by the saturation excess, at tracking_gain per second. */
+        ANTI_WINDUP_BACK_CALCULATION
+    };
+
+    /**
+     * PID gains interpolated over N scheduling variables, e.g. mass, altitude or dynamic pressure.
+     * Breakpoints per variable must be ascending. Gains are given row-major over the grid, with
+     * the last variable changing fastest. Points outside the grid are clamped to its edges.
+     */
+    template <size_t N>
+    class GainSchedule
+    {
+    private:
+        std::array<std::vector<double>, N> m_breakpoints;
+        std::vector<PIDGains> m_gains;
+    public:
+        GainSchedule(std::array<std::vector<double>, N> breakpoints, std::vector<PIDGains> gains);
+        ~GainSchedule();
+    public:
+        PIDGains gains(std::array<double, N> point);
+    };
+
     class PID
     {
     public:
@@ -14,67 +53,204 @@ namespace KSP
         double kI;
         double kD;
         double last_error;
-        double total_error;
+        double last_derivative;
+        double integral;
         double previous_value;
+        double last_step_time;
+        double output_min = -INFINITY;
+        double output_max = INFINITY;
         Timer timer;
+    public:
+        AntiWindup anti_windup = ANTI_WINDUP_BACK_CALCULATION;
+        /* Back-calculation gain in 1/s; 0 picks 1 / sqrt(Ti * Td), or 1 / Ti without derivative action. */
+        double tracking_gain = 0.0;
+        /* Time constant of the first-order filter on the derivative term in seconds; 0 disables it. */
+        double derivative_filter = 0.0;
     public:
         void start();
         double step(double target, double current, double I_bound = 1.0);
+        double step(double time, double target, double current, double I_bound);
+        void set_gains(PIDGains gains);
+        void set_output_limits(double minimum, double maximum);
+        double output();
         void reset_error();
     };
 
-    PID::PID(Connection connection, double kP, double kI, double kD) : kP(kP), kI(kI), kD(kD), timer(Timer(connection))
+    template <size_t N>
+    GainSchedule<N>::GainSchedule(std::array<std::vector<double>, N> breakpoints, std::vector<PIDGains> gains)
+        : m_breakpoints(breakpoints), m_gains(gains)
     {
+        size_t size = 1;
+
+        for (auto& axis : m_breakpoints)
+        {
+            if (axis.empty() || !std::is_sorted(axis.begin(), axis.end()))
+            {
+                throw std::invalid_argument("GainSchedule: breakpoints must be non-empty and ascending");
+            }
+
+            size *= axis.size();
+        }
+
+        if (m_gains.size() != size)
+        {
+            throw std::invalid_argument("GainSchedule: need one gain set per grid point");
+        }
+    }
+
+    template <size_t N>
+    GainSchedule<N>::~GainSchedule()
+    {
+    }
+
+    /* Multilinear interpolation between the 2^N surrounding grid points. Does not allocate. */
+    template <size_t N>
+    PIDGains GainSchedule<N>::gains(std::array<double, N> point)
+    {
+        std::array<size_t, N> index;
+        std::array<double, N> fraction;
+        PIDGains result = {0.0, 0.0, 0.0};
+
+        for (size_t axis = 0; axis < N; axis++)
+        {
+            auto& breakpoints = m_breakpoints[axis];
+            auto upper = std::upper_bound(breakpoints.begin(), breakpoints.end(), point[axis]) - breakpoints.begin();
+            auto i = std::max<long>(0, std::min<long>(upper - 1, breakpoints.size() - 2));
+
+            index[axis] = i;
+            fraction[axis] = breakpoints.size() < 2 ? 0.0
+                : std::max(0.0, std::min(1.0, (point[axis] - breakpoints[i]) / (breakpoints[i + 1] - breakpoints[i])));
+        }
+
+        for (size_t corner = 0; corner < (size_t(1) << N); corner++)
+        {
+            auto weight = 1.0;
+            size_t flat = 0;
+
+            for (size_t axis = 0; axis < N; axis++)
+            {
+                auto high = (corner >> axis) & 1;
+                auto size = m_breakpoints[axis].size();
+
+                weight *= high ? fraction[axis] : 1 - fraction[axis];
+                flat = flat * size + std::min(index[axis] + high, size - 1);
+            }
 
+            if (weight > 0.0)
+            {
+                result.kP += weight * m_gains[flat].kP;
+                result.kI += weight * m_gains[flat].kI;
+                result.kD += weight * m_gains[flat].kD;
+            }
+        }
+
+        return result;
+    }
+
+    PID::PID(Connection connection, double kP, double kI, double kD) : kP(kP), kI(kI), kD(kD), timer(Timer(connection))
+    {
+        reset_error();
     }
 
     void PID::start()
     {
-        timer.set_current_time_to_ut();
+        timer.reset();
         reset_error();
     }
 
+    /* Steps on the game's universal time. */
     double PID::step(double target, double current, double I_bound)
     {
-        double P = target - current;
-        double I = 0.0;
-        double D = 0.0;
-        double dt = timer.current_time - timer.last_time;
-        double result;
-
         timer.set_current_time_to_ut();
 
-        if (std::abs(P) < 0.002)
+        return step(timer.current_time, target, current, I_bound);
+    }
+
+    /**
+     * Steps at the given time in seconds. The integral is kept in output units, so gain changes
+     * from a schedule do not bump the output.
+     */
+    double PID::step(double time, double target, double current, double I_bound)
+    {
+        auto error = target - current;
+        auto dt = time - last_step_time;
+        auto first = std::isnan(last_step_time);
+        auto derivative = 0.0;
+
+        /* Same physics frame as the last step, e.g. a 10 ms loop on a 20 ms frame: nothing new to act on. */
+        if (!first && dt <= 0.0)
         {
             return previous_value;
         }
 
-        if (timer.last_time > 0)
+        if (!first)
         {
-            I = total_error + ((P + last_error) / 2 * (dt));
-            D = (P - last_error) / (dt);
+            auto raw_derivative = (error - last_error) / dt;
+
+            derivative = derivative_filter > 0.0
+                ? last_derivative + dt / (derivative_filter + dt) * (raw_derivative - last_derivative)
+                : raw_derivative;
         }
 
-        if (kI > 0)
+        auto unsaturated = kP * error + integral + kD * derivative;
+        auto result = std::max(output_min, std::min(output_max, unsaturated));
+
+        if (!first)
         {
-            I = std::min(I_bound / kI, std::max(-I_bound/ kI, I));
-        }
+            auto increment = kI * (error + last_error) / 2 * dt;
+
+            if (anti_windup == ANTI_WINDUP_CLAMPING && result != unsaturated && (unsaturated - result) * increment > 0)
+            {
+                increment = 0.0;
+            }
+            else if (anti_windup == ANTI_WINDUP_BACK_CALCULATION)
+            {
+                auto gain = tracking_gain;
 
-        last_error = P;
-        total_error = I;
+                if (gain <= 0.0 && kI > 0.0 && kP > 0.0)
+                {
+                    gain = kD > 0.0 ? 1 / sqrt((kP / kI) * (kD / kP)) : kI / kP;
+                }
 
-        std::cout << "P: " << P * kP << "   I: " << I * kI << "   D: " << D * kD << std::endl;
+                increment += gain * (result - unsaturated) * dt;
+            }
 
-        std::cout << "I: " << I << std::endl;
+            integral = std::min(I_bound, std::max(-I_bound, integral + increment));
+        }
 
-        result = P * kP + I * kI + D * kD;
+        last_error = error;
+        last_derivative = derivative;
+        last_step_time = time;
         previous_value = result;
 
         return result;
     }
 
+    void PID::set_gains(PIDGains gains)
+    {
+        kP = gains.kP;
+        kI = gains.kI;
+        kD = gains.kD;
+    }
+
+    /* Output saturation, used by the anti-windup. */
+    void PID::set_output_limits(double minimum, double maximum)
+    {
+        output_min = minimum;
+        output_max = maximum;
+    }
+
+    double PID::output()
+    {
+        return previous_value;
+    }
+
     void PID::reset_error()
     {
-        total_error = 0.0;
+        integral = 0.0;
+        last_error = 0.0;
+        last_derivative = 0.0;
+        previous_value = 0.0;
+        last_step_time = NAN;
     }
 }
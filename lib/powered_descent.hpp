@@ -0,0 +1,292 @@
+#pragma once
+
+#include <math.h>
+#include <algorithm>
+#include "vector3.hpp"
+#include "constants.hpp"
+#include "loop_statistics.hpp"
+
+namespace KSP
+{
+    /* Output of one guidance solve. */
+    struct DescentCommand
+    {
+        bool engaged;
+        bool feasible;
+        double throttle;
+        Vector3 direction;
+        double time_to_go;
+        double delta_v;
+    };
+
+    /**
+     * Powered-descent guidance using the ZEM/ZEV (zero-effort miss/velocity) polynomial law.
+     *
+     * For a fixed time-to-go the commanded acceleration varies linearly in time and drives
+     * position and velocity to the target exactly. The time-to-go is re-optimised every solve
+     * to minimise delta-v, subject to the thrust limit along the whole burn using the mass
+     * predicted by the rocket equation. Drag is treated as a constant extra acceleration.
+     *
+     * All vectors are in one frame that is fixed to the target point, e.g. the surface frame.
+     */
+    class PoweredDescentGuidance
+    {
+    private:
+        bool m_engaged;
+        double m_time_to_go;
+        LoopStatistics m_statistics;
+    public:
+        /* Throttle the solution may use, and the throttle at which the burn starts. */
+        double max_throttle = 0.9;
+        double ignition_throttle = 0.8;
+        /* Search bounds and refinement steps for time-to-go. */
+        double min_time_to_go = 0.5;
+        int scan_steps = 24;
+        int refine_steps = 24;
+    public:
+        PoweredDescentGuidance();
+        ~PoweredDescentGuidance();
+    public:
+        DescentCommand solve(
+            Vector3 position,
+            Vector3 velocity,
+            Vector3 target_velocity,
+            Vector3 gravity,
+            double mass,
+            double max_thrust,
+            double isp,
+            Vector3 drag = Vector3()
+        );
+        void reset();
+        bool engaged();
+        LoopStatistics statistics();
+    private:
+        double evaluate(
+            double time_to_go,
+            Vector3 position,
+            Vector3 velocity,
+            Vector3 target_velocity,
+            Vector3 acceleration,
+            double mass,
+            double isp,
+            Vector3& initial_acceleration,
+            double& peak_thrust
+        );
+    };
+
+    PoweredDescentGuidance::PoweredDescentGuidance() : m_engaged(false), m_time_to_go(0.0)
+    {
+    }
+
+    PoweredDescentGuidance::~PoweredDescentGuidance()
+    {
+    }
+
+    void PoweredDescentGuidance::reset()
+    {
+        m_engaged = false;
+        m_time_to_go = 0.0;
+        m_statistics.reset();
+    }
+
+    bool PoweredDescentGuidance::engaged()
+    {
+        return m_engaged;
+    }
+
+    /* Wall-clock solve times. */
+    LoopStatistics PoweredDescentGuidance::statistics()
+    {
+        return m_statistics;
+    }
+
+    DescentCommand PoweredDescentGuidance::solve(
+        Vector3 position,
+        Vector3 velocity,
+        Vector3 target_velocity,
+        Vector3 gravity,
+        double mass,
+        double max_thrust,
+        double isp,
+        Vector3 drag
+    ) {
+        LoopClock clock;
+        DescentCommand command = {m_engaged, false, 0.0, (gravity * -1).normalize(), 0.0, 0.0};
+
+        if (max_thrust <= 0.0 || mass <= 0.0)
+        {
+            m_statistics.add(clock.elapsed());
+            return command;
+        }
+
+        auto acceleration = gravity + drag / mass;
+        auto max_acceleration = max_thrust * max_throttle / mass;
+        auto free_acceleration = std::max(0.1, max_acceleration - acceleration.length());
+
+        /* Upper bound: time to kill the current speed plus a free fall from this height. */
+        auto upper = 2 * (velocity.length() + sqrt(2 * acceleration.length() * position.length())) / free_acceleration + 10.0;
+        auto lower = min_time_to_go;
+
+        /* Once burning, only search around the previous solution. */
+        if (m_engaged && m_time_to_go > lower)
+        {
+            upper = std::min(upper, m_time_to_go * 1.5 + 1.0);
+        }
+
+        /* Coarse scan for the cheapest feasible time-to-go, remembering the least infeasible one. */
+        auto thrust_limit = max_thrust * max_throttle;
+        auto best_time = upper;
+        auto best_cost = INFINITY;
+        auto fallback_time = upper;
+        auto fallback_thrust = INFINITY;
+        auto step = (upper - lower) / scan_steps;
+        Vector3 initial_acceleration;
+        double peak_thrust;
+
+        for (int i = 0; i <= scan_steps; i++)
+        {
+            auto t = lower + step * i;
+            auto cost = evaluate(t, position, velocity, target_velocity, acceleration, mass, isp, initial_acceleration, peak_thrust);
+
+            if (peak_thrust <= thrust_limit && cost < best_cost)
+            {
+                best_cost = cost;
+                best_time = t;
+            }
+
+            if (peak_thrust < fallback_thrust)
+            {
+                fallback_thrust = peak_thrust;
+                fallback_time = t;
+            }
+        }
+
+        /* Golden-section refinement inside the best bracket; infeasible points cost infinity. */
+        auto a = std::max(lower, best_time - step);
+        auto b = std::min(upper, best_time + step);
+        const double ratio = (sqrt(5.0) - 1) / 2;
+
+        for (int i = 0; i < refine_steps && std::isfinite(best_cost); i++)
+        {
+            auto c = b - ratio * (b - a);
+            auto d = a + ratio * (b - a);
+            auto cost_c = evaluate(c, position, velocity, target_velocity, acceleration, mass, isp, initial_acceleration, peak_thrust);
+            cost_c = peak_thrust <= thrust_limit ? cost_c : INFINITY;
+            auto cost_d = evaluate(d, position, velocity, target_velocity, acceleration, mass, isp, initial_acceleration, peak_thrust);
+            cost_d = peak_thrust <= thrust_limit ? cost_d : INFINITY;
+
+            if (cost_c < cost_d)
+            {
+                b = d;
+            }
+            else
+            {
+                a = c;
+            }
+        }
+
+        if (std::isfinite(best_cost))
+        {
+            auto refined = (a + b) / 2;
+            auto refined_cost = evaluate(refined, position, velocity, target_velocity, acceleration, mass, isp, initial_acceleration, peak_thrust);
+
+            if (peak_thrust <= thrust_limit && refined_cost <= best_cost)
+            {
+                best_time = refined;
+                best_cost = refined_cost;
+            }
+        }
+
+        /* Infeasible everywhere: fly the profile that needs the least thrust, saturated. */
+        command.feasible = std::isfinite(best_cost);
+        best_time = command.feasible ? best_time : (std::isfinite(fallback_thrust) ? fallback_time : lower);
+        command.delta_v = evaluate(best_time, position, velocity, target_velocity, acceleration, mass, isp, initial_acceleration, peak_thrust);
+        command.time_to_go = best_time;
+        command.throttle = std::min(max_throttle, initial_acceleration.length() * mass / max_thrust);
+        command.direction = initial_acceleration.length() > 1e-9 ? initial_acceleration.normalize() : (gravity * -1).normalize();
+
+        /* Coast until the optimal profile needs the ignition throttle, like a hoverslam. */
+        if (!m_engaged && (command.throttle >= ignition_throttle || !command.feasible))
+        {
+            m_engaged = true;
+        }
+
+        command.engaged = m_engaged;
+
+        if (!m_engaged)
+        {
+            command.throttle = 0.0;
+        }
+
+        m_time_to_go = best_time;
+        m_statistics.add(clock.elapsed());
+
+        return command;
+    }
+
+    /* Delta-v of the ZEM/ZEV profile for this time-to-go, and the peak thrust it needs (infinite if it goes underground). */
+    double PoweredDescentGuidance::evaluate(
+        double t,
+        Vector3 position,
+        Vector3 velocity,
+        Vector3 target_velocity,
+        Vector3 acceleration,
+        double mass,
+        double isp,
+        Vector3& initial_acceleration,
+        double& peak_thrust
+    ) {
+        auto zem = (position + velocity * t + acceleration * (t * t / 2)) * -1;
+        auto zev = target_velocity - (velocity + acceleration * t);
+        auto a0 = zem * (6 / (t * t)) - zev * (2 / t);
+        auto a1 = zem * (-12 / (t * t * t)) + zev * (6 / (t * t));
+
+        /*
+         * Simpson's rule over the burn for the delta-v. The same samples check the profile stays
+         * above the target and find the peak thrust: the mass falls along the burn, so the peak of
+         * |a| * m need not be at either end.
+         */
+        const int intervals = 8;
+        auto h = t / intervals;
+        auto delta_v = 0.0;
+        auto burned = 0.0;
+        auto up = (acceleration * -1).normalize();
+        auto clearance = 0.0;
+        auto exhaust_velocity = STANDARD_GRAVITY * isp;
+        auto previous = a0.length();
+
+        peak_thrust = previous * mass;
+
+        for (int i = 0; i <= intervals; i++)
+        {
+            auto tau = h * i;
+            auto weight = (i == 0 || i == intervals) ? 1.0 : (i % 2 == 1 ? 4.0 : 2.0);
+            auto sample = position + velocity * tau + (acceleration + a0) * (tau * tau / 2) + a1 * (tau * tau * tau / 6);
+            auto magnitude = (a0 + a1 * tau).length();
+
+            /* Trapezoidal delta-v so far, for the mass at this sample. */
+            burned += i > 0 ? (previous + magnitude) * h / 2 : 0.0;
+            previous = magnitude;
+
+            /* The mass only falls, so the exponential is only needed where the peak could rise. */
+            if (magnitude * mass > peak_thrust)
+            {
+                peak_thrust = std::max(peak_thrust, magnitude * mass / exp(burned / exhaust_velocity));
+            }
+
+            delta_v += weight * magnitude;
+            clearance = std::min(clearance, sample.dot(up));
+        }
+
+        delta_v *= h / 3;
+        initial_acceleration = a0;
+
+        /* Profiles that pass below the target are never flown. */
+        if (clearance < -1.0)
+        {
+            peak_thrust = INFINITY;
+        }
+
+        return delta_v;
+    }
+}
@@ -0,0 +1,162 @@
+#pragma once
+
+#include <tuple>
+#include <math.h>
+#include <sstream>
+#include "vector3.hpp"
+
+namespace KSP
+{
+    /* Rotation quaternion in kRPC's (x, y, z, w) layout. */
+    class Quaternion
+    {
+    public:
+        double m_x;
+        double m_y;
+        double m_z;
+        double m_w;
+    public:
+        Quaternion();
+        Quaternion(double x, double y, double z, double w);
+        Quaternion(std::tuple<double, double, double, double> tuple);
+        ~Quaternion();
+    public:
+        static Quaternion from_axis_angle(Vector3 axis, double angle);
+        static Quaternion from_to(Vector3 from, Vector3 to);
+    public:
+        std::tuple<double, double, double, double> to_tuple();
+        Quaternion normalize();
+        Quaternion conjugate();
+        double length();
+        double angle();
+        Vector3 axis();
+        Vector3 rotation_vector();
+        Vector3 rotate(Vector3 vector);
+    public:
+        friend Quaternion operator*(const Quaternion& left, const Quaternion& right);
+        friend std::ostream& operator<<(std::ostream& out, const Quaternion& q);
+    };
+
+    Quaternion::Quaternion() : m_x(0), m_y(0), m_z(0), m_w(1)
+    {
+    }
+
+    Quaternion::Quaternion(double x, double y, double z, double w) : m_x(x), m_y(y), m_z(z), m_w(w)
+    {
+    }
+
+    Quaternion::Quaternion(std::tuple<double, double, double, double> tuple)
+        : m_x(std::get<0>(tuple)), m_y(std::get<1>(tuple)), m_z(std::get<2>(tuple)), m_w(std::get<3>(tuple))
+    {
+    }
+
+    Quaternion::~Quaternion()
+    {
+    }
+
+    Quaternion Quaternion::from_axis_angle(Vector3 axis, double angle)
+    {
+        auto unit_axis = axis.normalize() * sin(angle / 2);
+
+        return Quaternion(unit_axis.m_x, unit_axis.m_y, unit_axis.m_z, cos(angle / 2));
+    }
+
+    /* Shortest-arc rotation that takes direction 'from' onto direction 'to'. */
+    Quaternion Quaternion::from_to(Vector3 from, Vector3 to)
+    {
+        auto a = from.normalize();
+        auto b = to.normalize();
+        auto cos_angle = a.dot(b);
+
+        /* Opposite directions: rotate half a turn around any perpendicular axis. */
+        if (cos_angle < -0.999999)
+        {
+            auto axis = Vector3(1, 0, 0).cross(a);
+
+            if (axis.length() < 1e-6)
+            {
+                axis = Vector3(0, 1, 0).cross(a);
+            }
+
+            return from_axis_angle(axis, M_PI);
+        }
+
+        auto axis = a.cross(b);
+
+        return Quaternion(axis.m_x, axis.m_y, axis.m_z, 1 + cos_angle).normalize();
+    }
+
+    std::tuple<double, double, double, double> Quaternion::to_tuple()
+    {
+        return std::make_tuple(m_x, m_y, m_z, m_w);
+    }
+
+    Quaternion Quaternion::normalize()
+    {
+        auto l = length();
+
+        return Quaternion(m_x / l, m_y / l, m_z / l, m_w / l);
+    }
+
+    Quaternion Quaternion::conjugate()
+    {
+        return Quaternion(-m_x, -m_y, -m_z, m_w);
+    }
+
+    double Quaternion::length()
+    {
+        return sqrt(m_x * m_x + m_y * m_y + m_z * m_z + m_w * m_w);
+    }
+
+    double Quaternion::angle()
+    {
+        return 2 * atan2(Vector3(m_x, m_y, m_z).length(), m_w);
+    }
+
+    Vector3 Quaternion::axis()
+    {
+        auto v = Vector3(m_x, m_y, m_z);
+        auto l = v.length();
+
+        return l < 1e-12 ? Vector3(0, 0, 0) : v / l;
+    }
+
+    /* Axis scaled by angle, wrapped so the angle lies in [-pi, pi]. */
+    Vector3 Quaternion::rotation_vector()
+    {
+        auto a = angle();
+
+        if (a > M_PI)
+        {
+            a -= 2 * M_PI;
+        }
+
+        return axis() * a;
+    }
+
+    /* Source: https://en.wikipedia.org/wiki/Quaternions_and_spatial_rotation */
+    Vector3 Quaternion::rotate(Vector3 vector)
+    {
+        auto q = Vector3(m_x, m_y, m_z);
+        auto t = q.cross(vector) * 2;
+
+        return vector + t * m_w + q.cross(t);
+    }
+
+    Quaternion operator*(const Quaternion& l, const Quaternion& r)
+    {
+        return Quaternion(
+            l.m_w * r.m_x + l.m_x * r.m_w + l.m_y * r.m_z - l.m_z * r.m_y,
+            l.m_w * r.m_y - l.m_x * r.m_z + l.m_y * r.m_w + l.m_z * r.m_x,
+            l.m_w * r.m_z + l.m_x * r.m_y - l.m_y * r.m_x + l.m_z * r.m_w,
+            l.m_w * r.m_w - l.m_x * r.m_x - l.m_y * r.m_y - l.m_z * r.m_z
+        );
+    }
+
+    std::ostream& operator<<(std::ostream& out, const Quaternion& q)
+    {
+        out << "[" << q.m_x << ", " << q.m_y << ", " << q.m_z << ", " << q.m_w << "]";
+
+        return out;
+    }
+}
@@ -0,0 +1,321 @@
+#pragma once
+
+#include <math.h>
+#include <algorithm>
+#include "vector3.hpp"
+
+namespace KSP
+{
+    struct ReentryImpact
+    {
+        /* False if the trajectory stays above the atmosphere or is still flying after max_time. */
+        bool impact;
+        double time;
+        /* Degrees, as kRPC gives them. */
+        double latitude;
+        double longitude;
+        /* In the body's reference frame. */
+        Vector3 position;
+        double surface_speed;
+        double max_deceleration;
+        int steps;
+    };
+
+    /**
+     * Impact point prediction for a capsule falling through the atmosphere of a rotating body,
+     * integrated with the adaptive Dormand-Prince 5(4) method under point-mass gravity and drag in
+     * an exponential atmosphere. Defaults are for Kerbin, as in AscentSimulator. The state is in
+     * the body's reference frame, so the air is at rest and the rotation adds the Coriolis and
+     * centrifugal terms: x to 0 degrees longitude, y to the north pole and z to 90 degrees east.
+     * A prediction from orbit takes a few dozen steps, tens of microseconds, so it can be re-run
+     * at 10 Hz during the deorbit burn and the descent, with drag_area calibrated from the
+     * measured drag as it goes.
+     */
+    class ReentryPredictor
+    {
+    private:
+        double m_density_scale = 1.0;
+    public:
+        double gravitational_parameter = 3.5316e12;
+        double body_radius = 600000.0;
+        double rotational_speed = 2 * M_PI / 21549.425;
+        double atmosphere_depth = 70000.0;
+        double sea_level_density = 1.225;
+        double scale_height = 5600.0;
+        /* Of the capsule that falls, e.g. without the service module. Drag area is Cd * A, in m^2. */
+        double mass;
+        double drag_area;
+        /* Altitude of the ground at the landing site. */
+        double impact_altitude = 0.0;
+        /* Position error per step, in m. */
+        double tolerance = 1.0;
+        double max_step = 30.0;
+        double max_time = 3600.0;
+        /* Predictions made since construction. */
+        size_t predictions = 0;
+    public:
+        ReentryPredictor(double mass, double drag_area);
+        ~ReentryPredictor();
+    public:
+        ReentryImpact predict(Vector3 position, Vector3 velocity, double ut);
+        void calibrate(double altitude, double density, double drag, double air_speed);
+        Vector3 deorbit_velocity(Vector3 position, Vector3 velocity, double periapsis_altitude);
+        Vector3 surface_position(double latitude, double longitude);
+        static double angle_ahead(Vector3 position, Vector3 velocity, Vector3 point);
+    private:
+        double density(double altitude);
+        Vector3 acceleration(Vector3 position, Vector3 velocity);
+        Vector3 rotation();
+        double periapsis(Vector3 position, Vector3 velocity);
+    };
+
+    ReentryPredictor::ReentryPredictor(double mass, double drag_area) : mass(mass), drag_area(drag_area)
+    {
+    }
+
+    ReentryPredictor::~ReentryPredictor()
+    {
+    }
+
+    /**
+     * Impact of the state in the body's reference frame, with velocity relative to the surface,
+     * on the ground at impact_altitude. The crossing is found on the cubic Hermite interpolant of
+     * the last step, so steps need not shrink near the ground.
+     */
+    ReentryImpact ReentryPredictor::predict(Vector3 position, Vector3 velocity, double ut)
+    {
+        /* Dormand-Prince stages, the last being the fifth order solution, and the difference to the fourth. */
+        static const double a[7][6] = {
+            {},
+            {1.0 / 5},
+            {3.0 / 40, 9.0 / 40},
+            {44.0 / 45, -56.0 / 15, 32.0 / 9},
+            {19372.0 / 6561, -25360.0 / 2187, 64448.0 / 6561, -212.0 / 729},
+            {9017.0 / 3168, -355.0 / 33, 46732.0 / 5247, 49.0 / 176, -5103.0 / 18656},
+            {35.0 / 384, 0, 500.0 / 1113, 125.0 / 192, -2187.0 / 6784, 11.0 / 84},
+        };
+        static const double error_weights[7] = {71.0 / 57600, 0, -71.0 / 16695, 71.0 / 1920, -17253.0 / 339200, 22.0 / 525, -1.0 / 40};
+
+        ReentryImpact result = {false, ut, 0.0, 0.0, position, 0.0, 0.0, 0};
+        auto ground = body_radius + impact_altitude;
+        auto step = std::min(1.0, max_step);
+        auto time = 0.0;
+
+        predictions++;
+
+        /* Nothing to integrate if the orbit never reaches the atmosphere. */
+        if (periapsis(position, velocity) > body_radius + atmosphere_depth)
+        {
+            return result;
+        }
+
+        Vector3 rates[7], accelerations[7];
+
+        rates[0] = velocity;
+        accelerations[0] = acceleration(position, velocity);
+
+        while (time < max_time)
+        {
+            step = std::min(step, max_time - time);
+
+            for (int i = 1; i < 7; i++)
+            {
+                auto stage_position = position;
+                auto stage_velocity = velocity;
+
+                for (int j = 0; j < i; j++)
+                {
+                    stage_position = stage_position + rates[j] * (step * a[i][j]);
+                    stage_velocity = stage_velocity + accelerations[j] * (step * a[i][j]);
+                }
+
+                rates[i] = stage_velocity;
+                accelerations[i] = acceleration(stage_position, stage_velocity);
+            }
+
+            /* The last stage is the fifth order solution, so its derivative starts the next step. */
+            auto next_position = position;
+            auto next_velocity = velocity;
+            auto position_error = Vector3(0, 0, 0);
+            auto velocity_error = Vector3(0, 0, 0);
+
+            for (int j = 0; j < 6; j++)
+            {
+                next_position = next_position + rates[j] * (step * a[6][j]);
+                next_velocity = next_velocity + accelerations[j] * (step * a[6][j]);
+            }
+
+            for (int j = 0; j < 7; j++)
+            {
+                position_error = position_error + rates[j] * (step * error_weights[j]);
+                velocity_error = velocity_error + accelerations[j] * (step * error_weights[j]);
+            }
+
+            auto error = std::max(position_error.length(), velocity_error.length() * step) / tolerance;
+            auto next_step = std::min(max_step, step * std::clamp(0.9 * pow(std::max(error, 1e-10), -0.2), 0.2, 5.0));
+
+            result.steps++;
+
+            if (error > 1)
+            {
+                step = next_step;
+                continue;
+            }
+
+            if (next_position.length() <= ground)
+            {
+                /* Bisects the Hermite interpolant for the crossing. */
+                auto low = 0.0;
+                auto high = 1.0;
+
+                auto interpolate = [&](double s) {
+                    return position * (2 * s * s * s - 3 * s * s + 1) + velocity * (step * (s * s * s - 2 * s * s + s))
+                         + next_position * (-2 * s * s * s + 3 * s * s) + next_velocity * (step * (s * s * s - s * s));
+                };
+
+                for (int i = 0; i < 40; i++)
+                {
+                    auto middle = (low + high) / 2;
+
+                    (interpolate(middle).length() > ground ? low : high) = middle;
+                }
+
+                auto s = high;
+                auto impact_velocity = (position * (6 * s * s - 6 * s) + velocity * (step * (3 * s * s - 4 * s + 1))
+                                     + next_position * (-6 * s * s + 6 * s) + next_velocity * (step * (3 * s * s - 2 * s))) / step;
+
+                result.impact = true;
+                result.time = ut + time + s * step;
+                result.position = interpolate(s);
+                result.latitude = asin(result.position.m_y / result.position.length()) * 180 / M_PI;
+                result.longitude = atan2(result.position.m_z, result.position.m_x) * 180 / M_PI;
+                result.surface_speed = impact_velocity.length();
+                return result;
+            }
+
+            auto air_speed = next_velocity.length();
+
+            result.max_deceleration = std::max(result.max_deceleration, 0.5 * density(next_position.length() - body_radius) * air_speed * air_speed * drag_area / mass);
+
+            position = next_position;
+            velocity = next_velocity;
+            rates[0] = rates[6];
+            accelerations[0] = accelerations[6];
+            time += step;
+            step = next_step;
+        }
+
+        result.time = ut + time;
+        result.position = position;
+        return result;
+    }
+
+    /**
+     * Fits the model to measurements during the descent: the density scale to the measured
+     * density, and drag_area to the measured drag force (N) at that density and air speed.
+     * Ignored while the dynamic pressure is too low for the drag to be measured reliably.
+     */
+    void ReentryPredictor::calibrate(double altitude, double density, double drag, double air_speed)
+    {
+        auto dynamic_pressure = 0.5 * density * air_speed * air_speed;
+
+        if (dynamic_pressure < 50.0 || altitude >= atmosphere_depth)
+        {
+            return;
+        }
+
+        m_density_scale = 1.0;
+        m_density_scale = density / this->density(altitude);
+        drag_area = drag / dynamic_pressure;
+    }
+
+    /**
+     * Velocity after an impulsive burn against the orbital (inertial) velocity that lowers the
+     * periapsis to periapsis_altitude, by bisecting the orbital speed. Unchanged if it is already
+     * that low.
+     */
+    Vector3 ReentryPredictor::deorbit_velocity(Vector3 position, Vector3 velocity, double periapsis_altitude)
+    {
+        auto orbital_velocity = velocity + rotation().cross(position);
+        auto direction = orbital_velocity.normalize();
+        auto target = body_radius + periapsis_altitude;
+        auto low = 0.0;
+        auto high = orbital_velocity.length();
+
+        if (periapsis(position, velocity) <= target)
+        {
+            return velocity;
+        }
+
+        for (int i = 0; i < 50; i++)
+        {
+            auto middle = (low + high) / 2;
+            auto burned = direction * middle - rotation().cross(position);
+
+            (periapsis(position, burned) > target ? high : low) = middle;
+        }
+
+        return direction * low - rotation().cross(position);
+    }
+
+    /* Point on the ground at impact_altitude, in the body's reference frame. Degrees. */
+    Vector3 ReentryPredictor::surface_position(double latitude, double longitude)
+    {
+        auto radius = body_radius + impact_altitude;
+        auto phi = latitude * M_PI / 180;
+        auto lambda = longitude * M_PI / 180;
+
+        return Vector3(radius * cos(phi) * cos(lambda), radius * sin(phi), radius * cos(phi) * sin(lambda));
+    }
+
+    /**
+     * Angle from position to point, in [0, 2 pi), measured in the direction of motion in the plane
+     * of position and velocity. A point off the plane is projected onto it. Any frame.
+     */
+    double ReentryPredictor::angle_ahead(Vector3 position, Vector3 velocity, Vector3 point)
+    {
+        auto radial = position.normalize();
+        auto along = (velocity - radial * velocity.dot(radial)).normalize();
+        auto angle = atan2(point.dot(along), point.dot(radial));
+
+        return angle < 0 ? angle + 2 * M_PI : angle;
+    }
+
+    /* Falls to zero at the top of the atmosphere without a step, which would upset the step size control. */
+    double ReentryPredictor::density(double altitude)
+    {
+        return altitude < atmosphere_depth ? m_density_scale * sea_level_density * (exp(-altitude / scale_height) - exp(-atmosphere_depth / scale_height)) : 0.0;
+    }
+
+    /* Gravity, drag, Coriolis and centrifugal acceleration in the body's reference frame. */
+    Vector3 ReentryPredictor::acceleration(Vector3 position, Vector3 velocity)
+    {
+        auto radius = position.length();
+        auto omega = rotation();
+        auto drag = 0.5 * density(radius - body_radius) * velocity.length() * drag_area / mass;
+
+        return position * (-gravitational_parameter / (radius * radius * radius)) - velocity * drag
+             - omega.cross(velocity) * 2 - omega.cross(omega.cross(position));
+    }
+
+    /**
+     * Rotation vector for which omega x r is the velocity of the ground at r, with the componentwise
+     * cross product: along -y, as the surface moves east, towards +z, at 0 degrees longitude.
+     */
+    Vector3 ReentryPredictor::rotation()
+    {
+        return Vector3(0, -rotational_speed, 0);
+    }
+
+    /* Periapsis radius of the orbit of the state in the body's reference frame. */
+    double ReentryPredictor::periapsis(Vector3 position, Vector3 velocity)
+    {
+        auto orbital_velocity = velocity + rotation().cross(position);
+        auto mu = gravitational_parameter;
+        auto h = position.cross(orbital_velocity).length();
+        auto energy = orbital_velocity.dot(orbital_velocity) / 2 - mu / position.length();
+        auto e = sqrt(std::max(0.0, 1 + 2 * energy * h * h / (mu * mu)));
+
+        return h * h / (mu * (1 + e));
+    }
+}
@@ -0,0 +1,177 @@
+#pragma once
+
+#include <math.h>
+#include <iostream>
+#include "enums/types.hpp"
+#include "connection.hpp"
+#include "constants.hpp"
+#include "formulae.hpp"
+#include "scheduler.hpp"
+#include "vector3.hpp"
+#include "kepler_orbit.hpp"
+#include "closest_approach.hpp"
+#include "clohessy_wiltshire.hpp"
+
+namespace KSP
+{
+    /**
+     * Terminal rendezvous from relative state streams. The approach from the current position
+     * to a hold point behind the target is split into legs along the line of sight. Each leg is
+     * a two-impulse CW transfer whose arrival burn is merged with the next departure, so the
+     * approach always takes legs + 1 burns. Every burn is planned again from the measured state
+     * just before it, which absorbs the errors of the previous burn and of the linear model.
+     * Burns are centred on fixed UTs and timed by a Scheduler; the vessel warps between them.
+     */
+    class Rendezvous
+    {
+    private:
+        Connection* m_connection;
+        Vessel m_vessel;
+        ReferenceFrame m_reference_frame;
+        double m_gravitational_parameter;
+        krpc::Stream<double> m_ut_stream;
+        krpc::Stream<std::tuple<double, double, double>> m_position_stream;
+        krpc::Stream<std::tuple<double, double, double>> m_velocity_stream;
+        krpc::Stream<std::tuple<double, double, double>> m_target_position_stream;
+        krpc::Stream<std::tuple<double, double, double>> m_target_velocity_stream;
+    public:
+        /* Hold point in the Hill frame; the default is behind the target on its orbit. */
+        Vector3 hold_position = Vector3(0, -100, 0);
+        int legs = 3;
+        /* Total approach time as a fraction of the target's orbital period; each leg must stay well under half. */
+        double approach_fraction = 0.5;
+        double throttle = 0.1;
+        /* Burns shorter than this are flown at a lower throttle. */
+        double min_burn_time = 1.0;
+        /* Time to point the vessel before each burn. */
+        double settle_time = 15.0;
+        double min_delta_v = 0.05;
+    public:
+        Rendezvous(Connection& connection, Vessel vessel, Vessel target);
+        ~Rendezvous();
+    public:
+        RelativeState state();
+        HillFrame frame();
+        Approach closest_approach();
+        void execute();
+    private:
+        void burn(HillFrame frame, Vector3 delta_v, double centre);
+    };
+
+    /* Positions and velocities are in the target body's non-rotating frame. */
+    Rendezvous::Rendezvous(Connection& connection, Vessel vessel, Vessel target)
+        : m_connection(&connection),
+          m_vessel(vessel),
+          m_reference_frame(target.orbit().body().non_rotating_reference_frame()),
+          m_gravitational_parameter(target.orbit().body().gravitational_parameter()),
+          m_ut_stream(connection.space_center.ut_stream()),
+          m_position_stream(vessel.position_stream(m_reference_frame)),
+          m_velocity_stream(vessel.velocity_stream(m_reference_frame)),
+          m_target_position_stream(target.position_stream(m_reference_frame)),
+          m_target_velocity_stream(target.velocity_stream(m_reference_frame))
+    {
+    }
+
+    Rendezvous::~Rendezvous()
+    {
+    }
+
+    RelativeState Rendezvous::state()
+    {
+        return frame().relative(m_position_stream(), m_velocity_stream());
+    }
+
+    HillFrame Rendezvous::frame()
+    {
+        return HillFrame(m_target_position_stream(), m_target_velocity_stream(), m_gravitational_parameter);
+    }
+
+    /* Next closest approach on the current orbits; local, so cheap enough to call every tick. */
+    Approach Rendezvous::closest_approach()
+    {
+        auto now = m_ut_stream();
+        auto vessel = KeplerOrbit::from_state(m_position_stream(), m_velocity_stream(), m_gravitational_parameter, now);
+        auto target = KeplerOrbit::from_state(m_target_position_stream(), m_target_velocity_stream(), m_gravitational_parameter, now);
+
+        return ClosestApproachFinder(vessel, target).next(now);
+    }
+
+    void Rendezvous::execute()
+    {
+        auto start_frame = frame();
+        auto start = start_frame.relative(m_position_stream(), m_velocity_stream());
+        auto leg_time = approach_fraction * 2 * M_PI / start_frame.mean_motion() / legs;
+        auto start_time = m_ut_stream() + settle_time;
+
+        m_vessel.auto_pilot().set_reference_frame(m_reference_frame);
+        m_vessel.auto_pilot().engage();
+
+        auto approach = closest_approach();
+
+        std::cout << "RENDEZVOUS: " << legs + 1 << " burns over " << leg_time * legs << " s" << std::endl;
+        std::cout << "CLOSEST APPROACH WITHOUT BURNS: " << approach.distance << " m in " << approach.time - m_ut_stream() << " s" << std::endl;
+
+        for (int leg = 0; leg <= legs; leg++)
+        {
+            auto centre = start_time + leg * leg_time;
+
+            if (centre - settle_time - m_ut_stream() > 10)
+            {
+                m_connection->space_center.warp_to(centre - settle_time);
+            }
+
+            /* Re-plan from the measured state, propagated to the burn. */
+            auto burn_frame = frame();
+            auto cw = ClohessyWiltshire(burn_frame.mean_motion());
+            auto predicted = cw.propagate(burn_frame.relative(m_position_stream(), m_velocity_stream()), centre - m_ut_stream());
+            auto delta_v = predicted.velocity * -1;
+
+            if (leg < legs)
+            {
+                auto waypoint = hold_position + (start.position - hold_position) * (1.0 - (leg + 1.0) / legs);
+
+                delta_v = delta_v + cw.departure_velocity(predicted.position, waypoint, leg_time);
+            }
+
+            burn(burn_frame, delta_v, centre);
+        }
+
+        auto final_state = state();
+
+        std::cout << "RENDEZVOUS DISTANCE: " << final_state.position.length() << " m, SPEED: " << final_state.velocity.length() << " m/s" << std::endl;
+    }
+
+    /* Time-triggered burn of delta_v (Hill frame) centred on the given UT. */
+    void Rendezvous::burn(HillFrame frame, Vector3 delta_v, double centre)
+    {
+        if (delta_v.length() < min_delta_v)
+        {
+            return;
+        }
+
+        m_vessel.auto_pilot().set_target_direction(frame.to_inertial(delta_v).normalize().to_tuple());
+
+        auto burn_throttle = throttle;
+        auto burn_time = get_burn_time(m_vessel, delta_v.length(), burn_throttle);
+
+        if (burn_time < min_burn_time)
+        {
+            burn_throttle *= burn_time / min_burn_time;
+            burn_time = min_burn_time;
+        }
+
+        Scheduler scheduler;
+        auto vessel = m_vessel;
+
+        scheduler.at(centre - burn_time / 2, [vessel, burn_throttle]() mutable { vessel.control().set_throttle(burn_throttle); });
+        scheduler.at(centre + burn_time / 2, [vessel]() mutable { vessel.control().set_throttle(0); });
+
+        while (!scheduler.empty())
+        {
+            auto now = m_ut_stream();
+
+            scheduler.run_due(now);
+            scheduler.sleep_until_next(now, 0.01);
+        }
+    }
+}
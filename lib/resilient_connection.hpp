@@ -0,0 +1,243 @@
+#pragma once
+
+#include <list>
+#include <math.h>
+#include <memory>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <iostream>
+#include <algorithm>
+#include <functional>
+#include <system_error>
+#include "connection.hpp"
+#include "loop_statistics.hpp"
+
+namespace KSP
+{
+    class TrackedBase
+    {
+    public:
+        virtual ~TrackedBase() {}
+        virtual void rebuild() = 0;
+    };
+
+    /* Stream, event or trigger that is made again after a reconnect. */
+    template <typename T>
+    class Tracked : public TrackedBase
+    {
+    private:
+        std::function<T()> m_make;
+        T m_value;
+    public:
+        Tracked(std::function<T()> make);
+    public:
+        T& get();
+        auto operator()();
+        void rebuild() override;
+    };
+
+    /**
+     * Keeps a Connection alive through server hiccups. RPCs run through call() and a dropped
+     * socket is detected from the exception they throw. Reading a stream never throws, so call()
+     * also sends a heartbeat RPC at most every heartbeat_interval seconds; a function that only
+     * reads streams and triggers still sees the drop. The client is then replaced in place
+     * with backoff, so vessels and other objects made from the connection stay usable. Streams and
+     * events registered with track() are made again, then the reconnect hooks run.
+     * Recovery gives up after max_recovery seconds. The time from the failed call until the
+     * connection answers again is recorded in statistics().
+     * Object IDs stay valid as long as the game did not reload the scene.
+     */
+    class ResilientConnection
+    {
+    private:
+        Connection* m_connection;
+        std::list<std::unique_ptr<TrackedBase>> m_tracked;
+        std::vector<std::function<void()>> m_hooks;
+        LoopStatistics m_statistics;
+        LoopClock m_clock;
+        double m_heartbeat = -INFINITY;
+    public:
+        double heartbeat_interval = 0.1;
+        double initial_backoff = 0.1;
+        double max_backoff = 2.0;
+        double max_recovery = 30.0;
+        int max_retries = 3;
+    public:
+        ResilientConnection(Connection& connection);
+        ~ResilientConnection();
+    public:
+        Connection& connection();
+        template <typename T>
+        Tracked<T>& track(std::function<T()> make);
+        void on_reconnect(std::function<void()> hook);
+        template <typename F>
+        auto call(F function);
+        void reconnect();
+        LoopStatistics statistics();
+    private:
+        void heartbeat();
+    };
+
+    template <typename T>
+    Tracked<T>::Tracked(std::function<T()> make) : m_make(make), m_value(make())
+    {
+    }
+
+    template <typename T>
+    T& Tracked<T>::get()
+    {
+        return m_value;
+    }
+
+    /* Reads a tracked stream. */
+    template <typename T>
+    auto Tracked<T>::operator()()
+    {
+        return m_value();
+    }
+
+    template <typename T>
+    void Tracked<T>::rebuild()
+    {
+        m_value = m_make();
+    }
+
+    ResilientConnection::ResilientConnection(Connection& connection) : m_connection(&connection)
+    {
+    }
+
+    ResilientConnection::~ResilientConnection()
+    {
+    }
+
+    Connection& ResilientConnection::connection()
+    {
+        return *m_connection;
+    }
+
+    /* The returned reference stays valid for the lifetime of this object. */
+    template <typename T>
+    Tracked<T>& ResilientConnection::track(std::function<T()> make)
+    {
+        auto tracked = std::make_unique<Tracked<T>>(make);
+        auto& reference = *tracked;
+
+        m_tracked.push_back(std::move(tracked));
+
+        return reference;
+    }
+
+    /* Hooks run after the tracked streams are rebuilt, e.g. to re-create a state machine's triggers. */
+    void ResilientConnection::on_reconnect(std::function<void()> hook)
+    {
+        m_hooks.push_back(hook);
+    }
+
+    /* Runs function, reconnecting and retrying it if the connection dropped. */
+    template <typename F>
+    auto ResilientConnection::call(F function)
+    {
+        LoopClock outage;
+
+        for (int attempt = 0;; attempt++)
+        {
+            try
+            {
+                heartbeat();
+
+                if (attempt > 0)
+                {
+                    m_statistics.add(outage.elapsed());
+                    std::cout << "Recovered after " << outage.elapsed() << " s." << std::endl;
+                }
+
+                return function();
+            }
+            catch (const krpc::ConnectionError& error)
+            {
+                if (attempt >= max_retries)
+                {
+                    throw;
+                }
+
+                std::cout << "Connection lost: " << error.what() << std::endl;
+            }
+            catch (const std::system_error& error)
+            {
+                if (attempt >= max_retries)
+                {
+                    throw;
+                }
+
+                std::cout << "Connection lost: " << error.what() << std::endl;
+            }
+
+            if (attempt == 0)
+            {
+                outage = LoopClock();
+            }
+
+            m_heartbeat = -INFINITY;
+            reconnect();
+        }
+    }
+
+    /* Throws the last connection error if the server is not back within max_recovery seconds. */
+    void ResilientConnection::reconnect()
+    {
+        LoopClock clock;
+        auto backoff = initial_backoff;
+
+        while (true)
+        {
+            try
+            {
+                m_connection->client = krpc::connect(CONNECT_NAME, get_address());
+
+                for (auto& tracked : m_tracked)
+                {
+                    tracked->rebuild();
+                }
+
+                for (auto& hook : m_hooks)
+                {
+                    hook();
+                }
+
+                break;
+            }
+            catch (const std::exception& error)
+            {
+                if (clock.elapsed() + backoff > max_recovery)
+                {
+                    std::cout << "Could not reconnect within " << max_recovery << " s." << std::endl;
+                    throw;
+                }
+            }
+
+            std::this_thread::sleep_for(std::chrono::duration<double>(backoff));
+            backoff = std::min(2 * backoff, max_backoff);
+        }
+
+        std::cout << "Reconnected after " << clock.elapsed() << " s." << std::endl;
+    }
+
+    /* Duration of each recovery, from the failed call until the server answered again, in seconds. */
+    LoopStatistics ResilientConnection::statistics()
+    {
+        return m_statistics;
+    }
+
+    /* A cheap RPC that throws if the socket dropped. */
+    void ResilientConnection::heartbeat()
+    {
+        if (m_clock.elapsed() - m_heartbeat < heartbeat_interval)
+        {
+            return;
+        }
+
+        m_connection->krpc.get_status();
+        m_heartbeat = m_clock.elapsed();
+    }
+}
@@ -0,0 +1,331 @@
+#pragma once
+
+#include <netdb.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <string>
+#include <vector>
+#include <future>
+#include <memory>
+#include <utility>
+#include <cstdint>
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+#include <type_traits>
+#include <krpc.hpp>
+#include <krpc/krpc.pb.hpp>
+#include <krpc/decoder.hpp>
+#include <krpc/encoder.hpp>
+#include "connection.hpp"
+#include "io_thread.hpp"
+
+namespace KSP
+{
+    /**
+     * Pipelined kRPC calls on an RPC connection of its own. The kRPC C++ client waits a round
+     * trip per call; here the calls a control loop queues go out as one Request per batch through
+     * a PipelinedChannel, with several batches in flight, and the reader thread completes the
+     * futures as the Responses arrive. The server answers the requests on a connection in order,
+     * so a response's tag is its sequence number.
+     * Calls are built on the given connection's client, e.g. with the services' *_call() methods
+     * or build_call(), and object results are bound to that client. Calls run in the order they
+     * were issued. A single thread may issue calls.
+     */
+    class PipelinedConnection
+    {
+    private:
+        krpc::Client* m_client;
+        int m_socket;
+        std::vector<char> m_buffer;
+        size_t m_begin;
+        size_t m_end;
+        uint64_t m_received;
+        std::unique_ptr<PipelinedChannel<krpc::schema::ProcedureCall, krpc::schema::ProcedureResult>> m_channel;
+    public:
+        PipelinedConnection(Connection& connection, size_t max_in_flight = 8, std::string address = get_address(), unsigned port = 50000);
+        ~PipelinedConnection();
+    public:
+        template <typename... Args>
+        krpc::schema::ProcedureCall build_call(std::string service, std::string procedure, Args... arguments);
+        template <typename T>
+        std::future<T> call(krpc::schema::ProcedureCall call);
+        void post(krpc::schema::ProcedureCall call);
+        void flush();
+        void stop();
+    private:
+        void connect(std::string address, unsigned port);
+        void send(uint64_t tag, const std::vector<krpc::schema::ProcedureCall>& calls);
+        std::pair<uint64_t, std::vector<krpc::schema::ProcedureResult>> receive();
+        void write_message(const google::protobuf::MessageLite& message);
+        void read_message(google::protobuf::MessageLite& message);
+        void read(char* data, size_t size);
+    };
+
+    std::string describe_error(const krpc::schema::Error& error)
+    {
+        return error.service() + "." + error.name() + ": " + error.description();
+    }
+
+    /* Connects and makes the kRPC handshake; throws krpc::ConnectionError if the server refuses. */
+    PipelinedConnection::PipelinedConnection(Connection& connection, size_t max_in_flight, std::string address, unsigned port)
+        : m_client(&connection.client), m_socket(-1), m_buffer(65536), m_begin(0), m_end(0), m_received(0)
+    {
+        connect(address, port);
+
+        m_channel = std::make_unique<PipelinedChannel<krpc::schema::ProcedureCall, krpc::schema::ProcedureResult>>(
+            [this](uint64_t tag, const std::vector<krpc::schema::ProcedureCall>& calls) { send(tag, calls); },
+            [this]() { return receive(); },
+            max_in_flight
+        );
+    }
+
+    /* Waits for the answers to every call already issued before closing. */
+    PipelinedConnection::~PipelinedConnection()
+    {
+        stop();
+    }
+
+    /* Arguments are encoded in order, e.g. build_call("SpaceCenter", "Control_set_Throttle", control, 0.5f). */
+    template <typename... Args>
+    krpc::schema::ProcedureCall PipelinedConnection::build_call(std::string service, std::string procedure, Args... arguments)
+    {
+        return m_client->build_call(service, procedure, {krpc::encoder::encode(arguments)...});
+    }
+
+    /* The future holds the decoded result, or a krpc::RPCError if the server failed the call. */
+    template <typename T>
+    std::future<T> PipelinedConnection::call(krpc::schema::ProcedureCall call)
+    {
+        auto client = m_client;
+
+        return m_channel->call(std::move(call), [client](krpc::schema::ProcedureResult& result) {
+            if (result.has_error())
+            {
+                throw krpc::RPCError(describe_error(result.error()));
+            }
+
+            if constexpr (!std::is_void_v<T>)
+            {
+                T value;
+                krpc::decoder::decode(value, result.value(), client);
+                return value;
+            }
+        });
+    }
+
+    /* Fire and forget, e.g. an actuator write. A failed call is printed. */
+    void PipelinedConnection::post(krpc::schema::ProcedureCall call)
+    {
+        m_channel->call(std::move(call), [](krpc::schema::ProcedureResult& result) {
+            if (result.has_error())
+            {
+                std::cout << "Pipelined call: " << describe_error(result.error()) << std::endl;
+            }
+        });
+    }
+
+    /* Blocks until every call issued so far has been answered. Throws if the connection broke. */
+    void PipelinedConnection::flush()
+    {
+        call<void>(m_client->build_call("KRPC", "GetStatus")).get();
+    }
+
+    void PipelinedConnection::stop()
+    {
+        if (m_socket < 0)
+        {
+            return;
+        }
+
+        m_channel->stop();
+        close(m_socket);
+        m_socket = -1;
+    }
+
+    void PipelinedConnection::connect(std::string address, unsigned port)
+    {
+        addrinfo hints = {};
+        addrinfo* addresses = nullptr;
+        int flag = 1;
+
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+
+        if (getaddrinfo(address.c_str(), std::to_string(port).c_str(), &hints, &addresses) != 0)
+        {
+            throw krpc::ConnectionError("Could not resolve " + address);
+        }
+
+        for (auto entry = addresses; entry != nullptr && m_socket < 0; entry = entry->ai_next)
+        {
+            m_socket = socket(entry->ai_family, entry->ai_socktype, entry->ai_protocol);
+
+            if (m_socket >= 0 && ::connect(m_socket, entry->ai_addr, entry->ai_addrlen) != 0)
+            {
+                close(m_socket);
+                m_socket = -1;
+            }
+        }
+
+        freeaddrinfo(addresses);
+
+        if (m_socket < 0)
+        {
+            throw krpc::ConnectionError("Could not connect to " + address + ":" + std::to_string(port));
+        }
+
+        /* Small requests are the point, so do not let Nagle hold them back. */
+        setsockopt(m_socket, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+
+        krpc::schema::ConnectionRequest request;
+        krpc::schema::ConnectionResponse response;
+
+        request.set_type(krpc::schema::ConnectionRequest::RPC);
+        request.set_client_name(CONNECT_NAME " pipeline");
+
+        try
+        {
+            write_message(request);
+            read_message(response);
+        }
+        catch (...)
+        {
+            close(m_socket);
+            m_socket = -1;
+            throw;
+        }
+
+        if (response.status() != krpc::schema::ConnectionResponse::OK)
+        {
+            close(m_socket);
+            m_socket = -1;
+            throw krpc::ConnectionError("Pipelined connection refused: " + response.message());
+        }
+    }
+
+    /* Writer thread: one Request per batch. A failed write shuts the socket so the reader stops too. */
+    void PipelinedConnection::send(uint64_t tag, const std::vector<krpc::schema::ProcedureCall>& calls)
+    {
+        krpc::schema::Request request;
+
+        for (auto& call : calls)
+        {
+            *request.add_calls() = call;
+        }
+
+        try
+        {
+            write_message(request);
+        }
+        catch (...)
+        {
+            shutdown(m_socket, SHUT_RDWR);
+            throw;
+        }
+    }
+
+    /* Reader thread: the next Response, tagged with its position in the stream. */
+    std::pair<uint64_t, std::vector<krpc::schema::ProcedureResult>> PipelinedConnection::receive()
+    {
+        krpc::schema::Response response;
+
+        read_message(response);
+
+        if (response.has_error())
+        {
+            throw krpc::RPCError(describe_error(response.error()));
+        }
+
+        return std::make_pair(m_received++, std::vector<krpc::schema::ProcedureResult>(response.results().begin(), response.results().end()));
+    }
+
+    /* Varint length prefix, then the message. */
+    void PipelinedConnection::write_message(const google::protobuf::MessageLite& message)
+    {
+        std::string data;
+        auto body = message.SerializeAsString();
+        auto size = body.size();
+
+        do
+        {
+            data.push_back(static_cast<char>((size & 0x7f) | (size > 0x7f ? 0x80 : 0)));
+            size >>= 7;
+        }
+        while (size > 0);
+
+        data += body;
+
+        for (size_t sent = 0; sent < data.size();)
+        {
+            auto done = ::send(m_socket, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+
+            if (done <= 0)
+            {
+                throw krpc::ConnectionError("Pipelined connection closed while sending");
+            }
+
+            sent += done;
+        }
+    }
+
+    void PipelinedConnection::read_message(google::protobuf::MessageLite& message)
+    {
+        uint64_t size = 0;
+        char byte;
+
+        for (int shift = 0; ; shift += 7)
+        {
+            if (shift > 63)
+            {
+                throw krpc::ConnectionError("Malformed message length from the server");
+            }
+
+            read(&byte, 1);
+            size |= static_cast<uint64_t>(byte & 0x7f) << shift;
+
+            if ((byte & 0x80) == 0)
+            {
+                break;
+            }
+        }
+
+        std::string body(size, '\0');
+
+        read(body.data(), size);
+
+        if (!message.ParseFromString(body))
+        {
+            throw krpc::ConnectionError("Malformed message from the server");
+        }
+    }
+
+    /* Reads exactly size bytes through the receive buffer. */
+    void PipelinedConnection::read(char* data, size_t size)
+    {
+        while (size > 0)
+        {
+            if (m_begin == m_end)
+            {
+                auto received = ::recv(m_socket, m_buffer.data(), m_buffer.size(), 0);
+
+                if (received <= 0)
+                {
+                    throw krpc::ConnectionError("Pipelined connection closed while receiving");
+                }
+
+                m_begin = 0;
+                m_end = received;
+            }
+
+            auto count = std::min(size, m_end - m_begin);
+
+            std::copy(m_buffer.data() + m_begin, m_buffer.data() + m_begin + count, data);
+            m_begin += count;
+            data += count;
+            size -= count;
+        }
+    }
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <math.h>
+#include <vector>
+#include <queue>
+#include <chrono>
+#include <thread>
+#include <functional>
+#include <unordered_set>
+
+namespace KSP
+{
+    struct ScheduledEvent
+    {
+        double time;
+        int id;
+        std::function<void()> callback;
+    };
+
+    /**
+     * Runs callbacks at given UTs, e.g. staging, throttle changes or warp stops.
+     * Events are kept in a binary heap on time. Finding the next deadline is O(1), and run_due()
+     * only touches events that are due. Events with the same time run in the order they were added.
+     */
+    class Scheduler
+    {
+    private:
+        struct Later
+        {
+            bool operator()(const ScheduledEvent& a, const ScheduledEvent& b) const
+            {
+                return a.time > b.time || (a.time == b.time && a.id > b.id);
+            }
+        };
+
+        std::priority_queue<ScheduledEvent, std::vector<ScheduledEvent>, Later> m_events;
+        std::unordered_set<int> m_cancelled;
+        int m_next_id = 0;
+    public:
+        Scheduler();
+        ~Scheduler();
+    public:
+        int at(double time, std::function<void()> callback);
+        void cancel(int id);
+        int run_due(double now);
+        double next_deadline();
+        bool empty();
+        void sleep_until_next(double now, double max_sleep);
+    private:
+        void drop_cancelled();
+    };
+
+    Scheduler::Scheduler()
+    {
+    }
+
+    Scheduler::~Scheduler()
+    {
+    }
+
+    /* Returns an id for cancel(). Callbacks may schedule further events. */
+    int Scheduler::at(double time, std::function<void()> callback)
+    {
+        auto id = m_next_id++;
+
+        m_events.push({time, id, callback});
+
+        return id;
+    }
+
+    /* Cancelled events are dropped when they reach the top of the heap. */
+    void Scheduler::cancel(int id)
+    {
+        m_cancelled.insert(id);
+        drop_cancelled();
+    }
+
+    /* Runs every event due at or before now and returns how many ran. */
+    int Scheduler::run_due(double now)
+    {
+        auto count = 0;
+
+        drop_cancelled();
+
+        while (!m_events.empty() && m_events.top().time <= now)
+        {
+            auto event = m_events.top();
+
+            m_events.pop();
+            event.callback();
+            count++;
+
+            drop_cancelled();
+        }
+
+        return count;
+    }
+
+    /* UT of the next event, or infinity if there is none. */
+    double Scheduler::next_deadline()
+    {
+        return m_events.empty() ? INFINITY : m_events.top().time;
+    }
+
+    bool Scheduler::empty()
+    {
+        return m_events.empty();
+    }
+
+    /* Sleeps until the next deadline, at most max_sleep seconds. Assumes no time warp. */
+    void Scheduler::sleep_until_next(double now, double max_sleep)
+    {
+        auto duration = std::min(max_sleep, next_deadline() - now);
+
+        if (duration > 0.0)
+        {
+            std::this_thread::sleep_for(std::chrono::duration<double>(duration));
+        }
+    }
+
+    void Scheduler::drop_cancelled()
+    {
+        while (!m_events.empty() && m_cancelled.count(m_events.top().id) > 0)
+        {
+            m_cancelled.erase(m_events.top().id);
+            m_events.pop();
+        }
+    }
+}
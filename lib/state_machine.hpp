@@ -0,0 +1,384 @@
+#pragma once
+
+#include <map>
+#include <cmath>
+#include <cstdio>
+#include <cstdint>
+#include <string>
+#include <fstream>
+#include <vector>
+#include <thread>
+#include <iostream>
+#include <functional>
+#include "condition.hpp"
+#include "loop_statistics.hpp"
+
+namespace KSP
+{
+    struct StateTransition
+    {
+        std::string from;
+        std::string to;
+        /* Seconds since the machine started. */
+        double time;
+    };
+
+    /**
+     * One phase of a mission. Entry and exit actions run once, the tick action and the guards
+     * run every step while the state is active. Triggers for transition_on() are only created
+     * while the state is active, so the server watches nothing for inactive phases.
+     * A state without transitions is final.
+     */
+    class MissionState
+    {
+    public:
+        std::string name;
+        std::function<void()> entry;
+        std::function<void()> tick;
+        std::function<void()> exit;
+        std::vector<std::pair<std::function<bool()>, std::string>> guards;
+        std::vector<std::pair<std::function<Trigger()>, std::string>> trigger_guards;
+        std::vector<Trigger> triggers;
+        LoopStatistics statistics;
+    public:
+        MissionState& on_entry(std::function<void()> action);
+        MissionState& on_tick(std::function<void()> action);
+        MissionState& on_exit(std::function<void()> action);
+        MissionState& transition(std::string target, std::function<bool()> guard);
+        MissionState& transition_on(std::string target, std::function<Trigger()> make_trigger);
+        bool final();
+    };
+
+    class StateMachine
+    {
+    private:
+        std::string m_name;
+        std::string m_initial;
+        std::map<std::string, MissionState> m_states;
+        std::vector<StateTransition> m_transitions;
+        MissionState* m_current = nullptr;
+        LoopClock m_clock;
+        double m_entered = 0.0;
+        bool m_started = false;
+        bool m_entry_pending = false;
+        std::string m_checkpoint;
+        uint64_t m_vessel_id = 0;
+        double m_launch_ut = 0.0;
+    public:
+        bool log = true;
+    public:
+        StateMachine(std::string name, std::string initial);
+        ~StateMachine();
+    public:
+        MissionState& state(std::string name);
+        void start();
+        bool step();
+        void run(int period_milliseconds);
+        bool finished();
+        std::string current();
+        std::vector<StateTransition> transitions();
+        void print_statistics();
+        void checkpoint(std::string path, uint64_t vessel_id, double launch_ut);
+        void resume();
+    private:
+        void enter(std::string name);
+        void complete_entry();
+        void save_checkpoint();
+    };
+
+    MissionState& MissionState::on_entry(std::function<void()> action)
+    {
+        entry = action;
+        return *this;
+    }
+
+    MissionState& MissionState::on_tick(std::function<void()> action)
+    {
+        tick = action;
+        return *this;
+    }
+
+    MissionState& MissionState::on_exit(std::function<void()> action)
+    {
+        exit = action;
+        return *this;
+    }
+
+    /* Guards are checked in the order they were added; the first one true wins. */
+    MissionState& MissionState::transition(std::string target, std::function<bool()> guard)
+    {
+        guards.push_back(std::make_pair(guard, target));
+        return *this;
+    }
+
+    /* Transition on a server-side trigger, e.g. (altitude < 2000).trigger(connection). */
+    MissionState& MissionState::transition_on(std::string target, std::function<Trigger()> make_trigger)
+    {
+        trigger_guards.push_back(std::make_pair(make_trigger, target));
+        return *this;
+    }
+
+    bool MissionState::final()
+    {
+        return guards.empty() && trigger_guards.empty();
+    }
+
+    StateMachine::StateMachine(std::string name, std::string initial) : m_name(name), m_initial(initial)
+    {
+    }
+
+    StateMachine::~StateMachine()
+    {
+    }
+
+    /* Adds the state on first use. */
+    MissionState& StateMachine::state(std::string name)
+    {
+        auto& state = m_states[name];
+
+        state.name = name;
+
+        return state;
+    }
+
+    void StateMachine::start()
+    {
+        m_clock = LoopClock();
+        m_started = true;
+        enter(m_initial);
+    }
+
+    /* Runs the active state's tick and guards. Returns false once the machine is in a final state. */
+    bool StateMachine::step()
+    {
+        if (!m_started)
+        {
+            start();
+        }
+
+        /* The entry action threw last time, e.g. on a lost connection; run it again. */
+        if (m_entry_pending)
+        {
+            complete_entry();
+        }
+
+        if (finished())
+        {
+            return false;
+        }
+
+        LoopClock clock;
+        auto state = m_current;
+
+        if (state->tick)
+        {
+            state->tick();
+        }
+
+        std::string target;
+
+        for (auto& [guard, to] : state->guards)
+        {
+            if (guard())
+            {
+                target = to;
+                break;
+            }
+        }
+
+        for (size_t i = 0; target.empty() && i < state->triggers.size(); i++)
+        {
+            if (state->triggers[i].triggered())
+            {
+                target = state->trigger_guards[i].second;
+            }
+        }
+
+        state->statistics.add(clock.elapsed());
+
+        if (!target.empty())
+        {
+            enter(target);
+        }
+
+        return !finished();
+    }
+
+    /* Steps until a final state is reached. */
+    void StateMachine::run(int period_milliseconds)
+    {
+        while (step())
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(period_milliseconds));
+        }
+    }
+
+    bool StateMachine::finished()
+    {
+        return m_current == nullptr ? m_started : m_current->final();
+    }
+
+    std::string StateMachine::current()
+    {
+        return m_current == nullptr ? "" : m_current->name;
+    }
+
+    std::vector<StateTransition> StateMachine::transitions()
+    {
+        return m_transitions;
+    }
+
+    /**
+     * Saves the active state to path once its entry action has run, and starts from the saved
+     * state if path holds one for the same vessel and launch, e.g. when a mission restarts after
+     * a crash or a lost connection. A checkpoint from another flight is deleted, so it can never
+     * start a new flight halfway. The file is removed once a final state is reached. Call before
+     * the machine starts.
+     */
+    void StateMachine::checkpoint(std::string path, uint64_t vessel_id, double launch_ut)
+    {
+        std::ifstream file(path);
+        uint64_t saved_vessel_id;
+        double saved_launch_ut;
+        std::string saved;
+
+        m_checkpoint = path;
+        m_vessel_id = vessel_id;
+        m_launch_ut = launch_ut;
+
+        if (!(file >> saved_vessel_id >> saved_launch_ut >> saved))
+        {
+            return;
+        }
+
+        /* The launch UT is derived from the mission time, so allow for a physics frame or two. */
+        if (saved_vessel_id != vessel_id || std::abs(saved_launch_ut - launch_ut) > 1.0 || m_states.find(saved) == m_states.end())
+        {
+            std::cout << m_name << ": ignoring checkpoint from another flight" << std::endl;
+            file.close();
+            std::remove(path.c_str());
+            return;
+        }
+
+        std::cout << m_name << ": resuming from checkpoint in state '" << saved << "'" << std::endl;
+        m_initial = saved;
+    }
+
+    /**
+     * Makes the active state's triggers again, e.g. after a reconnect made the old ones invalid.
+     * The entry action does not run again once it has completed.
+     */
+    void StateMachine::resume()
+    {
+        if (m_current == nullptr || m_entry_pending)
+        {
+            return;
+        }
+
+        m_current->triggers.clear();
+
+        for (auto& [make_trigger, to] : m_current->trigger_guards)
+        {
+            m_current->triggers.push_back(make_trigger());
+        }
+    }
+
+    /* Time spent in each state's tick and guards. */
+    void StateMachine::print_statistics()
+    {
+        for (auto& [name, state] : m_states)
+        {
+            std::cout << m_name << " " << name << ": " << state.statistics << std::endl;
+        }
+    }
+
+    void StateMachine::enter(std::string name)
+    {
+        auto time = m_clock.elapsed();
+        auto found = m_states.find(name);
+
+        if (m_current != nullptr)
+        {
+            if (m_current->exit)
+            {
+                m_current->exit();
+            }
+
+            /* Stop the server watching the old state's triggers. */
+            for (auto& trigger : m_current->triggers)
+            {
+                trigger.event().remove();
+            }
+
+            m_current->triggers.clear();
+        }
+
+        m_transitions.push_back({current(), name, time});
+
+        if (log)
+        {
+            std::cout << m_name << ": " << (m_current == nullptr ? "start" : m_current->name) << " -> " << name
+                      << " after " << time - m_entered << " s" << std::endl;
+        }
+
+        m_entered = time;
+        m_current = found == m_states.end() ? nullptr : &found->second;
+
+        if (m_current == nullptr)
+        {
+            std::cout << m_name << ": unknown state '" << name << "'" << std::endl;
+            return;
+        }
+
+        m_entry_pending = true;
+        complete_entry();
+    }
+
+    /**
+     * Makes the triggers and runs the entry action, then saves the checkpoint. If either throws,
+     * the entry stays pending and the next step() runs it again, so a restart or a retry never
+     * skips it, e.g. a parachute deploy.
+     */
+    void StateMachine::complete_entry()
+    {
+        m_current->triggers.clear();
+
+        for (auto& [make_trigger, to] : m_current->trigger_guards)
+        {
+            m_current->triggers.push_back(make_trigger());
+        }
+
+        if (m_current->entry)
+        {
+            m_current->entry();
+        }
+
+        m_entry_pending = false;
+        save_checkpoint();
+    }
+
+    /* Write and rename, so a crash never leaves a partial checkpoint. */
+    void StateMachine::save_checkpoint()
+    {
+        if (m_checkpoint.empty())
+        {
+            return;
+        }
+
+        if (m_current->final())
+        {
+            std::remove(m_checkpoint.c_str());
+            return;
+        }
+
+        auto temporary = m_checkpoint + ".tmp";
+
+        {
+            std::ofstream file(temporary);
+            file.precision(17);
+            file << m_vessel_id << " " << m_launch_ut << " " << m_current->name << std::endl;
+        }
+
+        std::rename(temporary.c_str(), m_checkpoint.c_str());
+    }
+}
@@ -0,0 +1,373 @@
+#pragma once
+
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <cstdint>
+#include <stdexcept>
+#include <functional>
+#include "vector3.hpp"
+
+namespace KSP
+{
+    /* Shared memory object published by tools/ksp_daemon. */
+    const char TELEMETRY_SHM_NAME[] = "/ksp-telemetry";
+    const uint32_t TELEMETRY_MAGIC = 0x4b535054;
+    const uint32_t TELEMETRY_VERSION = 1;
+    const size_t TELEMETRY_COMMANDS = 256;
+    /* A daemon that died while writing leaves the seqlock odd, so readers give up after this many tries. */
+    const size_t TELEMETRY_READ_RETRIES = 1000000;
+
+    /* Values published for the active vessel every daemon tick. */
+    enum TelemetryChannel
+    {
+        TELEMETRY_UT,
+        TELEMETRY_MET,
+        TELEMETRY_MEAN_ALTITUDE,
+        TELEMETRY_SURFACE_ALTITUDE,
+        TELEMETRY_VERTICAL_SPEED,
+        TELEMETRY_SPEED,
+        TELEMETRY_APOAPSIS_ALTITUDE,
+        TELEMETRY_PERIAPSIS_ALTITUDE,
+        TELEMETRY_TIME_TO_APOAPSIS,
+        TELEMETRY_TIME_TO_PERIAPSIS,
+        TELEMETRY_MASS,
+        TELEMETRY_THRUST,
+        TELEMETRY_AVAILABLE_THRUST,
+        TELEMETRY_THROTTLE,
+        TELEMETRY_STAGE,
+        TELEMETRY_CHANNELS
+    };
+
+    const char* const TELEMETRY_CHANNEL_NAMES[TELEMETRY_CHANNELS] = {
+        "ut", "met", "mean_altitude", "surface_altitude", "vertical_speed", "speed",
+        "apoapsis_altitude", "periapsis_altitude", "time_to_apoapsis", "time_to_periapsis",
+        "mass", "thrust", "available_thrust", "throttle", "stage"
+    };
+
+    enum CommandType
+    {
+        COMMAND_THROTTLE,
+        COMMAND_ACTIVATE_NEXT_STAGE,
+        COMMAND_ACTION_GROUP,
+        COMMAND_SAS,
+        COMMAND_AUTOPILOT_ENGAGE,
+        COMMAND_AUTOPILOT_DISENGAGE,
+        COMMAND_AUTOPILOT_DIRECTION,
+        COMMAND_AUTOPILOT_PITCH_HEADING
+    };
+
+    /* Reference frames for COMMAND_AUTOPILOT_DIRECTION, relative to the active vessel. */
+    enum CommandFrame
+    {
+        FRAME_ORBITAL,
+        FRAME_SURFACE,
+        FRAME_SURFACE_VELOCITY
+    };
+
+    struct DaemonCommand
+    {
+        CommandType type;
+        /* Action group, frame or on/off flag, depending on the type. */
+        int32_t argument;
+        double values[3];
+    };
+
+    /**
+     * Layout of the shared memory. The telemetry is a seqlock: the daemon makes sequence odd
+     * while it writes, readers retry if it was odd or changed while they copied. Commands are
+     * a bounded multi-producer ring with one sequence number per slot, so several mission
+     * processes can send without locks. Only lock-free atomics, which are address-free, are used.
+     */
+    struct TelemetryBlock
+    {
+        struct CommandSlot
+        {
+            std::atomic<uint64_t> sequence;
+            DaemonCommand command;
+        };
+
+        uint32_t magic;
+        uint32_t version;
+        std::atomic<uint64_t> sequence;
+        /* Steady-clock time of the last update, in nanoseconds. */
+        std::atomic<int64_t> heartbeat;
+        std::atomic<uint64_t> vessel_id;
+        std::atomic<double> values[TELEMETRY_CHANNELS];
+        alignas(64) std::atomic<uint64_t> command_head;
+        alignas(64) std::atomic<uint64_t> command_tail;
+        CommandSlot commands[TELEMETRY_COMMANDS];
+    };
+
+    /* Atomics that need a lock are not address-free, so would not work across processes. */
+    static_assert(std::atomic<uint64_t>::is_always_lock_free, "64-bit atomics must be lock-free for shared memory");
+    static_assert(std::atomic<int64_t>::is_always_lock_free, "64-bit atomics must be lock-free for shared memory");
+    static_assert(std::atomic<double>::is_always_lock_free, "double atomics must be lock-free for shared memory");
+
+    /* Consistent copy of all channels from one daemon tick. */
+    struct TelemetrySnapshot
+    {
+        /* Daemon tick count; changes on every update. */
+        uint64_t frame;
+        uint64_t vessel_id;
+        double values[TELEMETRY_CHANNELS];
+
+        double operator[](TelemetryChannel channel) const { return values[channel]; }
+    };
+
+    /**
+     * Mission-side view of the daemon. Opening it maps the shared memory, so a mission phase
+     * starts in milliseconds without connecting to kRPC. Any number of processes, e.g. the
+     * controller, a recorder and a dashboard, can have a client open at once.
+     */
+    class TelemetryClient
+    {
+    private:
+        TelemetryBlock* m_block;
+    public:
+        TelemetryClient(std::string name = TELEMETRY_SHM_NAME);
+        TelemetryClient(const TelemetryClient&) = delete;
+        ~TelemetryClient();
+    public:
+        TelemetrySnapshot read();
+        double value(TelemetryChannel channel);
+        TelemetrySnapshot wait_for_update(uint64_t frame, double timeout = 1.0);
+        TelemetrySnapshot wait_until(std::function<bool(const TelemetrySnapshot&)> condition, double timeout = INFINITY, double period = 0.005);
+        bool alive(double max_age = 1.0);
+        bool send(DaemonCommand command);
+        bool set_throttle(double throttle);
+        bool activate_next_stage();
+        bool set_action_group(int group, bool state);
+        bool set_sas(bool state);
+        bool engage_autopilot();
+        bool disengage_autopilot();
+        bool set_target_direction(CommandFrame frame, Vector3 direction);
+        bool target_pitch_and_heading(double pitch, double heading);
+    };
+
+    /* Claims a slot in the command ring. Returns false if the ring is full. */
+    bool push_command(TelemetryBlock* block, DaemonCommand command)
+    {
+        auto position = block->command_tail.load(std::memory_order_relaxed);
+
+        while (true)
+        {
+            auto& slot = block->commands[position % TELEMETRY_COMMANDS];
+            auto sequence = slot.sequence.load(std::memory_order_acquire);
+            auto difference = static_cast<int64_t>(sequence) - static_cast<int64_t>(position);
+
+            if (difference == 0)
+            {
+                if (block->command_tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                {
+                    slot.command = command;
+                    slot.sequence.store(position + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (difference < 0)
+            {
+                return false;
+            }
+            else
+            {
+                position = block->command_tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /* Daemon only. Returns false if no command is waiting. */
+    bool pop_command(TelemetryBlock* block, DaemonCommand& command)
+    {
+        auto position = block->command_head.load(std::memory_order_relaxed);
+        auto& slot = block->commands[position % TELEMETRY_COMMANDS];
+
+        if (slot.sequence.load(std::memory_order_acquire) != position + 1)
+        {
+            return false;
+        }
+
+        command = slot.command;
+        slot.sequence.store(position + TELEMETRY_COMMANDS, std::memory_order_release);
+        block->command_head.store(position + 1, std::memory_order_relaxed);
+
+        return true;
+    }
+
+    int64_t telemetry_clock()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    /* Throws std::runtime_error if the daemon is not running. */
+    TelemetryClient::TelemetryClient(std::string name)
+    {
+        auto descriptor = shm_open(name.c_str(), O_RDWR, 0);
+
+        if (descriptor < 0)
+        {
+            throw std::runtime_error("No telemetry at '" + name + "', is ksp_daemon running?");
+        }
+
+        auto memory = mmap(nullptr, sizeof(TelemetryBlock), PROT_READ | PROT_WRITE, MAP_SHARED, descriptor, 0);
+        close(descriptor);
+
+        if (memory == MAP_FAILED)
+        {
+            throw std::runtime_error("Could not map telemetry at '" + name + "'");
+        }
+
+        m_block = static_cast<TelemetryBlock*>(memory);
+
+        if (m_block->magic != TELEMETRY_MAGIC || m_block->version != TELEMETRY_VERSION)
+        {
+            munmap(m_block, sizeof(TelemetryBlock));
+            throw std::runtime_error("Telemetry at '" + name + "' has a different layout version");
+        }
+    }
+
+    TelemetryClient::~TelemetryClient()
+    {
+        munmap(m_block, sizeof(TelemetryBlock));
+    }
+
+    /* Throws std::runtime_error if no consistent copy could be made, e.g. the daemon died mid-write. */
+    TelemetrySnapshot TelemetryClient::read()
+    {
+        TelemetrySnapshot snapshot;
+
+        for (size_t attempt = 0; attempt < TELEMETRY_READ_RETRIES; attempt++)
+        {
+            auto before = m_block->sequence.load(std::memory_order_acquire);
+
+            if (before % 2 == 1)
+            {
+                std::this_thread::yield();
+                continue;
+            }
+
+            snapshot.vessel_id = m_block->vessel_id.load(std::memory_order_relaxed);
+
+            for (int i = 0; i < TELEMETRY_CHANNELS; i++)
+            {
+                snapshot.values[i] = m_block->values[i].load(std::memory_order_relaxed);
+            }
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+
+            if (m_block->sequence.load(std::memory_order_relaxed) == before)
+            {
+                snapshot.frame = before / 2;
+                return snapshot;
+            }
+        }
+
+        throw std::runtime_error("Telemetry is not consistent, did ksp_daemon stop while writing?");
+    }
+
+    double TelemetryClient::value(TelemetryChannel channel)
+    {
+        return m_block->values[channel].load(std::memory_order_acquire);
+    }
+
+    /* Blocks until a tick newer than frame is published, or the timeout in seconds passes. */
+    TelemetrySnapshot TelemetryClient::wait_for_update(uint64_t frame, double timeout)
+    {
+        auto end = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(timeout));
+
+        while (m_block->sequence.load(std::memory_order_acquire) / 2 <= frame && std::chrono::steady_clock::now() < end)
+        {
+            std::this_thread::sleep_for(std::chrono::microseconds(500));
+        }
+
+        return read();
+    }
+
+    /**
+     * Polls the telemetry until the condition holds and returns the snapshot that satisfied it.
+     * Throws std::runtime_error if the daemon stops publishing or timeout seconds pass, as the
+     * values would never change again.
+     */
+    TelemetrySnapshot TelemetryClient::wait_until(std::function<bool(const TelemetrySnapshot&)> condition, double timeout, double period)
+    {
+        auto start = telemetry_clock();
+        auto snapshot = read();
+
+        while (!condition(snapshot))
+        {
+            if (!alive())
+            {
+                throw std::runtime_error("ksp_daemon stopped publishing telemetry");
+            }
+
+            if ((telemetry_clock() - start) * 1e-9 > timeout)
+            {
+                throw std::runtime_error("Timed out waiting on telemetry");
+            }
+
+            std::this_thread::sleep_for(std::chrono::duration<double>(period));
+            snapshot = read();
+        }
+
+        return snapshot;
+    }
+
+    /* True if the daemon published within the last max_age seconds. */
+    bool TelemetryClient::alive(double max_age)
+    {
+        return (telemetry_clock() - m_block->heartbeat.load(std::memory_order_acquire)) * 1e-9 < max_age;
+    }
+
+    /* Queues a command for the daemon. Returns false if the command ring is full. */
+    bool TelemetryClient::send(DaemonCommand command)
+    {
+        return push_command(m_block, command);
+    }
+
+    bool TelemetryClient::set_throttle(double throttle)
+    {
+        return send({COMMAND_THROTTLE, 0, {throttle, 0, 0}});
+    }
+
+    bool TelemetryClient::activate_next_stage()
+    {
+        return send({COMMAND_ACTIVATE_NEXT_STAGE, 0, {0, 0, 0}});
+    }
+
+    bool TelemetryClient::set_action_group(int group, bool state)
+    {
+        return send({COMMAND_ACTION_GROUP, group, {state ? 1.0 : 0.0, 0, 0}});
+    }
+
+    bool TelemetryClient::set_sas(bool state)
+    {
+        return send({COMMAND_SAS, state, {0, 0, 0}});
+    }
+
+    bool TelemetryClient::engage_autopilot()
+    {
+        return send({COMMAND_AUTOPILOT_ENGAGE, 0, {0, 0, 0}});
+    }
+
+    bool TelemetryClient::disengage_autopilot()
+    {
+        return send({COMMAND_AUTOPILOT_DISENGAGE, 0, {0, 0, 0}});
+    }
+
+    /* Sets the autopilot reference frame and its target direction in that frame. */
+    bool TelemetryClient::set_target_direction(CommandFrame frame, Vector3 direction)
+    {
+        return send({COMMAND_AUTOPILOT_DIRECTION, frame, {direction.m_x, direction.m_y, direction.m_z}});
+    }
+
+    bool TelemetryClient::target_pitch_and_heading(double pitch, double heading)
+    {
+        return send({COMMAND_AUTOPILOT_PITCH_HEADING, 0, {pitch, heading, 0}});
+    }
+}
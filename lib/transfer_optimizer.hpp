@@ -0,0 +1,434 @@
+#pragma once
+
+#include <math.h>
+#include <vector>
+#include <thread>
+#include <algorithm>
+#include "vector3.hpp"
+#include "kepler_orbit.hpp"
+
+namespace KSP
+{
+    /* Stumpff functions of the universal variable z. */
+    double stumpff_c(double z)
+    {
+        if (z > 1e-6)
+        {
+            return (1 - cos(sqrt(z))) / z;
+        }
+
+        if (z < -1e-6)
+        {
+            return (cosh(sqrt(-z)) - 1) / -z;
+        }
+
+        return 1.0 / 2 - z / 24 + z * z / 720;
+    }
+
+    double stumpff_s(double z)
+    {
+        if (z > 1e-6)
+        {
+            return (sqrt(z) - sin(sqrt(z))) / pow(z, 1.5);
+        }
+
+        if (z < -1e-6)
+        {
+            return (sinh(sqrt(-z)) - sqrt(-z)) / pow(-z, 1.5);
+        }
+
+        return 1.0 / 6 - z / 120 + z * z / 5040;
+    }
+
+    /**
+     * Lambert's problem: the velocities at both ends of the conic from position first to position
+     * second in time_of_flight, going around normal, i.e. the long way if the short way would go
+     * against it. Universal variables, solved by bisection on z, which is slow but never fails
+     * inside one revolution. Returns false for transfers of exactly 0 or 180 degrees, whose plane
+     * is undefined.
+     */
+    bool lambert(Vector3 first, Vector3 second, double time_of_flight, double gravitational_parameter, Vector3 normal, Vector3& first_velocity, Vector3& second_velocity)
+    {
+        auto first_radius = first.length();
+        auto second_radius = second.length();
+        auto cos_angle = std::clamp(first.dot(second) / (first_radius * second_radius), -1.0, 1.0);
+        auto angle = acos(cos_angle);
+
+        if (first.cross(second).dot(normal) < 0)
+        {
+            angle = 2 * M_PI - angle;
+        }
+
+        auto a = sin(angle) * sqrt(first_radius * second_radius / (1 - cos_angle));
+
+        if (abs(a) < 1e-6 * first_radius || time_of_flight <= 0)
+        {
+            return false;
+        }
+
+        auto y = [&](double z) { return first_radius + second_radius + a * (z * stumpff_s(z) - 1) / sqrt(stumpff_c(z)); };
+
+        /* Flight time grows with z; where y is negative no conic exists and the time counts as too short. */
+        auto flight_time = [&](double z) -> double {
+            auto y_z = y(z);
+
+            if (y_z < 0)
+            {
+                return -INFINITY;
+            }
+
+            return (pow(y_z / stumpff_c(z), 1.5) * stumpff_s(z) + a * sqrt(y_z)) / sqrt(gravitational_parameter);
+        };
+
+        auto lower = -100.0;
+        auto upper = 4 * M_PI * M_PI - 1e-9;
+
+        if (flight_time(lower) > time_of_flight)
+        {
+            return false;
+        }
+
+        for (int i = 0; i < 100 && upper - lower > 1e-12; i++)
+        {
+            auto middle = (lower + upper) / 2;
+
+            if (flight_time(middle) < time_of_flight)
+            {
+                lower = middle;
+            }
+            else
+            {
+                upper = middle;
+            }
+        }
+
+        auto y_z = y((lower + upper) / 2);
+        auto f = 1 - y_z / first_radius;
+        auto g = a * sqrt(y_z / gravitational_parameter);
+        auto g_dot = 1 - y_z / second_radius;
+
+        first_velocity = (second - first * f) / g;
+        second_velocity = (second * g_dot - first) / g;
+
+        return true;
+    }
+
+    /* One maneuver node. Components are along the node's prograde, normal and radial axes. */
+    struct TransferBurn
+    {
+        double time;
+        Vector3 delta_v;
+        double prograde;
+        double normal;
+        double radial;
+    };
+
+    struct TransferPlan
+    {
+        std::vector<TransferBurn> burns;
+        /* Sum of the burn magnitudes. */
+        double delta_v = INFINITY;
+        double departure_time = 0.0;
+        double arrival_time = 0.0;
+        /**
+         * Zero for a single combined burn. Otherwise the plan has a second, mid-course burn at
+         * break_fraction of the way, and the first burn makes plane_change_fraction of the plane change.
+         */
+        double break_fraction = 0.0;
+        double plane_change_fraction = 1.0;
+    };
+
+    /**
+     * Transfer to a target orbiting the same body in another plane, e.g. the Mun from an inclined
+     * parking orbit, with the plane change folded into the transfer instead of a separate burn
+     * at the node first. Two shapes are searched:
+     * - one combined burn onto the conic that meets the target (Lambert's problem), and
+     * - a broken-plane transfer: the first burn makes part of the plane change, and a mid-course
+     *   burn further out, where the vessel is slow, makes the rest and meets the target.
+     * Departure times over one synodic period, flight times around the Hohmann time, plane change
+     * splits and mid-course positions are searched on a grid over all cores, and the cheapest
+     * plan of each shape is refined by a compass search.
+     */
+    class TransferOptimizer
+    {
+    private:
+        KeplerOrbit m_chaser;
+        KeplerOrbit m_target;
+    public:
+        int departure_samples = 72;
+        int flight_time_samples = 15;
+        /* Flight times searched, as a fraction either side of the Hohmann time. */
+        double flight_time_range = 0.3;
+        std::vector<double> plane_change_fractions = {0.0, 0.25, 0.5, 0.75, 1.0};
+        std::vector<double> break_fractions = {0.5, 0.6, 0.7, 0.8, 0.9};
+        /* Compass search steps before giving up. */
+        int refine_iterations = 200;
+        /* Time before the first burn, to turn the vessel. */
+        double lead_time = 120.0;
+        /* Zero uses every core. */
+        unsigned threads = 0;
+        /* Plans evaluated in the last optimize(). */
+        size_t evaluated_plans = 0;
+    public:
+        TransferOptimizer(KeplerOrbit chaser, KeplerOrbit target);
+        ~TransferOptimizer();
+    public:
+        TransferPlan optimize(double start);
+        TransferPlan evaluate(double departure_time, double flight_time, double break_fraction, double plane_change_fraction);
+        TransferBurn correction(KeplerOrbit current, double time, double arrival_time);
+    private:
+        TransferPlan refine(TransferPlan plan, double start, double departure_step, double flight_time_step);
+        static TransferBurn burn(double time, Vector3 position, Vector3 velocity, Vector3 delta_v);
+    };
+
+    TransferOptimizer::TransferOptimizer(KeplerOrbit chaser, KeplerOrbit target) : m_chaser(chaser), m_target(target)
+    {
+    }
+
+    TransferOptimizer::~TransferOptimizer()
+    {
+    }
+
+    /* Cheapest plan departing within one synodic period after start and the lead time. */
+    TransferPlan TransferOptimizer::optimize(double start)
+    {
+        auto mu = m_chaser.gravitational_parameter();
+        auto transfer_axis = (m_chaser.semi_major_axis() + m_target.semi_major_axis()) / 2;
+        auto hohmann_time = M_PI * sqrt(pow(transfer_axis, 3) / mu);
+        auto synodic_period = 2 * M_PI / std::max(abs(m_chaser.mean_motion() - m_target.mean_motion()), 1e-12);
+        auto departure_span = std::min(synodic_period, 2 * M_PI / std::min(m_chaser.mean_motion(), m_target.mean_motion()));
+        auto departure_step = departure_span / departure_samples;
+        auto flight_time_step = 2 * flight_time_range * hohmann_time / std::max(flight_time_samples - 1, 1);
+
+        auto thread_count = threads > 0 ? threads : std::max(1u, std::thread::hardware_concurrency());
+        std::vector<TransferPlan> best_single(thread_count);
+        std::vector<TransferPlan> best_split(thread_count);
+        std::vector<size_t> evaluated(thread_count, 0);
+        std::vector<std::thread> workers;
+
+        for (unsigned t = 0; t < thread_count; t++)
+        {
+            workers.emplace_back([&, t]() {
+                for (int i = t; i < departure_samples; i += thread_count)
+                {
+                    auto departure_time = start + lead_time + i * departure_step;
+
+                    for (int j = 0; j < flight_time_samples; j++)
+                    {
+                        auto flight_time = hohmann_time * (1 - flight_time_range) + j * flight_time_step;
+                        auto single = evaluate(departure_time, flight_time, 0.0, 1.0);
+
+                        evaluated[t]++;
+
+                        if (single.delta_v < best_single[t].delta_v)
+                        {
+                            best_single[t] = single;
+                        }
+
+                        for (auto break_fraction : break_fractions)
+                        {
+                            for (auto plane_change_fraction : plane_change_fractions)
+                            {
+                                auto split = evaluate(departure_time, flight_time, break_fraction, plane_change_fraction);
+
+                                evaluated[t]++;
+
+                                if (split.delta_v < best_split[t].delta_v)
+                                {
+                                    best_split[t] = split;
+                                }
+                            }
+                        }
+                    }
+                }
+            });
+        }
+
+        for (auto& worker : workers)
+        {
+            worker.join();
+        }
+
+        TransferPlan single;
+        TransferPlan split;
+        evaluated_plans = 0;
+
+        for (unsigned t = 0; t < thread_count; t++)
+        {
+            single = best_single[t].delta_v < single.delta_v ? best_single[t] : single;
+            split = best_split[t].delta_v < split.delta_v ? best_split[t] : split;
+            evaluated_plans += evaluated[t];
+        }
+
+        single = refine(single, start, departure_step, flight_time_step);
+        split = refine(split, start, departure_step, flight_time_step);
+
+        return split.delta_v < single.delta_v ? split : single;
+    }
+
+    /**
+     * Plan for one point of the search. A plan that cannot be flown, e.g. an exactly 180 degree
+     * combined burn, has infinite delta-v.
+     */
+    TransferPlan TransferOptimizer::evaluate(double departure_time, double flight_time, double break_fraction, double plane_change_fraction)
+    {
+        auto mu = m_chaser.gravitational_parameter();
+        auto arrival_time = departure_time + flight_time;
+        auto chaser_normal = m_chaser.normal();
+        auto target_position = m_target.position_at(arrival_time);
+        Vector3 position, velocity;
+        Vector3 departure_velocity, break_velocity, leg_departure_velocity, arrival_velocity;
+
+        TransferPlan plan;
+        plan.departure_time = departure_time;
+        plan.arrival_time = arrival_time;
+        plan.break_fraction = break_fraction;
+        plan.plane_change_fraction = plane_change_fraction;
+
+        m_chaser.state_at(departure_time, position, velocity);
+
+        if (break_fraction <= 0)
+        {
+            if (lambert(position, target_position, flight_time, mu, chaser_normal, departure_velocity, arrival_velocity))
+            {
+                plan.burns.push_back(burn(departure_time, position, velocity, departure_velocity - velocity));
+                plan.delta_v = plan.burns[0].delta_v.length();
+            }
+
+            return plan;
+        }
+
+        /* Plane of the combined transfer, turned the same way round as the chaser's orbit. */
+        auto radial = position.normalize();
+        auto transfer_normal = position.cross(target_position).normalize();
+
+        if (transfer_normal.dot(chaser_normal) < 0)
+        {
+            transfer_normal = transfer_normal * -1;
+        }
+
+        /* First leg in a plane turned part of the way about the departure point. */
+        auto plane_angle = atan2(radial.dot(chaser_normal.cross(transfer_normal)), chaser_normal.dot(transfer_normal));
+        auto turn = plane_change_fraction * plane_angle;
+        auto leg_normal = chaser_normal * cos(turn) + radial.cross(chaser_normal) * sin(turn);
+        auto ahead = leg_normal.cross(radial);
+
+        /* Mid-course point along a Hohmann-like ellipse in that plane, at the matching time. */
+        auto cos_angle = std::clamp(radial.dot(target_position.normalize()), -1.0, 1.0);
+        auto transfer_angle = acos(cos_angle);
+
+        if (position.cross(target_position).dot(chaser_normal) < 0)
+        {
+            transfer_angle = 2 * M_PI - transfer_angle;
+        }
+
+        auto departure_radius = position.length();
+        auto arrival_radius = target_position.length();
+        auto break_angle = break_fraction * transfer_angle;
+        auto break_radius = departure_radius + (arrival_radius - departure_radius) * (1 - cos(M_PI * break_fraction)) / 2;
+        auto eccentricity = abs(arrival_radius - departure_radius) / (arrival_radius + departure_radius);
+        auto eccentric_anomaly = 2 * atan(sqrt((1 - eccentricity) / (1 + eccentricity)) * tan(M_PI * break_fraction / 2));
+        auto break_time = departure_time + flight_time * (eccentric_anomaly - eccentricity * sin(eccentric_anomaly)) / M_PI;
+        auto break_position = (radial * cos(break_angle) + ahead * sin(break_angle)) * break_radius;
+
+        if (!lambert(position, break_position, break_time - departure_time, mu, leg_normal, departure_velocity, break_velocity))
+        {
+            return plan;
+        }
+
+        if (!lambert(break_position, target_position, arrival_time - break_time, mu, leg_normal, leg_departure_velocity, arrival_velocity))
+        {
+            return plan;
+        }
+
+        plan.burns.push_back(burn(departure_time, position, velocity, departure_velocity - velocity));
+        plan.burns.push_back(burn(break_time, break_position, break_velocity, leg_departure_velocity - break_velocity));
+        plan.delta_v = plan.burns[0].delta_v.length() + plan.burns[1].delta_v.length();
+
+        return plan;
+    }
+
+    /**
+     * Burn at time that takes the current orbit, e.g. as flown after the first burn, to the
+     * target at arrival_time. Used to re-plan the mid-course burn from the measured orbit.
+     */
+    TransferBurn TransferOptimizer::correction(KeplerOrbit current, double time, double arrival_time)
+    {
+        Vector3 position, velocity, departure_velocity, arrival_velocity;
+
+        current.state_at(time, position, velocity);
+
+        if (!lambert(position, m_target.position_at(arrival_time), arrival_time - time, current.gravitational_parameter(), current.normal(), departure_velocity, arrival_velocity))
+        {
+            return burn(time, position, velocity, Vector3(0, 0, 0));
+        }
+
+        return burn(time, position, velocity, departure_velocity - velocity);
+    }
+
+    /* Compass search over departure and flight time, and the split for broken-plane plans. */
+    TransferPlan TransferOptimizer::refine(TransferPlan plan, double start, double departure_step, double flight_time_step)
+    {
+        if (!std::isfinite(plan.delta_v))
+        {
+            return plan;
+        }
+
+        auto split = plan.break_fraction > 0;
+        double point[4] = {plan.departure_time, plan.arrival_time - plan.departure_time, plan.break_fraction, plan.plane_change_fraction};
+        double steps[4] = {departure_step / 2, flight_time_step / 2, 0.05, 0.125};
+        double lower[4] = {start + lead_time, 1.0, 0.05, 0.0};
+        double upper[4] = {INFINITY, INFINITY, 0.98, 1.0};
+        auto dimensions = split ? 4 : 2;
+
+        for (int i = 0; i < refine_iterations; i++)
+        {
+            auto improved = false;
+
+            for (int d = 0; d < dimensions; d++)
+            {
+                for (auto sign : {1.0, -1.0})
+                {
+                    double trial[4] = {point[0], point[1], point[2], point[3]};
+                    trial[d] = std::clamp(point[d] + sign * steps[d], lower[d], upper[d]);
+
+                    auto candidate = evaluate(trial[0], trial[1], split ? trial[2] : 0.0, trial[3]);
+
+                    evaluated_plans++;
+
+                    if (candidate.delta_v < plan.delta_v)
+                    {
+                        plan = candidate;
+                        std::copy(trial, trial + 4, point);
+                        improved = true;
+                    }
+                }
+            }
+
+            if (!improved)
+            {
+                for (auto& step : steps)
+                {
+                    step /= 2;
+                }
+
+                if (steps[0] < 1e-2 && steps[1] < 1e-2)
+                {
+                    break;
+                }
+            }
+        }
+
+        return plan;
+    }
+
+    /* Node axes as kRPC orients them: normal along the angular momentum, radial outwards. */
+    TransferBurn TransferOptimizer::burn(double time, Vector3 position, Vector3 velocity, Vector3 delta_v)
+    {
+        auto prograde = velocity.normalize();
+        auto normal = velocity.cross(position).normalize();
+        auto radial = normal.cross(prograde);
+
+        return {time, delta_v, delta_v.dot(prograde), delta_v.dot(normal), delta_v.dot(radial)};
+    }
+}
@@ -0,0 +1,207 @@
+#pragma once
+
+#include <mutex>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <chrono>
+#include <iostream>
+#include <exception>
+#include <stdexcept>
+#include <functional>
+#include "connection.hpp"
+#include "vessels.hpp"
+#include "io_thread.hpp"
+#include "loop_statistics.hpp"
+
+namespace KSP
+{
+    /**
+     * Control context of one vessel: its own server connection, so its RPCs and streams never
+     * wait behind another vessel's, its actuator queue and control loop statistics. Actuator
+     * writes posted to the queue run on the vessel's own I/O thread, so they do not hold up the
+     * loop either. The connection lives in the context; the context is not copied or moved once
+     * created.
+     */
+    class VesselContext
+    {
+    private:
+        std::mutex m_mutex;
+    public:
+        std::string name;
+        Connection connection;
+        Vessel vessel;
+        /* Actuator queue, e.g. actuators.post([&]() { vessel.control().set_throttle(throttle); }). */
+        IoThread actuators;
+        /* Control loop period in seconds. */
+        double period = 0.02;
+        LoopStatistics statistics;
+    public:
+        VesselContext(std::string name, uint64_t id);
+        ~VesselContext();
+    public:
+        void loop(std::function<bool()> step);
+        void sleep(double seconds);
+        LoopStatistics loop_statistics();
+    };
+
+    /**
+     * Controls N vessels at once. Each vessel runs its own script on its own thread with its own
+     * context, so a slow RPC or a blocking wait for one vessel does not delay the others.
+     */
+    class VesselRuntime
+    {
+    private:
+        VesselRegistry m_registry;
+        std::vector<std::unique_ptr<VesselContext>> m_contexts;
+        std::vector<std::function<void(VesselContext&)>> m_scripts;
+    public:
+        VesselRuntime(Connection& connection);
+        ~VesselRuntime();
+    public:
+        VesselContext& add(std::string name, std::function<void(VesselContext&)> script);
+        VesselContext& context(std::string name);
+        size_t size();
+        void run();
+        void print_statistics();
+    };
+
+    /* The vessel is bound to this context's own connection. */
+    VesselContext::VesselContext(std::string name, uint64_t id) : name(name), vessel(&connection.client, id)
+    {
+    }
+
+    VesselContext::~VesselContext()
+    {
+    }
+
+    /**
+     * Runs step every period until it returns false. Missed ticks are skipped, not caught up.
+     * Returns once the actuator writes posted by the loop have been sent.
+     */
+    void VesselContext::loop(std::function<bool()> step)
+    {
+        auto tick = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(period));
+        auto next = std::chrono::steady_clock::now();
+        auto running = true;
+
+        while (running)
+        {
+            LoopClock clock;
+
+            running = step();
+
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                statistics.add(clock.elapsed(), period);
+            }
+
+            next += tick;
+            auto now = std::chrono::steady_clock::now();
+
+            if (next < now)
+            {
+                next = now;
+            }
+
+            std::this_thread::sleep_until(next);
+        }
+
+        actuators.flush();
+    }
+
+    /* Fractional seconds, unlike KSP::sleep_seconds. */
+    void VesselContext::sleep(double seconds)
+    {
+        std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+    }
+
+    /* Thread-safe copy of the loop statistics. */
+    LoopStatistics VesselContext::loop_statistics()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return statistics;
+    }
+
+    /* Vessels are looked up on the given connection; each context then opens its own. */
+    VesselRuntime::VesselRuntime(Connection& connection) : m_registry(connection)
+    {
+    }
+
+    VesselRuntime::~VesselRuntime()
+    {
+    }
+
+    /**
+     * Opens a connection for the vessel with the given name. The script runs once run() is called.
+     * Throws std::out_of_range if there is no such vessel.
+     */
+    VesselContext& VesselRuntime::add(std::string name, std::function<void(VesselContext&)> script)
+    {
+        m_contexts.push_back(std::make_unique<VesselContext>(name, m_registry.get(name)._id));
+        m_scripts.push_back(script);
+
+        return *m_contexts.back();
+    }
+
+    VesselContext& VesselRuntime::context(std::string name)
+    {
+        for (auto& context : m_contexts)
+        {
+            if (context->name == name)
+            {
+                return *context;
+            }
+        }
+
+        throw std::out_of_range("No vessel context named '" + name + "'");
+    }
+
+    size_t VesselRuntime::size()
+    {
+        return m_contexts.size();
+    }
+
+    /* Runs every script on its own thread until all have returned. Rethrows the first script exception. */
+    void VesselRuntime::run()
+    {
+        std::vector<std::thread> threads;
+        std::vector<std::exception_ptr> exceptions(m_contexts.size());
+
+        for (size_t i = 0; i < m_contexts.size(); i++)
+        {
+            threads.emplace_back([this, i, &exceptions]() {
+                try
+                {
+                    m_scripts[i](*m_contexts[i]);
+                }
+                catch (...)
+                {
+                    exceptions[i] = std::current_exception();
+                }
+            });
+        }
+
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
+
+        for (auto& exception : exceptions)
+        {
+            if (exception)
+            {
+                std::rethrow_exception(exception);
+            }
+        }
+    }
+
+    void VesselRuntime::print_statistics()
+    {
+        for (auto& context : m_contexts)
+        {
+            std::cout << context->name << ": " << context->loop_statistics() << std::endl;
+        }
+    }
+}
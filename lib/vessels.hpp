@@ -1,24 +1,163 @@
 #pragma once
 
+#include <atomic>
+#include <string>
+#include <vector>
+#include <optional>
+#include <stdexcept>
+#include <unordered_map>
 #include "connection.hpp"
 #include "enums/types.hpp"
 
 namespace KSP
 {
-    KSP::Vessel get_vessel_by_name(std::string name, KSP::Connection connection)
+    /**
+     * Vessels by name and ID. Vessel IDs come from one stream of the vessel list. A vessel's name
+     * is fetched once, when it first appears, so a lookup costs no RPCs. New vessels from
+     * launching, decoupling or undocking are picked up on the next lookup after the stream
+     * reports them. If several vessels share a name, the one with the lowest kRPC object handle
+     * (_id) is found. That choice is stable within a session, but handles say nothing about which
+     * vessel is older, so use find(id) when names can clash.
+     * The registry registers a stream callback on itself and must not be copied or moved.
+     */
+    class VesselRegistry
     {
-        auto vessels = connection.space_center.vessels();
+    private:
+        krpc::Stream<std::vector<Vessel>> m_vessels_stream;
+        int m_callback;
+        std::atomic<bool> m_changed;
+        std::unordered_map<uint64_t, std::pair<Vessel, std::string>> m_by_id;
+        std::unordered_map<std::string, uint64_t> m_by_name;
+    public:
+        VesselRegistry(Connection& connection);
+        VesselRegistry(const VesselRegistry&) = delete;
+        ~VesselRegistry();
+    public:
+        std::optional<Vessel> find(std::string name);
+        std::optional<Vessel> find(uint64_t id);
+        Vessel get(std::string name);
+        std::optional<std::string> name(uint64_t id);
+        size_t size();
+        void refresh();
+        void reload();
+    };
 
-        for (auto vessel : vessels)
+    VesselRegistry::VesselRegistry(Connection& connection)
+        : m_vessels_stream(connection.space_center.vessels_stream()), m_changed(true)
+    {
+        m_callback = m_vessels_stream.add_callback([this](const std::vector<Vessel>&) { m_changed = true; });
+        refresh();
+    }
+
+    VesselRegistry::~VesselRegistry()
+    {
+        m_vessels_stream.remove_callback(m_callback);
+    }
+
+    std::optional<Vessel> VesselRegistry::find(std::string name)
+    {
+        refresh();
+
+        auto found = m_by_name.find(name);
+
+        if (found == m_by_name.end())
+        {
+            return std::nullopt;
+        }
+
+        return m_by_id.at(found->second).first;
+    }
+
+    std::optional<Vessel> VesselRegistry::find(uint64_t id)
+    {
+        refresh();
+
+        auto found = m_by_id.find(id);
+
+        if (found == m_by_id.end())
+        {
+            return std::nullopt;
+        }
+
+        return found->second.first;
+    }
+
+    /* Throws std::out_of_range if there is no vessel with the name. */
+    Vessel VesselRegistry::get(std::string name)
+    {
+        auto vessel = find(name);
+
+        if (!vessel)
+        {
+            throw std::out_of_range("Vessel '" + name + "' not found");
+        }
+
+        return *vessel;
+    }
+
+    std::optional<std::string> VesselRegistry::name(uint64_t id)
+    {
+        refresh();
+
+        auto found = m_by_id.find(id);
+
+        if (found == m_by_id.end())
+        {
+            return std::nullopt;
+        }
+
+        return found->second.second;
+    }
+
+    size_t VesselRegistry::size()
+    {
+        refresh();
+        return m_by_id.size();
+    }
+
+    /* Only does work when the vessel list changed: one name RPC per new vessel. */
+    void VesselRegistry::refresh()
+    {
+        if (!m_changed.exchange(false))
+        {
+            return;
+        }
+
+        std::unordered_map<uint64_t, std::pair<Vessel, std::string>> by_id;
+
+        for (auto vessel : m_vessels_stream())
         {
-            if (vessel.name() == name)
+            auto known = m_by_id.find(vessel._id);
+
+            if (known != m_by_id.end())
             {
-                return vessel;
+                by_id.insert(*known);
+            }
+            else
+            {
+                by_id.insert(std::make_pair(vessel._id, std::make_pair(vessel, vessel.name())));
             }
         }
 
-        std::cout << "Vessel '" << name << "' not found, using active vessel instead.";
+        m_by_id.swap(by_id);
+        m_by_name.clear();
+
+        for (auto& [id, entry] : m_by_id)
+        {
+            auto [found, inserted] = m_by_name.insert(std::make_pair(entry.second, id));
 
-        return connection.space_center.active_vessel();
+            if (!inserted && id < found->second)
+            {
+                found->second = id;
+            }
+        }
+    }
+
+    /* Fetches every name again, e.g. after vessels were renamed. */
+    void VesselRegistry::reload()
+    {
+        m_by_id.clear();
+        m_changed = true;
+        refresh();
     }
-}
\ No newline at end of file
+}
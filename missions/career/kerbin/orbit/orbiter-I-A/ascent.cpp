@@ -1,7 +1,10 @@
 #include "../../../../../lib/ksp.hpp"
 
+/* Usage: ascent [ascent table], where the table defaults to ascent-table.bin in the working directory. */
 int main(int argc, char const *argv[])
 {
+    auto table_path = argc > 1 ? std::string(argv[1]) : std::string("ascent-table.bin");
+
     /* Automatically connects to the server with the given IP address. */
     auto connection = KSP::Connection();
     auto vessel = connection.space_center.active_vessel();
@@ -81,6 +84,12 @@ int main(int argc, char const *argv[])
     /* Create launcher. */
     KSP::Launcher launcher(vessel, resources);
 
+    /*
+     * Fly the optimised program from tools/ascent_optimizer if this vessel has one for this target,
+     * otherwise the standard turn.
+     */
+    launcher.load_table(table_path, target_apoapsis);
+
     /* Set auto pilot variables. */
     vessel.auto_pilot().target_pitch_and_heading(90, 90);
     vessel.auto_pilot().engage();
@@ -93,7 +102,7 @@ int main(int argc, char const *argv[])
     {
         auto current_altitude = altitude_stream();
 
-        launcher.step(current_stage_stream(), current_altitude, vertical_speed_stream());
+        launcher.step(current_stage_stream(), current_altitude, vertical_speed_stream(), apoapsis_stream());
 
         /* Use Science Jr. while flying high. */
         if (current_altitude > upper_atmosphere_altitude)
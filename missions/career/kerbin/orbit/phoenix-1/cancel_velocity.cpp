@@ -14,11 +14,15 @@ int main(int argc, char const *argv[])
     auto vessel_reference_frame = vessel.orbital_reference_frame();
     auto orbit_reference_frame = body_reference_frame.create_hybrid(connection.client, body_reference_frame, vessel_reference_frame);
 
-    auto t_approach = orbit.time_of_closest_approach(target_orbit);
+    /* Next closest approach, found locally from both orbits' elements. */
+    auto finder = KSP::ClosestApproachFinder(KSP::kepler_orbit(orbit), KSP::kepler_orbit(target_orbit));
+    auto approach = finder.next(connection.space_center.ut());
+    auto t_approach = approach.time;
+
+    std::cout << "CLOSEST APPROACH: " << approach.distance << " m in " << t_approach - connection.space_center.ut() << " s" << std::endl;
+
     auto position = orbit.position_at(t_approach, body_reference_frame);
     auto eccentric_anomaly_difference = abs(orbit.eccentric_anomaly() - orbit.eccentric_anomaly_at_ut(t_approach));
-    auto velocity = KSP::velocity_at(orbit, t_approach);
-    auto velocity_target = KSP::velocity_at(target_orbit, t_approach);
 
     /**
      * Rotate the vessel orbital reference frame around the normal direction so
@@ -31,7 +35,7 @@ int main(int argc, char const *argv[])
         {0.0, 0.0, 0.0},
         {0.0, 0.0, -eccentric_anomaly_difference, 1.0}
     );
-    auto relative_retrograde = KSP::Vector3(connection.space_center.transform_direction((velocity_target - velocity).to_tuple(), body_reference_frame, conversion_reference_frame));
+    auto relative_retrograde = KSP::Vector3(connection.space_center.transform_direction(approach.relative_velocity.to_tuple(), body_reference_frame, conversion_reference_frame));
     // auto node = vessel.control().add_node(t_approach, relative_retrograde.m_y, relative_retrograde.m_z, relative_retrograde.m_x);
     // auto executor = KSP::NodeExecutor(node, vessel);
 
@@ -57,22 +61,18 @@ int main(int argc, char const *argv[])
     vessel.auto_pilot().set_reference_frame(vessel_reference_frame);
     vessel.auto_pilot().engage();
 
-    while (ut_stream() <= burn_start)
-    {
-        vessel.auto_pilot().set_target_direction((KSP::Vector3(vessel.velocity(target_vessel.orbital_reference_frame())) * -1).to_tuple());
-        KSP::sleep_milliseconds(10);
-    }
+    /* Throttle up and cut off on time, steering relative retrograde until the burn is done. */
+    KSP::Scheduler scheduler;
+    scheduler.at(burn_start, [&vessel, throttle]() { vessel.control().set_throttle(throttle); });
+    scheduler.at(burn_stop, [&vessel]() { vessel.control().set_throttle(0); });
 
-    vessel.control().set_throttle(throttle);
-
-    while (ut_stream() <= burn_stop)
+    while (!scheduler.empty())
     {
         vessel.auto_pilot().set_target_direction((KSP::Vector3(vessel.velocity(target_vessel.orbital_reference_frame())) * -1).to_tuple());
-        KSP::sleep_milliseconds(10);
+        scheduler.run_due(ut_stream());
+        scheduler.sleep_until_next(ut_stream(), 0.01);
     }
 
-    vessel.control().set_throttle(0);
-
     throttle = 0.05;
     relative_speed = vessel.flight(target_vessel.orbital_reference_frame()).speed();
     burn_time = KSP::get_burn_time(vessel, relative_speed, throttle);
@@ -86,12 +86,12 @@ int main(int argc, char const *argv[])
     burn_stop = burn_start + burn_time;
 
     vessel.control().set_throttle(throttle);
+    scheduler.at(burn_stop, [&vessel]() { vessel.control().set_throttle(0); });
 
-    while (ut_stream() <= burn_stop)
+    while (!scheduler.empty())
     {
         vessel.auto_pilot().set_target_direction((KSP::Vector3(vessel.velocity(target_vessel.orbital_reference_frame())) * -1).to_tuple());
-        KSP::sleep_milliseconds(10);
+        scheduler.run_due(ut_stream());
+        scheduler.sleep_until_next(ut_stream(), 0.01);
     }
-
-    vessel.control().set_throttle(0);
 }
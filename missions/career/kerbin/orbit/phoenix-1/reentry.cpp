@@ -7,13 +7,13 @@ int main(int argc, char const *argv[])
     auto vessel = connection.space_center.active_vessel();
 
     /* Reference frames. */
-    auto surface_reference_frame = vessel.surface_reference_frame();
-    auto orbit_reference_frame = vessel.orbital_reference_frame();
     auto surface_velocity_reference_frame = vessel.surface_velocity_reference_frame();
 
-    /* Targets. */
+    /* Targets: the landing zone is the space center. */
     auto parachute_altitude = 1500;
     auto periapsis_target = 40000;
+    auto target_latitude = -0.0972;
+    auto target_longitude = -74.5577;
     auto retrograde_direction = KSP::Vector3(0, -1, 0);
     auto normal_direction = KSP::Vector3(0, 0, 1);
     auto radial_direction = KSP::Vector3(1, 0, 0);
@@ -23,40 +23,14 @@ int main(int argc, char const *argv[])
     KSP::wait_for_user();
     KSP::sleep_seconds(5);
 
-    /* Event for opening the parachute. */
-    auto periapsis_altitude_call = vessel.orbit().periapsis_altitude_call();
-    auto periapsis_event = connection.krpc.add_event(
-        KSP::Expression::less_than_or_equal(
-            connection.client,
-            KSP::Expression::call(connection.client, periapsis_altitude_call),
-            KSP::Expression::constant_double(connection.client, periapsis_target)
-        )
-    );
+    /* Capsule with heat shield and parachute; the drag area is refined from the measured drag. */
+    auto maneuver = KSP::Maneuver(connection, vessel);
+    auto predictor = KSP::ReentryPredictor(1250, 1.2);
 
-    /* Event for opening the parachute. */
-    auto surface_altitude_call = vessel.flight(surface_reference_frame).surface_altitude_call();
-    auto parachute_event = connection.krpc.add_event(
-        KSP::Expression::less_than_or_equal(
-            connection.client,
-            KSP::Expression::call(connection.client, surface_altitude_call),
-            KSP::Expression::constant_double(connection.client, parachute_altitude)
-        )
-    );
+    /* Burn retrograde until the predicted impact is on the landing zone. */
+    maneuver.deorbit_to(target_latitude, target_longitude, periapsis_target, predictor);
 
-    /* Target retrograde. */
-    vessel.auto_pilot().set_reference_frame(orbit_reference_frame);
-    vessel.auto_pilot().set_target_direction(retrograde_direction.to_tuple());
-    vessel.auto_pilot().engage();
-    KSP::sleep_seconds(5);
-
-    /* Burn retrograde and wait for periapsis to drop to target. */
-    vessel.control().set_throttle(1.0);
-    periapsis_event.acquire();
-    periapsis_event.wait();
-    periapsis_event.release();
-
-    /* Cut throttle and decouple service module. */
-    vessel.control().set_throttle(0.0);
+    /* Decouple service module. */
     KSP::sleep_seconds(1);
     vessel.auto_pilot().set_target_direction(normal_direction.to_tuple());
     KSP::sleep_seconds(5);
@@ -67,10 +41,8 @@ int main(int argc, char const *argv[])
     vessel.auto_pilot().set_reference_frame(surface_velocity_reference_frame);
     vessel.auto_pilot().set_target_direction(retrograde_direction.to_tuple());
 
-    /* Wait until parachute deploy. */
-    parachute_event.acquire();
-    parachute_event.wait();
-    parachute_event.release();
+    /* Follow the predicted impact until parachute deploy. */
+    maneuver.descend_to(target_latitude, target_longitude, parachute_altitude, predictor);
 
     /* Open parachute. */
     vessel.control().activate_next_stage();
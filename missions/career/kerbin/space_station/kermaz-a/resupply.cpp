@@ -0,0 +1,31 @@
+#include "../../../../../lib/ksp.hpp"
+
+int main(int argc, char const *argv[])
+{
+    /* Automatically connects to the server with the given IP address. */
+    auto connection = KSP::Connection();
+    auto vessel = connection.space_center.active_vessel();
+    auto station = connection.space_center.target_vessel();
+    auto maneuver = KSP::Maneuver(connection, vessel);
+
+    /* Match inclination to the station. */
+    maneuver.change_inclination(station);
+    KSP::sleep_seconds(5);
+
+    /* Cheapest transfer that reaches the station within one Kerbin day. */
+    maneuver.transfer_to_vessel(station, 21600.0);
+    KSP::sleep_seconds(5);
+
+    /* Coast to the closest approach. */
+    auto finder = KSP::ClosestApproachFinder(KSP::kepler_orbit(vessel.orbit()), KSP::kepler_orbit(station.orbit()));
+    auto approach = finder.next(connection.space_center.ut());
+    connection.space_center.warp_to(approach.time - 60);
+
+    /* Approach to 100m behind the station, for docking. */
+    KSP::Rendezvous rendezvous(connection, vessel, station);
+    rendezvous.hold_position = KSP::Vector3(0, -100, 0);
+    rendezvous.throttle = 0.05;
+    rendezvous.execute();
+
+    vessel.control().set_throttle(0);
+}
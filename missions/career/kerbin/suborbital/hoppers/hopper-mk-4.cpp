@@ -23,14 +23,8 @@ int main(int argc, char const *argv[])
     auto altitude_stream = vessel.flight().mean_altitude_stream();
 
     /* Event for opening the parachute. */
-    auto surface_altitude_call = vessel.flight(reference_frame).surface_altitude_call();
-    auto parachute_event = connection.krpc.add_event(
-        KSP::Expression::less_than_or_equal(
-            connection.client,
-            KSP::Expression::call(connection.client, surface_altitude_call),
-            KSP::Expression::constant_double(connection.client, parachute_altitude)
-        )
-    );
+    auto surface_altitude = KSP::Quantity(connection, vessel.flight(reference_frame).surface_altitude_call());
+    auto parachute_trigger = (surface_altitude <= parachute_altitude).trigger(connection);
 
     /* Resources. */
     std::unordered_map<int32_t, krpc::Stream<float>> resource_stream_map;
@@ -78,9 +72,7 @@ int main(int argc, char const *argv[])
     }
 
     /* Wait until parachute deploy. */
-    parachute_event.acquire();
-    parachute_event.wait();
-    parachute_event.release();
+    parachute_trigger.wait();
 
     /* Open parachute. */
     vessel.control().activate_next_stage();
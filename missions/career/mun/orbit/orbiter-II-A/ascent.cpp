@@ -1,9 +1,7 @@
 #include "../../../../../lib/ksp.hpp"
 
-int main(int argc, char const *argv[])
+KSP::Task ascent(KSP::Connection connection)
 {
-    /* Automatically connects to the server with the given IP address. */
-    auto connection = KSP::Connection();
     auto vessel = connection.space_center.active_vessel();
     auto body = vessel.orbit().body();
     auto mun = connection.get_body(KSP::bodies::MUN);
@@ -14,10 +12,11 @@ int main(int argc, char const *argv[])
     auto orbit_reference_frame = vessel.orbital_reference_frame();
 
     /* Targets. */
-    auto parachute_altitude = 1500;
     auto upper_atmosphere_altitude = body.flying_high_altitude_threshold();
     auto space_altitude = body.atmosphere_depth();
     auto target_apoapsis = space_altitude + 5000;
+    /* Guidance ignores drag, so it only takes over in the thin upper atmosphere. */
+    auto guidance_altitude = 35000;
     auto prograde_direction = KSP::Vector3(0, 1, 0);
     auto periapsis_target = 15000;
     auto retrograde_direction = KSP::Vector3(0, -1, 0);
@@ -28,55 +27,6 @@ int main(int argc, char const *argv[])
     auto altitude_stream = vessel.flight().mean_altitude_stream();
     auto apoapsis_stream = vessel.orbit().apoapsis_altitude_stream();
 
-    /* Event for opening the parachute. */
-    auto surface_altitude_call = vessel.flight(surface_reference_frame).surface_altitude_call();
-    auto parachute_event = connection.krpc.add_event(
-        KSP::Expression::less_than_or_equal(
-            connection.client,
-            KSP::Expression::call(connection.client, surface_altitude_call),
-            KSP::Expression::constant_double(connection.client, parachute_altitude)
-        )
-    );
-
-    /* Event for being out of the atmosphere. */
-    auto altitude_call = vessel.flight().mean_altitude_call();
-    auto out_of_atmosphere_event = connection.krpc.add_event(
-        KSP::Expression::greater_than(
-            connection.client,
-            KSP::Expression::call(connection.client, altitude_call),
-            KSP::Expression::constant_double(connection.client, space_altitude)
-        )
-    );
-
-    /* Event for being near apoapsis. */
-    auto time_to_apoapsis_call = vessel.orbit().time_to_apoapsis_call();
-    auto apoapsis_reached_event = connection.krpc.add_event(
-        KSP::Expression::less_than(
-            connection.client,
-            KSP::Expression::call(connection.client, time_to_apoapsis_call),
-            KSP::Expression::constant_double(connection.client, 8.0)
-        )
-    );
-
-    /* Event for circularisation burn. */
-    auto periapsis_call = vessel.orbit().periapsis_altitude_call();
-    auto apoapsis_call = vessel.orbit().periapsis_altitude_call();
-    auto circularisation_event = connection.krpc.add_event(
-        KSP::Expression::and_(
-            connection.client,
-            KSP::Expression::greater_than(
-                connection.client,
-                KSP::Expression::call(connection.client, periapsis_call),
-                KSP::Expression::constant_double(connection.client, space_altitude)
-            ),
-            KSP::Expression::greater_than(
-                connection.client,
-                KSP::Expression::call(connection.client, apoapsis_call),
-                KSP::Expression::constant_double(connection.client, space_altitude)
-            )
-        )
-    );
-
     /* Resources. */
     KSP::ResourcesMap resources;
     resources.insert(std::make_pair(4, vessel.resources_in_decouple_stage(3, false).amount_stream(KSP::resources::SOLID_FUEL)));
@@ -85,6 +35,9 @@ int main(int argc, char const *argv[])
     /* Create launcher. */
     KSP::Launcher launcher(vessel, resources);
 
+    /* Closed-loop pitch in the upper atmosphere, for less delta-v than the turn; see benchmarks/ascent_guidance.cpp. */
+    launcher.enable_guidance(target_apoapsis, guidance_altitude);
+
     /* Set auto pilot variables. */
     vessel.auto_pilot().target_pitch_and_heading(90, 90);
     vessel.auto_pilot().engage();
@@ -99,49 +52,64 @@ int main(int argc, char const *argv[])
 
         launcher.step(current_stage_stream(), current_altitude, vertical_speed_stream());
 
-        KSP::sleep_milliseconds(20);
+        co_await KSP::sleep_for(0.02);
     }
 
     /* Cut throttle and coast until out of atmosphere. */
     vessel.control().set_throttle(0.0);
-    out_of_atmosphere_event.acquire();
-    out_of_atmosphere_event.wait();
-    out_of_atmosphere_event.release();
-    KSP::sleep_seconds(2);
+    co_await KSP::altitude_above(connection, vessel, space_altitude);
+    co_await KSP::sleep_for(2);
 
     /* Create and execute circularisation maneuver node. */
     auto maneuver = KSP::Maneuver(connection, vessel);
     maneuver.cicularize(true);
     KSP::sleep_seconds(1);
 
-    /* Change inclination to match the Mun's. */
-    maneuver.change_inclination(mun);
+    /* Transfer to the Mun, matching its inclination on the way. */
+    maneuver.transfer_to_body_with_plane_change(mun);
     KSP::sleep_seconds(1);
 
-    /* Transfer to the Mun. */
-    maneuver.transfer_to_body(mun);
-    KSP::sleep_seconds(1);
+    /* Burn for the Mun periapsis, found from a local patched-conic prediction before burning. */
+    /* The bodies and the stage layout come from the metadata cache after the first flight. */
+    KSP::MetadataCache metadata(connection, "orbiter-II-A.cache");
+    KSP::PatchedConicPredictor predictor(metadata.conic_bodies());
+    auto kerbin_index = predictor.body_index(body.name());
+    auto mun_index = predictor.body_index(KSP::bodies::MUN);
+    auto burn_time = connection.space_center.ut() + 120;
+    auto correction = predictor.prograde_for_periapsis(kerbin_index, KSP::kepler_orbit(vessel.orbit()), burn_time, mun_index, mun.equatorial_radius() + periapsis_target, -50.0, 50.0, 86400.0);
+
+    if (std::isfinite(correction))
+    {
+        auto node = vessel.control().add_node(burn_time, correction);
+        auto node_executor = KSP::NodeExecutor(node, vessel, &metadata);
+        node_executor.execute(connection, 0.1);
+        co_return;
+    }
+
+    /* No burn within the search range reaches the target, so burn while watching the server's prediction instead. */
+    std::cout << "No predicted correction, burning retrograde for the Mun periapsis" << std::endl;
 
-    /* Periapsis event for Mun. */
-    auto periapsis_altitude_call = vessel.orbit().next_orbit().periapsis_altitude_call();
-    auto periapsis_event = connection.krpc.add_event(
-        KSP::Expression::greater_than(
-            connection.client,
-            KSP::Expression::call(connection.client, periapsis_altitude_call),
-            KSP::Expression::constant_double(connection.client, periapsis_target)
-        )
-    );
+    /* Periapsis at the Mun. */
+    auto mun_periapsis = KSP::Quantity(connection, vessel.orbit().next_orbit().periapsis_altitude_call());
 
     /* Target retrograde. */
     vessel.auto_pilot().set_reference_frame(orbit_reference_frame);
     vessel.auto_pilot().set_target_direction(retrograde_direction.to_tuple());
     vessel.auto_pilot().engage();
-    KSP::sleep_seconds(5);
+    co_await KSP::sleep_for(5);
 
     /* Burn retrograde and wait for periapsis to drop to target. */
     vessel.control().set_throttle(0.1);
-    periapsis_event.acquire();
-    periapsis_event.wait();
-    periapsis_event.release();
+    co_await KSP::until((mun_periapsis > periapsis_target).trigger(connection));
     vessel.control().set_throttle(0.0);
+}
+
+int main(int argc, char const *argv[])
+{
+    /* Automatically connects to the server with the given IP address. */
+    auto connection = KSP::Connection();
+    KSP::Executor executor;
+
+    executor.spawn(ascent(connection));
+    executor.run();
 }
\ No newline at end of file
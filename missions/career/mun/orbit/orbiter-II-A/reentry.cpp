@@ -1,38 +1,57 @@
-#include "../../../../../lib/ksp.hpp"
+#include <iostream>
+#include "../../../../../lib/telemetry.hpp"
 
-int main(int argc, char const *argv[])
+/* A full command ring empties within a daemon tick, so retry for a second before giving up. */
+bool send(std::function<bool()> command)
 {
-    /* Automatically connects to the server with the given IP address. */
-    auto connection = KSP::Connection();
-    auto vessel = connection.space_center.active_vessel();
+    for (int attempt = 0; attempt < 100; attempt++)
+    {
+        if (command())
+        {
+            return true;
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    return false;
+}
 
-    /* Reference frames. */
-    auto surface_reference_frame = vessel.surface_reference_frame();
-    auto surface_velocity_reference_frame = vessel.surface_velocity_reference_frame();
+int main(int argc, char const *argv[])
+{
+    /* Telemetry and commands go through ksp_daemon, so this phase starts without connecting. */
+    auto daemon = KSP::TelemetryClient();
 
     /* Targets. */
     auto parachute_altitude = 1500;
     auto retrograde_direction = KSP::Vector3(0, -1, 0);
-
-    /* Event for opening the parachute. */
-    auto surface_altitude_call = vessel.flight(surface_reference_frame).surface_altitude_call();
-    auto parachute_event = connection.krpc.add_event(
-        KSP::Expression::less_than_or_equal(
-            connection.client,
-            KSP::Expression::call(connection.client, surface_altitude_call),
-            KSP::Expression::constant_double(connection.client, parachute_altitude)
-        )
-    );
+    /* From the edge of the atmosphere to the parachute altitude takes a few minutes. */
+    auto descent_timeout = 1800.0;
 
     /* Orient spacecraft towards surface retrograde. */
-    vessel.auto_pilot().set_reference_frame(surface_velocity_reference_frame);
-    vessel.auto_pilot().set_target_direction(retrograde_direction.to_tuple());
+    if (!send([&]() { return daemon.set_target_direction(KSP::FRAME_SURFACE_VELOCITY, retrograde_direction); }))
+    {
+        std::cout << "Could not point retrograde: the daemon is not taking commands." << std::endl;
+        return 1;
+    }
 
     /* Wait until parachute deploy. */
-    parachute_event.acquire();
-    parachute_event.wait();
-    parachute_event.release();
+    try
+    {
+        daemon.wait_until([&](const KSP::TelemetrySnapshot& telemetry) {
+            return telemetry[KSP::TELEMETRY_SURFACE_ALTITUDE] <= parachute_altitude;
+        }, descent_timeout);
+    }
+    catch (const std::runtime_error& error)
+    {
+        std::cout << "Parachute not deployed: " << error.what() << std::endl;
+        return 1;
+    }
 
     /* Open parachute. */
-    vessel.control().activate_next_stage();
-}
\ No newline at end of file
+    if (!send([&]() { return daemon.activate_next_stage(); }))
+    {
+        std::cout << "Could not open the parachute: the daemon is not taking commands." << std::endl;
+        return 1;
+    }
+}
@@ -1,9 +1,7 @@
 #include "../../../../../lib/ksp.hpp"
 
-int main(int argc, char const *argv[])
+KSP::Task ascent(KSP::Connection connection)
 {
-    /* Automatically connects to the server with the given IP address. */
-    auto connection = KSP::Connection();
     auto vessel = connection.space_center.active_vessel();
     auto body = vessel.orbit().body();
     auto mun = connection.get_body(KSP::bodies::MUN);
@@ -24,16 +22,6 @@ int main(int argc, char const *argv[])
     auto altitude_stream = vessel.flight().mean_altitude_stream();
     auto apoapsis_stream = vessel.orbit().apoapsis_altitude_stream();
 
-    /* Event for being out of the atmosphere. */
-    auto altitude_call = vessel.flight().mean_altitude_call();
-    auto out_of_atmosphere_event = connection.krpc.add_event(
-        KSP::Expression::greater_than(
-            connection.client,
-            KSP::Expression::call(connection.client, altitude_call),
-            KSP::Expression::constant_double(connection.client, space_altitude)
-        )
-    );
-
     /* Resources. */
     KSP::ResourcesMap resources;
     resources.insert(std::make_pair(7, vessel.resources_in_decouple_stage(5, false).amount_stream(KSP::resources::SOLID_FUEL)));
@@ -56,20 +44,28 @@ int main(int argc, char const *argv[])
 
         launcher.step(current_stage_stream(), current_altitude, vertical_speed_stream());
 
-        KSP::sleep_milliseconds(20);
+        co_await KSP::sleep_for(0.02);
     }
 
     /* Cut throttle and coast until out of atmosphere. */
     vessel.control().set_throttle(0.0);
-    out_of_atmosphere_event.acquire();
-    out_of_atmosphere_event.wait();
-    out_of_atmosphere_event.release();
-    KSP::sleep_seconds(1);
+    co_await KSP::altitude_above(connection, vessel, space_altitude);
+    co_await KSP::sleep_for(1);
 
     /* Create and execute circularisation maneuver node. */
     auto maneuver = KSP::Maneuver(connection, vessel);
     maneuver.cicularize(true);
 
     vessel.auto_pilot().set_target_direction(KSP::Vector3(0, 0, 1).to_tuple());
-    KSP::sleep_seconds(5);
+    co_await KSP::sleep_for(5);
+}
+
+int main(int argc, char const *argv[])
+{
+    /* Automatically connects to the server with the given IP address. */
+    auto connection = KSP::Connection();
+    KSP::Executor executor;
+
+    executor.spawn(ascent(connection));
+    executor.run();
 }
\ No newline at end of file
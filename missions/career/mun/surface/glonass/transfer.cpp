@@ -11,7 +11,5 @@ int main(int argc, char const *argv[])
     /* Create and execute circularisation maneuver node. */
     auto maneuver = KSP::Maneuver(connection, vessel);
 
-    maneuver.change_inclination(mun);
-    KSP::sleep_seconds(3);
-    maneuver.transfer_to_body(mun);
+    maneuver.transfer_to_body_with_plane_change(mun);
 }
\ No newline at end of file
@@ -1,30 +1,35 @@
 #include "../../lib/ksp.hpp"
 
-void landing(KSP::Connection connection)
+/* Booster: fall, brake and fly powered descent guidance, then go down at constant speed until landed. */
+void booster_landing(KSP::VesselContext& context)
 {
-    /* Vessels. */
-    auto booster_vessel = KSP::get_vessel_by_name("New Shepard", connection);
-    auto capsule_vessel = KSP::get_vessel_by_name("New Shepard Capsule", connection);
+    auto& connection = context.connection;
+    auto booster_vessel = context.vessel;
 
     /* Reference frames. */
     auto booster_reference_frame_normal = booster_vessel.reference_frame();
     auto booster_reference_frame = booster_vessel.surface_reference_frame();
-    auto capsule_reference_frame = capsule_vessel.surface_reference_frame();
 
     /* Altitude target values. */
     auto dragbrake_altitude = 18000;
-    auto drogue_parachute_altitude = 2000;
-    auto main_parachute_altitude = 1000;
     auto up_vector = KSP::Vector3(1, 0, 0);
 
     /* Hoverslam values. */
-    auto hoverslam_pid = KSP::PID(connection, 0.015, 0.020, 0.0005);
     auto velocity_pid = KSP::PID(connection, 0.30, 0.02, 0.005);
-    auto lander = KSP::Lander(connection);
+    /* Throttle per m/s of speed error falls as the booster lightens, so gains are scheduled on thrust-to-weight. */
+    auto velocity_schedule = KSP::GainSchedule<1>(
+        {std::vector<double>{1.2, 2.0, 3.0, 4.5}},
+        {{0.40, 0.030, 0.008}, {0.30, 0.020, 0.005}, {0.20, 0.013, 0.003}, {0.13, 0.009, 0.002}}
+    );
+    auto descent_guidance = KSP::PoweredDescentGuidance();
     auto constant_speed_target = -1.0;
     auto target_throttle = 0.8;
     auto hoverslam_target = 4;
     auto ship_height = 8.6;
+    auto landing_target = std::make_tuple(0.0, 0.0, 0.0);
+
+    descent_guidance.ignition_throttle = target_throttle;
+    descent_guidance.max_throttle = 0.9;
 
     /* Body values. */
     auto body = booster_vessel.orbit().body();
@@ -41,101 +46,168 @@ void landing(KSP::Connection connection)
     auto booster_vertical_surface_speed_stream = booster_vessel.flight(body_reference_frame).vertical_speed_stream();
     auto booster_surface_velocity_stream = booster_vessel.velocity_stream(body_reference_frame);
     auto booster_drag_stream = booster_vessel.flight(booster_reference_frame).drag_stream();
-    auto capsule_altitude_stream = capsule_vessel.flight(capsule_reference_frame).surface_altitude_stream();
-
-    bool completed_stages[5] = {false};
-
-    booster_vessel.auto_pilot().engage();
-
-    while (capsule_vessel.situation() != KSP::Situation::landed)
-    {
-        /* Dragbrakes deployment event. */
-        if (!completed_stages[0] && booster_altitude_stream() < dragbrake_altitude)
-        {
-            completed_stages[0] = true;
-            booster_vessel.control().set_brakes(true);
-        }
-
-        /* Drogue parachute deployment event. */
-        if (!completed_stages[1] && capsule_altitude_stream() < drogue_parachute_altitude)
-        {
-            completed_stages[1] = true;
-            capsule_vessel.control().set_action_group(2, true);
-        }
-
-        /* Main parachute deployment event. */
-        if (!completed_stages[2] && capsule_altitude_stream() < main_parachute_altitude)
-        {
-            completed_stages[2] = true;
-            capsule_vessel.control().set_action_group(3, true);
-        }
-
-        if (completed_stages[0] && !completed_stages[3] && booster_vertical_surface_speed_stream() < -5)
-        {
-            /* Adjust throttle for hoverslam. */
-            auto throttle = lander.vertical_hoverslam_throttle(
-                hoverslam_pid,
-                body,
+    auto booster_isp_stream = booster_vessel.specific_impulse_stream();
+
+    /* Altitude for server-side triggers. */
+    auto booster_altitude = KSP::Quantity(connection, booster_vessel.flight().mean_altitude_call());
+
+    /* Client-side attitude control, faster than re-targeting the server autopilot. */
+    KSP::AttitudeController booster_attitude(booster_vessel, booster_reference_frame, 50.0);
+
+    /* Actuator writes go through the booster's queue so the guidance ticks do not wait on them. */
+    auto set_throttle = [&](double throttle) { context.actuators.post([&booster_vessel, throttle]() { booster_vessel.control().set_throttle(throttle); }); };
+
+    KSP::StateMachine booster("BOOSTER", "falling");
+
+    booster.state("falling")
+        .transition_on("powered_descent", [&]() { return (booster_altitude < dragbrake_altitude).trigger(connection); });
+
+    booster.state("powered_descent")
+        .on_entry([&]() {
+            context.actuators.post([&booster_vessel]() { booster_vessel.control().set_brakes(true); });
+
+            /* Land straight below, fixed to the rotating body. */
+            auto ship_altitude = booster_surface_altitude_stream() - ship_height - hoverslam_target;
+            landing_target = connection.space_center.transform_position(KSP::Vector3(-ship_altitude, 0, 0).to_tuple(), booster_reference_frame, body_reference_frame);
+        })
+        .on_tick([&]() {
+            /* Re-solve powered-descent guidance to the landing target every tick. */
+            auto surface_velocity = KSP::Vector3(connection.space_center.transform_direction(booster_surface_velocity_stream(), body_reference_frame, booster_reference_frame));
+            auto relative_position = KSP::Vector3(connection.space_center.transform_position(landing_target, body_reference_frame, booster_reference_frame)) * -1;
+            auto gravity = up_vector * -KSP::get_g_at_altitude(body, booster_altitude_stream());
+            auto command = descent_guidance.solve(
+                relative_position,
+                surface_velocity,
+                KSP::Vector3(constant_speed_target, 0, 0),
+                gravity,
                 booster_mass_stream(),
-                booster_altitude_stream(),
-                booster_surface_altitude_stream(),
-                booster_surface_speed_stream(),
-                ship_height,
-                hoverslam_target,
-                booster_available_thrust_stream() * target_throttle,
-                KSP::Vector3(booster_drag_stream()).m_x
+                booster_available_thrust_stream(),
+                booster_isp_stream(),
+                KSP::Vector3(booster_drag_stream())
             );
 
-            booster_vessel.control().set_throttle(throttle);
+            set_throttle(command.throttle);
 
-            /* Target surface retrograde until above 10 m/s down. */
-            if (booster_vertical_surface_speed_stream() < -15)
-            {
-                booster_vessel.auto_pilot().set_target_direction((KSP::Vector3(connection.space_center.transform_direction(booster_surface_velocity_stream(), body_reference_frame, booster_reference_frame)) * -1).to_tuple());
-            }
-            else
+            /* Target surface retrograde until the burn starts, then the guidance thrust direction. */
+            booster_attitude.set_target_direction(command.engaged ? command.direction : surface_velocity * -1);
+
+            if (booster_vertical_surface_speed_stream() > -15)
             {
-                booster_vessel.control().set_gear(true);
-                booster_vessel.auto_pilot().set_target_direction(up_vector.to_tuple());
+                context.actuators.post([&booster_vessel]() { booster_vessel.control().set_gear(true); });
             }
-        }
-        else if (completed_stages[0] && !completed_stages[3])
-        {
-            completed_stages[3] = true;
-            booster_vessel.control().set_throttle(0.10);
-            velocity_pid.start();
-        }
+        })
+        .transition("constant_speed", [&]() { return booster_vertical_surface_speed_stream() >= -5; });
 
-        /* Go down with a constant velocity. */
-        if (completed_stages[3] && !completed_stages[4] && booster_vessel.situation() != krpc::services::SpaceCenter::VesselSituation::landed)
-        {
+    booster.state("constant_speed")
+        .on_entry([&]() {
+            set_throttle(0.10);
+            velocity_pid.derivative_filter = 0.1;
+            velocity_pid.start();
+        })
+        .on_tick([&]() {
+            /* Go down with a constant velocity. */
             auto vertical_speed = booster_vertical_surface_speed_stream();
-            auto surface_altitude = booster_surface_altitude_stream();
             auto ship_up = KSP::Vector3(connection.space_center.transform_direction(KSP::Vector3(0, 1, 0).to_tuple(), booster_reference_frame_normal, booster_reference_frame));
-            auto throttle_control = -(vertical_speed - constant_speed_target - 2.066) * KSP::get_g_at_altitude(body, booster_altitude_stream()) * booster_mass_stream() / (2 * booster_available_thrust_stream());
+            auto g = KSP::get_g_at_altitude(body, booster_altitude_stream());
+            auto hover_throttle = g * booster_mass_stream() / std::max<double>(1.0, booster_available_thrust_stream());
+
+            /* Hover throttle feed-forward plus a scheduled PID on vertical speed. */
+            velocity_pid.set_gains(velocity_schedule.gains({1 / hover_throttle}));
+            velocity_pid.set_output_limits(-hover_throttle, 1 - hover_throttle);
+            auto throttle_control = hover_throttle + velocity_pid.step(constant_speed_target, vertical_speed);
 
             auto horizontal_correction = cos(ship_up.angle_3d(up_vector));
             auto surface_velocity = KSP::Vector3(connection.space_center.transform_direction(booster_surface_velocity_stream(), body_reference_frame, booster_reference_frame));
             auto desired_velocity = KSP::Vector3(constant_speed_target, 0, 0);
             auto delta_velocity = desired_velocity - surface_velocity;
-            auto target_vector = up_vector * KSP::get_g_at_altitude(body, booster_altitude_stream()) + delta_velocity;
+            auto target_vector = up_vector * g + delta_velocity;
 
-            booster_vessel.auto_pilot().set_target_direction(target_vector.to_tuple());
+            booster_attitude.set_target_direction(target_vector);
 
-            booster_vessel.control().set_throttle(throttle_control / horizontal_correction);
+            set_throttle(throttle_control / horizontal_correction);
 
             std::cout << "CONTROL:        " << throttle_control << std::endl;
             std::cout << "HORIZONTAL:     " << horizontal_correction << std::endl;
             std::cout << "ANGLE:          " << ship_up.angle_3d(up_vector) << std::endl;
             std::cout << "Vertical speed: " << vertical_speed << std::endl;
-        }
-        else if (completed_stages[3] && !completed_stages[4])
-        {
-            completed_stages[4] = true;
-            booster_vessel.control().set_throttle(0);
-            booster_vessel.auto_pilot().disengage();
-        }
-
-        KSP::sleep_milliseconds(10);
-    }
+        })
+        .transition("landed", [&]() { return booster_vessel.situation() == KSP::Situation::landed; });
+
+    booster.state("landed")
+        .on_entry([&]() {
+            set_throttle(0);
+            context.actuators.flush();
+            booster_attitude.stop();
+
+            std::cout << "ATTITUDE LOOP:  " << booster_attitude.statistics() << std::endl;
+            std::cout << "GUIDANCE SOLVE: " << descent_guidance.statistics() << std::endl;
+        });
+
+    booster_attitude.start();
+
+    /* Only the active state runs per tick. */
+    /* A restarted mission picks up from the last state, if it is still the same flight. */
+    booster.checkpoint("new-shepard-booster.checkpoint", booster_vessel._id, connection.space_center.ut() - booster_vessel.met());
+
+    context.period = 0.01;
+    context.loop([&]() { return booster.step(); });
+
+    booster.print_statistics();
+}
+
+/* Capsule: drogue and main parachutes, then wait for touchdown. */
+void capsule_landing(KSP::VesselContext& context)
+{
+    auto& connection = context.connection;
+    auto capsule_vessel = context.vessel;
+    auto capsule_reference_frame = capsule_vessel.surface_reference_frame();
+
+    /* Altitude target values. */
+    auto drogue_parachute_altitude = 2000;
+    auto main_parachute_altitude = 1000;
+
+    /* Reconnects if the connection drops; the altitude expression is made again for the new client. */
+    KSP::ResilientConnection link(connection);
+
+    /* Altitude for server-side triggers. */
+    auto& capsule_altitude = link.track<KSP::Quantity>([&]() {
+        return KSP::Quantity(connection, capsule_vessel.flight(capsule_reference_frame).surface_altitude_call());
+    });
+
+    KSP::StateMachine capsule("CAPSULE", "falling");
+
+    capsule.state("falling")
+        .transition_on("drogue", [&]() { return (capsule_altitude.get() < drogue_parachute_altitude).trigger(connection); });
+
+    /* Parachute commands go through the capsule's actuator queue, off its trigger loop. */
+    auto set_action_group = [&](int group) { context.actuators.post([&capsule_vessel, group]() { capsule_vessel.control().set_action_group(group, true); }); };
+
+    capsule.state("drogue")
+        .on_entry([&]() { set_action_group(2); })
+        .transition_on("main", [&]() { return (capsule_altitude.get() < main_parachute_altitude).trigger(connection); });
+
+    capsule.state("main")
+        .on_entry([&]() { set_action_group(3); })
+        .transition("landed", [&]() { return capsule_vessel.situation() == KSP::Situation::landed; });
+
+    capsule.state("landed");
+
+    capsule.checkpoint("new-shepard-capsule.checkpoint", capsule_vessel._id, connection.space_center.ut() - capsule_vessel.met());
+    link.on_reconnect([&]() { capsule.resume(); });
+
+    context.period = 0.01;
+    context.loop([&]() { return link.call([&]() { return capsule.step(); }); });
+
+    capsule.print_statistics();
+    std::cout << "CAPSULE RECOVERY: " << link.statistics() << std::endl;
+}
+
+void landing(KSP::Connection connection)
+{
+    /* Booster and capsule fly on their own threads and connections, so neither waits on the other's RPCs. */
+    KSP::VesselRuntime runtime(connection);
+    runtime.add("New Shepard", booster_landing);
+    runtime.add("New Shepard Capsule", capsule_landing);
+    runtime.run();
+    runtime.print_statistics();
 }
\ No newline at end of file
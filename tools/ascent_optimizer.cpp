@@ -0,0 +1,226 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <array>
+#include "../lib/ascent_simulator.hpp"
+#include "../lib/ascent_table.hpp"
+
+/**
+ * Offline ascent optimiser. Searches the pitch/throttle program parameters against
+ * KSP::AscentSimulator for the least delta-v to orbit, and writes the resulting
+ * pitch/throttle-versus-altitude table for Launcher::load_table.
+ *
+ * Usage: ascent_optimizer <vessel file> <target altitude (m)> <output table> [drag area (m^2)]
+ *
+ * The vessel file has one stage per line in firing order, '#' starts a comment:
+ *   wet_mass_kg dry_mass_kg vacuum_thrust_N vacuum_isp_s sea_level_isp_s
+ *
+ * Build: g++ -O2 -std=c++17 ascent_optimizer.cpp -o ascent_optimizer
+ */
+
+const double TABLE_STEP = 250.0;
+const int MAX_EVALUATIONS = 400;
+
+typedef std::array<double, 4> Parameters;
+
+/* Bounds for turn start speed, turn end altitude, turn exponent and maximum TWR. */
+const Parameters LOWER = {40, 15000, 0.2, 1.3};
+const Parameters UPPER = {200, 70000, 1.5, 4.0};
+
+std::vector<KSP::StageDescription> read_stages(std::string path)
+{
+    std::ifstream file(path);
+    std::string line;
+    std::vector<KSP::StageDescription> stages;
+
+    while (std::getline(file, line))
+    {
+        line = line.substr(0, line.find('#'));
+        std::istringstream stream(line);
+        KSP::StageDescription stage;
+
+        if (stream >> stage.wet_mass >> stage.dry_mass >> stage.thrust >> stage.isp_vacuum >> stage.isp_sea_level)
+        {
+            stages.push_back(stage);
+        }
+    }
+
+    return stages;
+}
+
+KSP::AscentProfile to_profile(Parameters p)
+{
+    for (size_t i = 0; i < p.size(); i++)
+    {
+        p[i] = std::max(LOWER[i], std::min(UPPER[i], p[i]));
+    }
+
+    return {p[0], p[1], p[2], p[3]};
+}
+
+/* Delta-v to orbit, with failed ascents ranked by how close they got. */
+double cost(KSP::AscentSimulator& simulator, Parameters p, double target_altitude)
+{
+    auto result = simulator.simulate(to_profile(p));
+
+    return result.reached ? result.delta_v : 1e5 + std::max(0.0, target_altitude - result.apoapsis);
+}
+
+/* Nelder-Mead simplex search. */
+Parameters optimize(KSP::AscentSimulator& simulator, Parameters start, double target_altitude)
+{
+    const int n = start.size();
+    std::vector<Parameters> simplex(n + 1, start);
+    std::vector<double> costs(n + 1);
+    auto evaluations = 0;
+
+    for (int i = 0; i < n; i++)
+    {
+        simplex[i + 1][i] += (UPPER[i] - LOWER[i]) * 0.2;
+    }
+
+    for (int i = 0; i <= n; i++)
+    {
+        costs[i] = cost(simulator, simplex[i], target_altitude);
+        evaluations++;
+    }
+
+    while (evaluations < MAX_EVALUATIONS)
+    {
+        /* Order best to worst. */
+        for (int i = 0; i <= n; i++)
+        {
+            for (int j = i + 1; j <= n; j++)
+            {
+                if (costs[j] < costs[i])
+                {
+                    std::swap(costs[i], costs[j]);
+                    std::swap(simplex[i], simplex[j]);
+                }
+            }
+        }
+
+        if (costs[n] - costs[0] < 0.1)
+        {
+            break;
+        }
+
+        Parameters centroid = {0, 0, 0, 0};
+
+        for (int i = 0; i < n; i++)
+        {
+            for (int k = 0; k < n; k++)
+            {
+                centroid[k] += simplex[i][k] / n;
+            }
+        }
+
+        auto along = [&](double factor) {
+            Parameters p;
+
+            for (int k = 0; k < n; k++)
+            {
+                p[k] = centroid[k] + factor * (simplex[n][k] - centroid[k]);
+            }
+
+            return p;
+        };
+
+        auto reflected = along(-1.0);
+        auto reflected_cost = cost(simulator, reflected, target_altitude);
+        evaluations++;
+
+        if (reflected_cost < costs[0])
+        {
+            auto expanded = along(-2.0);
+            auto expanded_cost = cost(simulator, expanded, target_altitude);
+            evaluations++;
+
+            simplex[n] = expanded_cost < reflected_cost ? expanded : reflected;
+            costs[n] = std::min(expanded_cost, reflected_cost);
+        }
+        else if (reflected_cost < costs[n - 1])
+        {
+            simplex[n] = reflected;
+            costs[n] = reflected_cost;
+        }
+        else
+        {
+            auto contracted = along(0.5);
+            auto contracted_cost = cost(simulator, contracted, target_altitude);
+            evaluations++;
+
+            if (contracted_cost < costs[n])
+            {
+                simplex[n] = contracted;
+                costs[n] = contracted_cost;
+            }
+            else
+            {
+                /* Shrink towards the best point. */
+                for (int i = 1; i <= n; i++)
+                {
+                    for (int k = 0; k < n; k++)
+                    {
+                        simplex[i][k] = simplex[0][k] + 0.5 * (simplex[i][k] - simplex[0][k]);
+                    }
+
+                    costs[i] = cost(simulator, simplex[i], target_altitude);
+                    evaluations++;
+                }
+            }
+        }
+    }
+
+    auto best = std::min_element(costs.begin(), costs.end()) - costs.begin();
+
+    return simplex[best];
+}
+
+int main(int argc, char const *argv[])
+{
+    if (argc < 4)
+    {
+        std::cout << "Usage: ascent_optimizer <vessel file> <target altitude> <output table> [drag area]" << std::endl;
+        return 1;
+    }
+
+    auto stages = read_stages(argv[1]);
+    auto target_altitude = std::stod(argv[2]);
+    auto drag_area = argc > 4 ? std::stod(argv[4]) : 1.0;
+
+    if (stages.empty())
+    {
+        std::cout << "No stages in '" << argv[1] << "'." << std::endl;
+        return 1;
+    }
+
+    KSP::AscentSimulator simulator(stages, target_altitude, drag_area);
+
+    /* The launcher's fixed turn as the starting point. */
+    auto best = optimize(simulator, {120, 40000, 0.6, 2.0}, target_altitude);
+    auto profile = to_profile(best);
+    KSP::AscentTable table(0.0, TABLE_STEP, target_altitude);
+    auto result = simulator.simulate(profile, &table);
+
+    if (!result.reached)
+    {
+        std::cout << "No profile reaches " << target_altitude << " m; best apoapsis " << result.apoapsis << " m." << std::endl;
+        return 1;
+    }
+
+    std::cout << "TURN START SPEED:  " << profile.turn_start_speed << " m/s" << std::endl;
+    std::cout << "TURN END ALTITUDE: " << profile.turn_end_altitude << " m" << std::endl;
+    std::cout << "TURN EXPONENT:     " << profile.turn_exponent << std::endl;
+    std::cout << "MAX TWR:           " << profile.max_twr << std::endl;
+    std::cout << "DELTA-V:           " << result.delta_v << " m/s (circularisation " << result.circularization_delta_v << " m/s)" << std::endl;
+    std::cout << "MAX Q:             " << result.max_dynamic_pressure << " Pa" << std::endl;
+
+    if (!table.save(argv[3]))
+    {
+        std::cout << "Could not write '" << argv[3] << "'." << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,129 @@
+#include <thread>
+#include <optional>
+#include <iomanip>
+#include <iostream>
+#include "../lib/ksp.hpp"
+
+/**
+ * Screens every vessel and piece of debris around the active vessel's body for close approaches
+ * to the given vessels, e.g. a station, or to the active vessel if none are given. Orbits are
+ * fetched once, on several connections in parallel, and then propagated locally.
+ *
+ * Usage: conjunction_screen [hours] [threshold (m)] [vessel names...]
+ *
+ * Build: g++ -O2 -std=c++20 conjunction_screen.cpp -o conjunction_screen -lkrpc -lprotobuf -pthread
+ */
+int main(int argc, char const *argv[])
+{
+    auto hours = argc > 1 ? std::stod(argv[1]) : 6.0;
+    auto threshold = argc > 2 ? std::stod(argv[2]) : 1000.0;
+    std::vector<std::string> names(argv + std::min(argc, 3), argv + argc);
+
+    /* Automatically connects to the server with the given IP address. */
+    auto connection = KSP::Connection();
+    auto active_vessel = connection.space_center.active_vessel();
+    auto body = active_vessel.orbit().body();
+    auto body_radius = body.equatorial_radius();
+    auto vessels = connection.space_center.vessels();
+    auto ut = connection.space_center.ut();
+
+    /* About a dozen RPCs per vessel, so they are spread over several connections. */
+    auto thread_count = std::clamp(std::thread::hardware_concurrency(), 1u, 8u);
+    std::vector<std::optional<KSP::KeplerOrbit>> fetched(vessels.size());
+    std::vector<std::string> vessel_names(vessels.size());
+    std::vector<std::thread> workers;
+    KSP::LoopClock clock;
+
+    for (unsigned t = 0; t < thread_count; t++)
+    {
+        workers.emplace_back([&, t]() {
+            KSP::Connection link;
+
+            for (size_t i = t; i < vessels.size(); i += thread_count)
+            {
+                try
+                {
+                    auto vessel = KSP::Vessel(&link.client, vessels[i]._id);
+                    auto orbit = vessel.orbit();
+
+                    if (orbit.body() == body)
+                    {
+                        fetched[i] = KSP::kepler_orbit(orbit);
+                        vessel_names[i] = vessel.name();
+                    }
+                }
+                catch (const std::exception&)
+                {
+                    /* Destroyed while fetching. */
+                }
+            }
+        });
+    }
+
+    for (auto& worker : workers)
+    {
+        worker.join();
+    }
+
+    /* Landed, suborbital and escaping objects are not screened. */
+    std::vector<KSP::KeplerOrbit> orbits;
+    std::vector<std::string> screened_names;
+    std::vector<size_t> primaries;
+
+    for (size_t i = 0; i < vessels.size(); i++)
+    {
+        if (fetched[i] && fetched[i]->closed() && fetched[i]->periapsis() > body_radius)
+        {
+            orbits.push_back(*fetched[i]);
+            screened_names.push_back(vessel_names[i]);
+        }
+    }
+
+    std::cout << "Fetched " << vessels.size() << " orbits in " << clock.elapsed() << " s, screening "
+              << orbits.size() << " around " << body.name() << "." << std::endl;
+
+    if (names.empty())
+    {
+        names.push_back(active_vessel.name());
+    }
+
+    /* Every vessel with the name is screened. */
+    for (auto& name : names)
+    {
+        auto count = primaries.size();
+
+        for (size_t i = 0; i < orbits.size(); i++)
+        {
+            if (screened_names[i] == name)
+            {
+                primaries.push_back(i);
+            }
+        }
+
+        if (primaries.size() == count)
+        {
+            std::cout << "'" << name << "' is not in orbit around " << body.name() << "." << std::endl;
+            return 1;
+        }
+    }
+
+    KSP::ConjunctionScreening screening(orbits);
+    screening.threshold = threshold;
+
+    clock = KSP::LoopClock();
+    auto conjunctions = screening.screen(ut, hours * 3600, primaries);
+
+    std::cout << "Screened " << screening.screened_pairs << " pairs in " << clock.elapsed() << " s, "
+              << conjunctions.size() << " approaches closer than " << threshold << " m." << std::endl;
+
+    for (auto& conjunction : conjunctions)
+    {
+        auto& approach = conjunction.approach;
+
+        std::cout << std::fixed << std::setprecision(1)
+                  << "T+" << std::setw(9) << approach.time - ut << " s  "
+                  << std::setw(7) << approach.distance << " m  "
+                  << std::setw(7) << approach.relative_velocity.length() << " m/s  "
+                  << screened_names[conjunction.first] << " - " << screened_names[conjunction.second] << std::endl;
+    }
+}
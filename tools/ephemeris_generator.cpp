@@ -0,0 +1,49 @@
+#include <iostream>
+#include "../lib/ksp.hpp"
+
+/**
+ * Writes an ephemeris of every body for the given number of days (of six hours) from now, for
+ * KSP::Ephemeris. The bodies' orbits are fetched from the server once; with --stock, the stock
+ * elements are used from UT 0 instead and no connection is needed.
+ *
+ * Usage: ephemeris_generator [path] [days] [--stock]
+ *
+ * Build: g++ -O2 -std=c++20 ephemeris_generator.cpp -o ephemeris_generator -lkrpc -lprotobuf
+ */
+int main(int argc, char const *argv[])
+{
+    auto path = argc > 1 ? std::string(argv[1]) : std::string("bodies.ephemeris");
+    auto days = argc > 2 ? std::stod(argv[2]) : 426.0;
+    auto stock = argc > 3 && std::string(argv[3]) == "--stock";
+
+    std::vector<KSP::ConicBody> bodies;
+    auto start = 0.0;
+
+    if (stock)
+    {
+        bodies = KSP::stock_bodies();
+    }
+    else
+    {
+        /* Automatically connects to the server with the given IP address. */
+        auto connection = KSP::Connection();
+        start = connection.space_center.ut();
+        bodies = KSP::conic_bodies(connection.space_center.bodies());
+    }
+
+    KSP::LoopClock clock;
+    KSP::Ephemeris::generate(bodies, start, days * 21600, path);
+    KSP::Ephemeris ephemeris(path);
+
+    std::cout << "Fitted " << ephemeris.body_count() << " bodies from UT " << ephemeris.start() << " to " << ephemeris.end()
+              << " in " << clock.elapsed() << " s:" << std::endl;
+
+    for (size_t i = 0; i < ephemeris.body_count(); i++)
+    {
+        auto& body = ephemeris.body(i);
+
+        std::cout << "  " << body.name << ": " << body.segment_count << " segments" << std::endl;
+    }
+
+    return 0;
+}
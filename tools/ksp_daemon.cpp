@@ -0,0 +1,240 @@
+#include <csignal>
+#include <iostream>
+#include <new>
+#include "../lib/ksp.hpp"
+
+/**
+ * Connection daemon. Holds one kRPC connection and the streams for the active vessel, publishes
+ * them every tick to shared memory for KSP::TelemetryClient, and runs the commands clients queue.
+ * Mission phases, recorders and dashboards then share this connection instead of each connecting.
+ *
+ * Usage: ksp_daemon [period (ms)]
+ *
+ * Build: g++ -O2 -std=c++20 ksp_daemon.cpp -o ksp_daemon -lkrpc -lprotobuf -lrt
+ */
+
+volatile std::sig_atomic_t running = 1;
+
+void stop(int)
+{
+    running = 0;
+}
+
+/* Streams for one vessel; rebuilt when the active vessel changes. */
+class VesselTelemetry
+{
+public:
+    KSP::Vessel vessel;
+    krpc::Stream<double> met;
+    krpc::Stream<double> mean_altitude;
+    krpc::Stream<double> surface_altitude;
+    krpc::Stream<double> vertical_speed;
+    krpc::Stream<double> speed;
+    krpc::Stream<double> apoapsis_altitude;
+    krpc::Stream<double> periapsis_altitude;
+    krpc::Stream<double> time_to_apoapsis;
+    krpc::Stream<double> time_to_periapsis;
+    krpc::Stream<double> mass;
+    krpc::Stream<float> thrust;
+    krpc::Stream<float> available_thrust;
+    krpc::Stream<float> throttle;
+    krpc::Stream<int32_t> stage;
+public:
+    VesselTelemetry(KSP::Vessel vessel);
+};
+
+VesselTelemetry::VesselTelemetry(KSP::Vessel vessel)
+    : vessel(vessel),
+      met(vessel.met_stream()),
+      mean_altitude(vessel.flight().mean_altitude_stream()),
+      surface_altitude(vessel.flight(vessel.surface_reference_frame()).surface_altitude_stream()),
+      vertical_speed(vessel.flight(vessel.orbit().body().reference_frame()).vertical_speed_stream()),
+      speed(vessel.flight(vessel.orbit().body().reference_frame()).speed_stream()),
+      apoapsis_altitude(vessel.orbit().apoapsis_altitude_stream()),
+      periapsis_altitude(vessel.orbit().periapsis_altitude_stream()),
+      time_to_apoapsis(vessel.orbit().time_to_apoapsis_stream()),
+      time_to_periapsis(vessel.orbit().time_to_periapsis_stream()),
+      mass(vessel.mass_stream()),
+      thrust(vessel.thrust_stream()),
+      available_thrust(vessel.available_thrust_stream()),
+      throttle(vessel.control().throttle_stream()),
+      stage(vessel.control().current_stage_stream())
+{
+}
+
+void execute(KSP::Vessel vessel, KSP::DaemonCommand command)
+{
+    switch (command.type)
+    {
+    case KSP::COMMAND_THROTTLE:
+        vessel.control().set_throttle(command.values[0]);
+        break;
+    case KSP::COMMAND_ACTIVATE_NEXT_STAGE:
+        vessel.control().activate_next_stage();
+        break;
+    case KSP::COMMAND_ACTION_GROUP:
+        vessel.control().set_action_group(command.argument, command.values[0] != 0.0);
+        break;
+    case KSP::COMMAND_SAS:
+        vessel.control().set_sas(command.argument != 0);
+        break;
+    case KSP::COMMAND_AUTOPILOT_ENGAGE:
+        vessel.auto_pilot().engage();
+        break;
+    case KSP::COMMAND_AUTOPILOT_DISENGAGE:
+        vessel.auto_pilot().disengage();
+        break;
+    case KSP::COMMAND_AUTOPILOT_DIRECTION:
+        switch (command.argument)
+        {
+        case KSP::FRAME_SURFACE:
+            vessel.auto_pilot().set_reference_frame(vessel.surface_reference_frame());
+            break;
+        case KSP::FRAME_SURFACE_VELOCITY:
+            vessel.auto_pilot().set_reference_frame(vessel.surface_velocity_reference_frame());
+            break;
+        default:
+            vessel.auto_pilot().set_reference_frame(vessel.orbital_reference_frame());
+            break;
+        }
+
+        vessel.auto_pilot().set_target_direction(std::make_tuple(command.values[0], command.values[1], command.values[2]));
+        break;
+    case KSP::COMMAND_AUTOPILOT_PITCH_HEADING:
+        vessel.auto_pilot().target_pitch_and_heading(command.values[0], command.values[1]);
+        break;
+    }
+}
+
+int main(int argc, char const *argv[])
+{
+    auto period = std::chrono::milliseconds(argc > 1 ? std::stoi(argv[1]) : 10);
+
+    /* Automatically connects to the server with the given IP address. */
+    auto connection = KSP::Connection();
+    auto ut_stream = connection.space_center.ut_stream();
+    auto active_vessel_stream = connection.space_center.active_vessel_stream();
+
+    /*
+     * Shared memory, sized and initialised before clients can see a valid magic. It carries the
+     * command ring, so only this user may open it; fchmod also covers a segment left by an older run.
+     */
+    auto descriptor = shm_open(KSP::TELEMETRY_SHM_NAME, O_CREAT | O_RDWR, 0600);
+
+    if (descriptor < 0 || fchmod(descriptor, 0600) != 0 || ftruncate(descriptor, sizeof(KSP::TelemetryBlock)) != 0)
+    {
+        std::cout << "Could not create shared memory '" << KSP::TELEMETRY_SHM_NAME << "'" << std::endl;
+        return 1;
+    }
+
+    auto memory = mmap(nullptr, sizeof(KSP::TelemetryBlock), PROT_READ | PROT_WRITE, MAP_SHARED, descriptor, 0);
+    close(descriptor);
+
+    if (memory == MAP_FAILED)
+    {
+        std::cout << "Could not map shared memory '" << KSP::TELEMETRY_SHM_NAME << "'" << std::endl;
+        shm_unlink(KSP::TELEMETRY_SHM_NAME);
+        return 1;
+    }
+
+    auto block = new (memory) KSP::TelemetryBlock();
+
+    block->sequence = 0;
+    block->command_head = 0;
+    block->command_tail = 0;
+
+    for (size_t i = 0; i < KSP::TELEMETRY_COMMANDS; i++)
+    {
+        block->commands[i].sequence = i;
+    }
+
+    block->version = KSP::TELEMETRY_VERSION;
+    std::atomic_thread_fence(std::memory_order_release);
+    block->magic = KSP::TELEMETRY_MAGIC;
+
+    std::signal(SIGINT, stop);
+    std::signal(SIGTERM, stop);
+
+    auto telemetry = std::make_unique<VesselTelemetry>(active_vessel_stream());
+    auto next = std::chrono::steady_clock::now();
+    KSP::LoopStatistics statistics;
+
+    std::cout << "Publishing telemetry to " << KSP::TELEMETRY_SHM_NAME << " every " << period.count() << " ms." << std::endl;
+
+    while (running)
+    {
+        KSP::LoopClock clock;
+
+        /* Staging or switching vessels changes the active vessel. */
+        auto active_vessel = active_vessel_stream();
+
+        if (!(active_vessel == telemetry->vessel))
+        {
+            telemetry = std::make_unique<VesselTelemetry>(active_vessel);
+        }
+
+        /* Seqlock write: sequence is odd while the values change. */
+        block->sequence.fetch_add(1, std::memory_order_acq_rel);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        double values[KSP::TELEMETRY_CHANNELS] = {
+            ut_stream(),
+            telemetry->met(),
+            telemetry->mean_altitude(),
+            telemetry->surface_altitude(),
+            telemetry->vertical_speed(),
+            telemetry->speed(),
+            telemetry->apoapsis_altitude(),
+            telemetry->periapsis_altitude(),
+            telemetry->time_to_apoapsis(),
+            telemetry->time_to_periapsis(),
+            telemetry->mass(),
+            telemetry->thrust(),
+            telemetry->available_thrust(),
+            telemetry->throttle(),
+            static_cast<double>(telemetry->stage())
+        };
+
+        block->vessel_id.store(active_vessel._id, std::memory_order_relaxed);
+
+        for (int i = 0; i < KSP::TELEMETRY_CHANNELS; i++)
+        {
+            block->values[i].store(values[i], std::memory_order_relaxed);
+        }
+
+        block->sequence.fetch_add(1, std::memory_order_release);
+        block->heartbeat.store(KSP::telemetry_clock(), std::memory_order_release);
+
+        /* Commands go to the vessel that was active when they were run. */
+        KSP::DaemonCommand command;
+
+        while (KSP::pop_command(block, command))
+        {
+            try
+            {
+                execute(telemetry->vessel, command);
+            }
+            catch (const std::exception& exception)
+            {
+                std::cout << "Command " << command.type << " failed: " << exception.what() << std::endl;
+            }
+        }
+
+        statistics.add(clock.elapsed(), std::chrono::duration<double>(period).count());
+
+        next += period;
+        auto now = std::chrono::steady_clock::now();
+
+        if (next < now)
+        {
+            next = now;
+        }
+
+        std::this_thread::sleep_until(next);
+    }
+
+    std::cout << "TICK: " << statistics << std::endl;
+
+    munmap(memory, sizeof(KSP::TelemetryBlock));
+    shm_unlink(KSP::TELEMETRY_SHM_NAME);
+}
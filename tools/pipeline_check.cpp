@@ -0,0 +1,96 @@
+#include <cmath>
+#include <chrono>
+#include <future>
+#include <vector>
+#include <iostream>
+#include "../lib/ksp.hpp"
+
+double seconds_since(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * Times the same getter through the blocking kRPC client and through KSP::PipelinedConnection
+ * with 1, 8 and 32 batches in flight, and checks that the pipelined answers are in order: the
+ * game time they return never goes back. Also checks that a failed call fails only its own
+ * future. benchmarks/rpc_pipeline measures the channel against a mock server; this measures it
+ * on the real server. Needs a running kRPC server.
+ *
+ * Usage: pipeline_check [calls]
+ *
+ * Build: g++ -O2 -std=c++20 -pthread pipeline_check.cpp -o pipeline_check -lkrpc -lprotobuf
+ */
+int main(int argc, char const *argv[])
+{
+    auto calls = argc > 1 ? std::stoul(argv[1]) : 2000ul;
+    auto failures = 0;
+
+    /* Automatically connects to the server with the given IP address. */
+    auto connection = KSP::Connection();
+
+    {
+        auto start = std::chrono::steady_clock::now();
+
+        for (unsigned long i = 0; i < calls; i++)
+        {
+            connection.space_center.ut();
+        }
+
+        std::cout << "BLOCKING:      " << calls / seconds_since(start) << " calls/s" << std::endl;
+    }
+
+    for (size_t in_flight : {1, 8, 32})
+    {
+        KSP::PipelinedConnection pipeline(connection, in_flight);
+        std::vector<std::future<double>> futures;
+        auto start = std::chrono::steady_clock::now();
+
+        for (unsigned long i = 0; i < calls; i++)
+        {
+            futures.push_back(pipeline.call<double>(connection.space_center.ut_call()));
+        }
+
+        auto issue_seconds = seconds_since(start);
+        auto previous = -INFINITY;
+
+        for (auto& future : futures)
+        {
+            auto ut = future.get();
+
+            failures += !(ut >= previous);
+            previous = ut;
+        }
+
+        std::cout << "PIPELINED " << in_flight << ":" << std::string(in_flight < 10 ? 4 : 3, ' ')
+                  << calls / seconds_since(start) << " calls/s  control thread "
+                  << issue_seconds / calls * 1e6 << " us/call to issue" << std::endl;
+    }
+
+    /* An unknown procedure fails its own call; the next call is still answered. */
+    {
+        KSP::PipelinedConnection pipeline(connection);
+        auto failed = pipeline.call<double>(pipeline.build_call("SpaceCenter", "NoSuchProcedure"));
+        auto answered = pipeline.call<double>(connection.space_center.ut_call());
+
+        try
+        {
+            failed.get();
+            failures++;
+            std::cout << "Unknown procedure did not fail" << std::endl;
+        }
+        catch (const krpc::RPCError& error)
+        {
+            std::cout << "Unknown procedure: " << error.what() << std::endl;
+        }
+
+        failures += !std::isfinite(answered.get());
+    }
+
+    if (failures > 0)
+    {
+        std::cout << failures << " failed checks" << std::endl;
+    }
+
+    return failures > 0 ? 1 : 0;
+}
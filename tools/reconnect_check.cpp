@@ -0,0 +1,87 @@
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <filesystem>
+#include <iostream>
+#include "../lib/ksp.hpp"
+
+/* Shuts down every socket of this process, as a server restart or a network drop would. */
+int drop_connections()
+{
+    auto count = 0;
+
+    for (auto& entry : std::filesystem::directory_iterator("/proc/self/fd"))
+    {
+        auto descriptor = std::stoi(entry.path().filename().string());
+        struct stat status;
+
+        if (fstat(descriptor, &status) == 0 && S_ISSOCK(status.st_mode) && shutdown(descriptor, SHUT_RDWR) == 0)
+        {
+            count++;
+        }
+    }
+
+    return count;
+}
+
+/**
+ * Forces a dropped connection while a state machine waits on a server-side trigger, the way the
+ * New Shepard capsule waits for its parachute altitude, and checks that it resumes: the drop is
+ * seen from the heartbeat, the trigger is made again, the machine reaches its final state and no
+ * entry action runs twice. Prints the recovery time. Needs a running kRPC server.
+ *
+ * Usage: reconnect_check [seconds to wait]
+ *
+ * Build: g++ -O2 -std=c++20 reconnect_check.cpp -o reconnect_check -lkrpc -lprotobuf
+ */
+int main(int argc, char const *argv[])
+{
+    auto wait = argc > 1 ? std::stod(argv[1]) : 3.0;
+
+    /* Automatically connects to the server with the given IP address. */
+    auto connection = KSP::Connection();
+    KSP::ResilientConnection link(connection);
+    auto start = connection.space_center.ut();
+    auto ticks = 0;
+    auto dropped = 0;
+    std::map<std::string, int> entries;
+
+    auto& ut = link.track<KSP::Quantity>([&]() { return KSP::Quantity(connection, connection.space_center.ut_call()); });
+
+    KSP::StateMachine machine("CHECK", "waiting");
+
+    /* Only reads the trigger's stream while waiting, so only the heartbeat can see the drop. */
+    machine.state("waiting")
+        .on_entry([&]() { entries["waiting"]++; })
+        .on_tick([&]() {
+            if (++ticks == 20)
+            {
+                dropped = drop_connections();
+                std::cout << "Shut down " << dropped << " sockets." << std::endl;
+            }
+        })
+        .transition_on("done", [&]() { return (ut.get() > start + wait).trigger(connection); });
+
+    machine.state("done")
+        .on_entry([&]() { entries["done"]++; });
+
+    link.on_reconnect([&]() { machine.resume(); });
+
+    KSP::LoopClock clock;
+
+    while (link.call([&]() { return machine.step(); }))
+    {
+        KSP::sleep_milliseconds(10);
+    }
+
+    auto recovery = link.statistics();
+
+    std::cout << "Finished in '" << machine.current() << "' after " << clock.elapsed() << " s, recovery " << recovery << std::endl;
+
+    if (dropped == 0 || recovery.count != 1 || machine.current() != "done" || entries["waiting"] != 1 || entries["done"] != 1)
+    {
+        std::cout << "FAILED" << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
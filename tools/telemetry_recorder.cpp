@@ -0,0 +1,79 @@
+#include <fstream>
+#include <iostream>
+#include <csignal>
+#include "../lib/telemetry.hpp"
+
+/**
+ * Records the telemetry published by ksp_daemon to a CSV file, one row per daemon tick, until
+ * interrupted. Runs next to the mission on the daemon's connection and needs no kRPC of its own.
+ *
+ * Usage: telemetry_recorder <output csv>
+ *
+ * Build: g++ -O2 -std=c++20 telemetry_recorder.cpp -o telemetry_recorder -lrt
+ */
+
+volatile std::sig_atomic_t running = 1;
+
+void stop(int)
+{
+    running = 0;
+}
+
+int main(int argc, char const *argv[])
+{
+    if (argc < 2)
+    {
+        std::cout << "Usage: telemetry_recorder <output csv>" << std::endl;
+        return 1;
+    }
+
+    KSP::TelemetryClient telemetry;
+    std::ofstream file(argv[1]);
+
+    file << "frame,vessel_id";
+
+    for (int i = 0; i < KSP::TELEMETRY_CHANNELS; i++)
+    {
+        file << "," << KSP::TELEMETRY_CHANNEL_NAMES[i];
+    }
+
+    file << std::endl;
+
+    std::signal(SIGINT, stop);
+    std::signal(SIGTERM, stop);
+
+    auto snapshot = telemetry.read();
+    unsigned long rows = 0;
+    unsigned long missed = 0;
+
+    while (running)
+    {
+        auto next = telemetry.wait_for_update(snapshot.frame);
+
+        if (next.frame == snapshot.frame)
+        {
+            if (!telemetry.alive())
+            {
+                std::cout << "Daemon stopped publishing." << std::endl;
+                break;
+            }
+
+            continue;
+        }
+
+        missed += next.frame - snapshot.frame - 1;
+        snapshot = next;
+
+        file << snapshot.frame << "," << snapshot.vessel_id;
+
+        for (int i = 0; i < KSP::TELEMETRY_CHANNELS; i++)
+        {
+            file << "," << snapshot.values[i];
+        }
+
+        file << "\n";
+        rows++;
+    }
+
+    std::cout << "Recorded " << rows << " ticks, missed " << missed << "." << std::endl;
+}